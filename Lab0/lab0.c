@@ -18,11 +18,13 @@
 #include <GL/gl.h>
 #include "MicroGlut.h"
 #endif
+#include <string.h>
 #include "GL_utilities.h"
 #include "VectorUtils3.h"
 #include "loadobj.h"
 //#include "zpr.h"
 #include "LoadTGA.h"
+#include "TextureCompress.h"
 
 //constants
 const int initWidth=512,initHeight=512;
@@ -39,6 +41,9 @@ mat4 viewMatrix;
 // Projection matrix, set by a call to perspective().
 mat4 projectionMatrix;
 
+// Camera and time, shared by all programs
+FrameConstants frame;
+
 // Globals
 // * Model(s)
 Model *bunny;
@@ -53,8 +58,8 @@ void init(void)
 
     // GL inits
     glClearColor(0.2,0.2,0.5,0);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    stateEnable(GL_DEPTH_TEST);
+    stateEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
     printError("GL inits");
 
@@ -70,7 +75,7 @@ void init(void)
     printError("load models");
 
     // Load textures
-    LoadTGATextureSimple("textures/maskros512.tga",&texture);
+    LoadTGATextureCompressedSimple("textures/maskros512.tga",&texture);
     printError("load textures");
 }
 
@@ -79,17 +84,22 @@ void display(void)
 {
     time += 0.2;
     printError("pre display");
+    pollShaderReload();
 
     // clear the screen
     glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
 
     //activate the program, and set its variables
-    glUseProgram(program);
-    glUniformMatrix4fv(glGetUniformLocation(program, "projectionMatrix"), 1, GL_TRUE, projectionMatrix.m);
-    glUniform1f(glGetUniformLocation(program, "time"), time);
+    stateUseProgram(program);
+    mat4 viewProj = Mult(projectionMatrix, viewMatrix);
+    memcpy(frame.view, viewMatrix.m, sizeof(frame.view));
+    memcpy(frame.proj, projectionMatrix.m, sizeof(frame.proj));
+    memcpy(frame.viewProj, viewProj.m, sizeof(frame.viewProj));
+    frame.time = time;
+    uploadFrameConstants(&frame);
     mat4 world = Mult(Ry(time * 0.1), objectExampleMatrix);
     mat4 m = Mult(viewMatrix, world);
-    glUniformMatrix4fv(glGetUniformLocation(program, "viewMatrix"), 1, GL_TRUE, m.m);
+    setUniformMatrix4fv(program, "viewMatrix", GL_TRUE, m.m);
 
     //draw the model
     DrawModel(bunny, program, "in_Position", "in_Normal", NULL);
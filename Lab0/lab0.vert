@@ -10,9 +10,16 @@ in  vec3  in_Position;
 in  vec3  in_Normal;
 in  vec2  in_TexCoord;
 
-uniform mat4 projectionMatrix;
 uniform mat4 viewMatrix;
-uniform float time;
+layout(std140, row_major) uniform FrameConstants
+{
+	mat4 frameView, frameProj, frameViewProj;
+	vec4 frameCamPos;
+	float frameTime;
+	int frameLightCount;
+	vec4 frameLightColor[8];
+	vec4 frameLightPos[8];
+};
 
 out vec3 position;
 out float shade;
@@ -20,8 +27,8 @@ out float shade;
 void main(void)
 {
 	shade = (mat3(viewMatrix)*in_Normal).z; // Fake shading
-	gl_Position=projectionMatrix*viewMatrix*vec4(in_Position, 1.0);
-	gl_Position.x += sin(time * 0.4 + gl_Position.y) * 0.3;
+	gl_Position=frameProj*viewMatrix*vec4(in_Position, 1.0);
+	gl_Position.x += sin(frameTime * 0.4 + gl_Position.y) * 0.3;
 	position = in_Position;
 }
 
@@ -0,0 +1,270 @@
+// AffineBench, the mat4x3 calls against their mat4 equivalents.
+// Compose, inverse, point transform and normal matrix on random transforms
+// built from trs. Each call reports ns, its time as a percentage of the
+// mat4 call, and the largest difference from the mat4 result.
+
+// 261019: First version.
+// 261019: The trs math calls are gone, trs is only used to build the inputs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "VectorUtils3.h"
+#include "BenchUtils.h"
+
+#define kCount 10000
+#define kMinTime 0.05
+
+static mat4x3 affA[kCount], affB[kCount], rigidAff[kCount], affOut[kCount];
+static mat4 matA[kCount], matB[kCount], rigidMat[kCount], matOut[kCount];
+static mat3 normalOut[kCount];
+static vec3 points[kCount], pointOut[kCount];
+
+// --- Timed calls ---
+
+static void RunMult(void)
+{
+	int i;
+
+	for (i = 0; i < kCount; i++)
+		matOut[i] = Mult(matA[i], matB[i]);
+}
+
+static void RunMultMat4x3(void)
+{
+	int i;
+
+	for (i = 0; i < kCount; i++)
+		affOut[i] = MultMat4x3(affA[i], affB[i]);
+}
+
+static void RunInvertMat4(void)
+{
+	int i;
+
+	for (i = 0; i < kCount; i++)
+		matOut[i] = InvertMat4(matA[i]);
+}
+
+static void RunInvertMat4x3(void)
+{
+	int i;
+
+	for (i = 0; i < kCount; i++)
+		affOut[i] = InvertMat4x3(affA[i]);
+}
+
+static void RunInvertMat4Rigid(void)
+{
+	int i;
+
+	for (i = 0; i < kCount; i++)
+		matOut[i] = InvertMat4(rigidMat[i]);
+}
+
+static void RunInvertMat4x3Rigid(void)
+{
+	int i;
+
+	for (i = 0; i < kCount; i++)
+		affOut[i] = InvertMat4x3Rigid(rigidAff[i]);
+}
+
+static void RunMultVec3(void)
+{
+	int i;
+
+	for (i = 0; i < kCount; i++)
+		pointOut[i] = MultVec3(matA[i], points[i]);
+}
+
+static void RunMultMat4x3Vec3(void)
+{
+	int i;
+
+	for (i = 0; i < kCount; i++)
+		pointOut[i] = MultMat4x3Vec3(affA[i], points[i]);
+}
+
+static void RunInverseTranspose(void)
+{
+	int i;
+
+	for (i = 0; i < kCount; i++)
+		normalOut[i] = InverseTranspose(matA[i]);
+}
+
+static void RunNormalMatrixMat4x3(void)
+{
+	int i;
+
+	for (i = 0; i < kCount; i++)
+		normalOut[i] = NormalMatrixMat4x3(affA[i]);
+}
+
+// --- Differences from the mat4 results ---
+
+static double Diff(const GLfloat *a, const GLfloat *b, int n)
+{
+	double d, e = 0.0;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		d = fabs(a[i] - b[i]) / (fabs(b[i]) > 1.0 ? fabs(b[i]) : 1.0);
+		if (d > e)
+			e = d;
+	}
+	return e;
+}
+
+static double DiffMat4(mat4 a, mat4 ref)
+{
+	return Diff(a.m, ref.m, 16);
+}
+
+static double DiffMultMat4x3(int i)
+{
+	return DiffMat4(Mat4x3ToMat4(MultMat4x3(affA[i], affB[i])), Mult(matA[i], matB[i]));
+}
+
+static double DiffInvertMat4x3(int i)
+{
+	return DiffMat4(Mat4x3ToMat4(InvertMat4x3(affA[i])), InvertMat4(matA[i]));
+}
+
+static double DiffInvertMat4x3Rigid(int i)
+{
+	return DiffMat4(Mat4x3ToMat4(InvertMat4x3Rigid(rigidAff[i])), InvertMat4(rigidMat[i]));
+}
+
+static double DiffMultMat4x3Vec3(int i)
+{
+	vec3 p = MultMat4x3Vec3(affA[i], points[i]), ref = MultVec3(matA[i], points[i]);
+
+	return Diff(&p.x, &ref.x, 3);
+}
+
+static double DiffNormalMatrixMat4x3(int i)
+{
+	mat3 n = NormalMatrixMat4x3(affA[i]), ref = InverseTranspose(matA[i]);
+
+	return Diff(n.m, ref.m, 9);
+}
+
+typedef struct
+{
+	const char *name;
+	void (*run)(void);
+	double (*diff)(int i); // NULL for the mat4 calls
+} AffineOp;
+
+// Each group starts with the mat4 call the others are compared to
+static AffineOp groups[5][3] =
+{
+	{
+		{"Mult", RunMult, NULL},
+		{"MultMat4x3", RunMultMat4x3, DiffMultMat4x3},
+	},
+	{
+		{"InvertMat4", RunInvertMat4, NULL},
+		{"InvertMat4x3", RunInvertMat4x3, DiffInvertMat4x3},
+	},
+	{
+		{"InvertMat4_rigid", RunInvertMat4Rigid, NULL},
+		{"InvertMat4x3Rigid", RunInvertMat4x3Rigid, DiffInvertMat4x3Rigid},
+	},
+	{
+		{"MultVec3", RunMultVec3, NULL},
+		{"MultMat4x3Vec3", RunMultMat4x3Vec3, DiffMultMat4x3Vec3},
+	},
+	{
+		{"InverseTranspose", RunInverseTranspose, NULL},
+		{"NormalMatrixMat4x3", RunNormalMatrixMat4x3, DiffNormalMatrixMat4x3},
+	},
+};
+static const char *groupNames[5] = {"compose", "inverse", "inverse", "point", "normal"};
+
+static double TimeOp(AffineOp *op)
+{
+	double t0, t, best = 1e30, total = 0.0;
+	int reps = 0;
+
+	op->run();
+	while (total < kMinTime || reps < 3)
+	{
+		t0 = BenchTime();
+		op->run();
+		t = BenchTime() - t0;
+		total += t;
+		reps++;
+		if (t < best)
+			best = t;
+	}
+	return best;
+}
+
+static trs RandomTRS(GLfloat scale)
+{
+	vec3 axis = Normalize(SetVector(BenchUniform(-1, 1), BenchUniform(-1, 1), BenchUniform(-1, 1)));
+
+	return SetTRS(SetVector(BenchUniform(-10, 10), BenchUniform(-10, 10), BenchUniform(-10, 10)),
+		QuatFromAxisAngle(axis, BenchUniform(0, M_PI)), SetVector(scale, scale, scale));
+}
+
+static void MakeData(void)
+{
+	trs a, b, rigid;
+	int i;
+
+	for (i = 0; i < kCount; i++)
+	{
+		a = RandomTRS(BenchUniform(0.5, 2));
+		b = RandomTRS(BenchUniform(0.5, 2));
+		affA[i] = TRSToMat4x3(a);
+		affB[i] = TRSToMat4x3(b);
+		matA[i] = TRSToMat4(a);
+		matB[i] = TRSToMat4(b);
+		rigid = RandomTRS(1.0);
+		rigidAff[i] = TRSToMat4x3(rigid);
+		rigidMat[i] = TRSToMat4(rigid);
+		points[i] = SetVector(BenchUniform(-10, 10), BenchUniform(-10, 10), BenchUniform(-10, 10));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	AffineOp *op;
+	double t, base = 0.0, d, maxDiff;
+	int g, j, i;
+
+	BenchInit("affine");
+	MakeData();
+	for (g = 0; g < 5; g++)
+		for (j = 0; j < 3 && groups[g][j].name != NULL; j++)
+		{
+			op = &groups[g][j];
+			t = TimeOp(op) / kCount;
+			BenchReport(op->name, groupNames[g], "ns", t * 1e9);
+			if (op->diff == NULL)
+			{
+				base = t;
+				continue;
+			}
+			BenchReport(op->name, groupNames[g], "pct_of_mat4", 100.0 * t / base);
+			maxDiff = 0.0;
+			for (i = 0; i < kCount; i++)
+			{
+				d = op->diff(i);
+				if (d > maxDiff)
+					maxDiff = d;
+			}
+			BenchReport(op->name, groupNames[g], "max_rel_diff", maxDiff);
+		}
+	BenchReport("mat4", "size", "bytes", sizeof(mat4));
+	BenchReport("mat4x3", "size", "bytes", sizeof(mat4x3));
+	BenchReport("trs", "size", "bytes", sizeof(trs));
+	return 0;
+}
@@ -0,0 +1,207 @@
+// BatchBench, the VectorUtils3 batch calls at 1K to 10M points.
+// Each call is compared with a plain loop over the single vector call (the
+// batch calls promise the same results), as ns per point and GB/s. The
+// makefile builds it with and without OpenMP, which splits the batch calls
+// over all cores.
+
+// 261019: First version.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+
+#include "VectorUtils3.h"
+#include "BenchUtils.h"
+
+#define kMaxPoints 10000000
+#define kBones 4
+#define kMinTime 0.05 // Seconds per measurement
+
+static vec3 *points, *normals, *outPoints, *outNormals, *loopOut;
+static GLfloat *x, *y, *z, *outX, *outY, *outZ, *weights;
+static mat4 matrix, bones[kBones];
+static int count;
+
+static void LoopMultVec3(void)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		loopOut[i] = MultVec3(matrix, points[i]);
+}
+
+static void BatchMultVec3(void)
+{
+	MultVec3Array(matrix, points, outPoints, count);
+}
+
+static void BatchMultVec3SoA(void)
+{
+	MultVec3ArraySoA(matrix, x, y, z, outX, outY, outZ, count);
+}
+
+static void LoopNormalize(void)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		loopOut[i] = Normalize(points[i]);
+}
+
+static void BatchNormalize(void)
+{
+	NormalizeArray(points, outPoints, count);
+}
+
+// In place, so the input is normalized after the first time, but the work is the same
+static void BatchNormalizeSoA(void)
+{
+	NormalizeArraySoA(outX, outY, outZ, count);
+}
+
+static void BatchPointsAndNormals(void)
+{
+	TransformPointsAndNormals(matrix, points, normals, outPoints, outNormals, count);
+}
+
+static void LoopSkin(void)
+{
+	vec3 sum, p;
+	int i, b;
+
+	for (i = 0; i < count; i++)
+	{
+		sum = SetVector(0, 0, 0);
+		for (b = 0; b < kBones; b++)
+		{
+			p = MultVec3(bones[b], points[i]);
+			sum = VectorAdd(sum, ScalarMult(p, weights[i * kBones + b]));
+		}
+		loopOut[i] = sum;
+	}
+}
+
+static void BatchSkin(void)
+{
+	SkinVec3Array(bones, kBones, weights, points, outPoints, count);
+}
+
+static void BatchSkinSoA(void)
+{
+	SkinVec3ArraySoA(bones, kBones, weights, x, y, z, outX, outY, outZ, count);
+}
+
+typedef struct
+{
+	const char *name;
+	void (*run)(void);
+	int bytesPerPoint;	// Read and written
+} BatchOp;
+
+static BatchOp ops[] =
+{
+	{"MultVec3_loop", LoopMultVec3, 24},
+	{"MultVec3Array", BatchMultVec3, 24},
+	{"MultVec3ArraySoA", BatchMultVec3SoA, 24},
+	{"Normalize_loop", LoopNormalize, 24},
+	{"NormalizeArray", BatchNormalize, 24},
+	{"NormalizeArraySoA", BatchNormalizeSoA, 24},
+	{"TransformPointsAndNormals", BatchPointsAndNormals, 48},
+	{"Skin_loop", LoopSkin, 24 + 4 * kBones},
+	{"SkinVec3Array", BatchSkin, 24 + 4 * kBones},
+	{"SkinVec3ArraySoA", BatchSkinSoA, 24 + 4 * kBones},
+};
+
+static double TimeOp(BatchOp *op)
+{
+	double t0, t, best = 1e30, total = 0.0;
+	int reps = 0;
+
+	op->run(); // Warm up, and the page faults
+	while (total < kMinTime || reps < 3)
+	{
+		t0 = BenchTime();
+		op->run();
+		t = BenchTime() - t0;
+		total += t;
+		reps++;
+		if (t < best)
+			best = t;
+	}
+	return best;
+}
+
+static void MakeData(void)
+{
+	double sum;
+	int i, b;
+
+	points = (vec3 *)malloc(kMaxPoints * sizeof(vec3));
+	normals = (vec3 *)malloc(kMaxPoints * sizeof(vec3));
+	outPoints = (vec3 *)malloc(kMaxPoints * sizeof(vec3));
+	outNormals = (vec3 *)malloc(kMaxPoints * sizeof(vec3));
+	loopOut = (vec3 *)malloc(kMaxPoints * sizeof(vec3));
+	x = (GLfloat *)malloc(kMaxPoints * sizeof(GLfloat));
+	y = (GLfloat *)malloc(kMaxPoints * sizeof(GLfloat));
+	z = (GLfloat *)malloc(kMaxPoints * sizeof(GLfloat));
+	outX = (GLfloat *)malloc(kMaxPoints * sizeof(GLfloat));
+	outY = (GLfloat *)malloc(kMaxPoints * sizeof(GLfloat));
+	outZ = (GLfloat *)malloc(kMaxPoints * sizeof(GLfloat));
+	weights = (GLfloat *)malloc(kMaxPoints * kBones * sizeof(GLfloat));
+	for (i = 0; i < kMaxPoints; i++)
+	{
+		points[i] = SetVector(BenchUniform(-10, 10), BenchUniform(-10, 10), BenchUniform(-10, 10));
+		normals[i] = Normalize(SetVector(BenchUniform(-1, 1), BenchUniform(-1, 1), 1.0));
+		x[i] = outX[i] = points[i].x;
+		y[i] = outY[i] = points[i].y;
+		z[i] = outZ[i] = points[i].z;
+		sum = 0.0;
+		for (b = 0; b < kBones; b++)
+			sum += weights[i * kBones + b] = BenchUniform(0, 1);
+		for (b = 0; b < kBones; b++)
+			weights[i * kBones + b] /= sum;
+	}
+	matrix = Mult(T(1, 2, 3), Mult(ArbRotate(SetVector(1, 1, 0), 0.7), S(2, 2, 2)));
+	for (b = 0; b < kBones; b++)
+		bones[b] = Mult(T(b, 0, 0), ArbRotate(SetVector(0, 1, b), 0.3 * b));
+}
+
+// The batch calls promise the same results as the loops
+static int SameAsLoop(void (*loop)(void), void (*batch)(void))
+{
+	loop();
+	batch();
+	return memcmp(loopOut, outPoints, count * sizeof(vec3)) == 0;
+}
+
+int main(int argc, char **argv)
+{
+	char param[32];
+	double t;
+	int j, threads = 1;
+
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	BenchInit("batch");
+	MakeData();
+	for (count = 1000; count <= kMaxPoints; count *= 10)
+	{
+		sprintf(param, "%d", count);
+		for (j = 0; j < (int)(sizeof(ops) / sizeof(ops[0])); j++)
+		{
+			t = TimeOp(&ops[j]);
+			BenchReport(ops[j].name, param, "ns_per_point", t / count * 1e9);
+			BenchReport(ops[j].name, param, "gb_s", (double)count * ops[j].bytesPerPoint / t * 1e-9);
+		}
+		BenchReport("MultVec3Array", param, "same_as_loop", SameAsLoop(LoopMultVec3, BatchMultVec3));
+		BenchReport("NormalizeArray", param, "same_as_loop", SameAsLoop(LoopNormalize, BatchNormalize));
+		BenchReport("SkinVec3Array", param, "same_as_loop", SameAsLoop(LoopSkin, BatchSkin));
+	}
+	BenchReport("all", "threads", "count", threads);
+	return 0;
+}
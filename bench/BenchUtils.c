@@ -0,0 +1,115 @@
+// BenchUtils, timing, cache eviction, random data and CSV output shared
+// by the benchmarks in this directory.
+
+// 261019: First version.
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <time.h>
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+#include "BenchUtils.h"
+
+static const char *gBench = "bench";
+static unsigned int gRandomState = 1;
+
+void BenchInit(const char *bench)
+{
+	gBench = bench;
+	BenchSeed(1);
+}
+
+void BenchReport(const char *test, const char *param, const char *metric, double value)
+{
+	printf("%s,%s,%s,%s,%s,%.6g\n", gBench, BENCH_BUILD, test, param, metric, value);
+	fflush(stdout);
+}
+
+double BenchTime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 0.000000001;
+}
+
+// clflush where there is one, otherwise reads a buffer larger than most caches
+void BenchEvict(const void *p, long size)
+{
+#if defined(__SSE2__)
+	const char *c = (const char *)p;
+	long i;
+
+	for (i = 0; i < size; i += 64)
+		_mm_clflush(c + i);
+	_mm_mfence();
+#else
+	static volatile unsigned char *scratch = NULL;
+	static const long scratchSize = 64L << 20;
+	unsigned char sum = 0;
+	long i;
+
+	(void)p;
+	(void)size;
+	if (scratch == NULL)
+		scratch = (volatile unsigned char *)calloc(scratchSize, 1);
+	for (i = 0; i < scratchSize; i += 64)
+		sum += scratch[i];
+	scratch[0] = sum;
+#endif
+}
+
+void BenchSeed(unsigned int seed)
+{
+	gRandomState = seed ? seed : 1;
+}
+
+// xorshift32
+unsigned int BenchRandom(void)
+{
+	gRandomState ^= gRandomState << 13;
+	gRandomState ^= gRandomState >> 17;
+	gRandomState ^= gRandomState << 5;
+	return gRandomState;
+}
+
+double BenchUniform(double lo, double hi)
+{
+	return lo + (hi - lo) * (BenchRandom() / 4294967296.0);
+}
+
+int *BenchShuffle(int n)
+{
+	int *order = (int *)malloc(n * sizeof(int));
+	int i, j, t;
+
+	for (i = 0; i < n; i++)
+		order[i] = i;
+	for (i = n - 1; i > 0; i--)
+	{
+		j = BenchRandom() % (i + 1);
+		t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+	return order;
+}
+
+// Measured against the size of the result rather than each element, so that
+// elements that cancel to almost zero do not give huge errors.
+double BenchUlps(float f, double ref, double scale)
+{
+	int e;
+
+	scale = fabs(scale);
+	if (scale < FLT_MIN)
+		scale = FLT_MIN;
+	frexp(scale, &e);
+	return fabs((double)f - ref) / ldexp(1.0, e - 24);
+}
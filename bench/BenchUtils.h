@@ -0,0 +1,37 @@
+#ifndef _BENCH_UTILS_
+#define _BENCH_UTILS_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Results are printed as CSV, one value per line:
+//	bench,build,test,param,metric,value
+// bench is the program, build the compile options it was built with (see the
+// makefile), test the call or case, param the data set, metric what value is
+// (ns, max_ulp, psnr...). "make run" prints the header line once.
+
+#ifndef BENCH_BUILD
+	#define BENCH_BUILD "default"
+#endif
+
+void BenchInit(const char *bench);
+void BenchReport(const char *test, const char *param, const char *metric, double value);
+// Seconds, monotonic
+double BenchTime(void);
+// Evicts size bytes at p from all cache levels, for timing on cold data
+void BenchEvict(const void *p, long size);
+// Deterministic random numbers, so every build sees the same data
+void BenchSeed(unsigned int seed);
+unsigned int BenchRandom(void);
+double BenchUniform(double lo, double hi);
+// Random permutation of 0..n-1
+int *BenchShuffle(int n);
+// Error of f in units in the last place of a float of size scale
+double BenchUlps(float f, double ref, double scale);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,134 @@
+// CompressBench, quality and speed of the BC1/BC3/BC4 encoder in TextureCompress.
+// Compresses the bundled textures and some synthetic images (smooth
+// gradients, which show banding, NPOT sizes, alpha and 8 bit) and reports
+// the PSNR of the top level and the encoder speed, mip levels included.
+
+// 261019: First version.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "TextureCompress.h"
+#include "BenchUtils.h"
+
+#define kPasses 3
+
+static char *files[] =
+{
+	"../Lab0/textures/maskros512.tga",
+	"../Lab0/textures/grass.tga",
+	"../Lab0/textures/bilskissred.tga",
+	"../lab1-2/bumpmaps/noise.tga",
+	"../lab3/balls/8.tga",
+	"../lab3/surface.tga",
+	"../lab4/bilder/leaves.tga",
+	"../lab4/bilder/sheep.tga",
+};
+
+static void NewImage(TextureData *t, int width, int height, int bpp)
+{
+	memset(t, 0, sizeof(TextureData));
+	t->width = t->w = width;
+	t->height = t->h = height;
+	t->bpp = bpp;
+	t->imageData = (GLubyte *)malloc((long)width * height * (bpp / 8));
+}
+
+// Smooth ramps in every channel, with alpha in the 32 bit version
+static void MakeGradient(TextureData *t, int width, int height, int bpp)
+{
+	int x, y, bytes = bpp / 8;
+	GLubyte *p;
+
+	NewImage(t, width, height, bpp);
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+		{
+			p = &t->imageData[((long)y * width + x) * bytes];
+			p[0] = x * 255 / (width - 1);
+			if (bytes == 1)
+				continue;
+			p[1] = y * 255 / (height - 1);
+			p[2] = (x + y) * 255 / (width + height - 2);
+			if (bytes == 4)
+				p[3] = 255 - p[0];
+		}
+}
+
+// Random colors, the worst case for a 4x4 block with two endpoints
+static void MakeNoise(TextureData *t, int width, int height, int bpp)
+{
+	long i;
+
+	NewImage(t, width, height, bpp);
+	for (i = 0; i < (long)width * height * (bpp / 8); i++)
+		t->imageData[i] = BenchRandom();
+}
+
+// As documented in TextureCompress.h
+static const char *FormatName(TextureData *t)
+{
+	return t->bpp == 8 ? "BC4" : (t->bpp == 24 ? "BC1" : "BC3");
+}
+
+static void TestImage(const char *name, TextureData *t)
+{
+	CompressedTexture *ct;
+	double t0, best = 1e30;
+	long raw, compressed = 0;
+	int pass, l;
+
+	for (pass = 0; pass < kPasses; pass++)
+	{
+		t0 = BenchTime();
+		ct = CompressTextureData(t);
+		t0 = BenchTime() - t0;
+		if (t0 < best)
+			best = t0;
+		if (pass < kPasses - 1)
+			DisposeCompressedTexture(ct);
+	}
+	raw = (long)t->width * t->height * (t->bpp / 8);
+	for (l = 0; l < ct->levels; l++)
+		compressed += ct->levelSize[l];
+	BenchReport(name, FormatName(t), "psnr", CompressedTexturePSNR(ct, t));
+	BenchReport(name, FormatName(t), "ms", best * 1000.0);
+	// All levels, as LoadTGATextureCompressed reports it
+	BenchReport(name, FormatName(t), "mpix_s", t->width * t->height * 4.0 / 3.0 / best * 1e-6);
+	BenchReport(name, FormatName(t), "bits_per_pixel", compressed * 8.0 / ((double)t->width * t->height * 4.0 / 3.0));
+	BenchReport(name, FormatName(t), "ratio", raw * 4.0 / 3.0 / compressed);
+	DisposeCompressedTexture(ct);
+}
+
+int main(int argc, char **argv)
+{
+	TextureData t;
+	char *name;
+	int i;
+
+	BenchInit("compress");
+	for (i = 0; i < (int)(sizeof(files) / sizeof(files[0])); i++)
+	{
+		memset(&t, 0, sizeof(t));
+		if (!LoadTGATextureData(files[i], &t))
+			continue;
+		name = strrchr(files[i], '/') + 1;
+		TestImage(name, &t);
+		free(t.imageData);
+	}
+	MakeGradient(&t, 1021, 509, 24);
+	TestImage("gradient24_1021x509", &t);
+	free(t.imageData);
+	MakeGradient(&t, 1021, 509, 32);
+	TestImage("gradient32_1021x509", &t);
+	free(t.imageData);
+	MakeGradient(&t, 1021, 509, 8);
+	TestImage("gradient8_1021x509", &t);
+	free(t.imageData);
+	MakeNoise(&t, 512, 512, 24);
+	TestImage("noise24_512x512", &t);
+	free(t.imageData);
+	return 0;
+}
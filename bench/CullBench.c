@@ -0,0 +1,244 @@
+// CullBench, CullSpheres and CullAABBs at 10^3 to 10^7 objects.
+// Against a loop over SphereInFrustum/AABBInFrustum, with and without the
+// plane cache. The camera turns a little every frame, as in a lab, and the
+// objects are stored in spatial (Morton) order, as a grid or scene graph
+// would have them. The makefile builds it with and without OpenMP.
+
+// 261019: First version.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+
+#include "VectorUtils3.h"
+#include "BenchUtils.h"
+
+#define kMaxObjects 10000000
+#define kWorldSize 100.0 // Objects in -kWorldSize..kWorldSize
+#define kFrames 64
+#define kMinTime 0.05
+
+static vec3 *centers, *mins, *maxs;
+static GLfloat *radii;
+static unsigned int *mask, *loopMask;
+static unsigned char *cache;
+static frustumPlanes frames[kFrames];
+static int count, frame, visible;
+
+static const frustumPlanes *NextFrame(void)
+{
+	frame = (frame + 1) % kFrames;
+	return &frames[frame];
+}
+
+static void LoopSpheres(void)
+{
+	const frustumPlanes *f = NextFrame();
+	int i;
+
+	visible = 0;
+	memset(loopMask, 0, CullMaskWords(count) * sizeof(unsigned int));
+	for (i = 0; i < count; i++)
+		if (SphereInFrustum(f, centers[i], radii[i]))
+		{
+			loopMask[i / 32] |= 1u << (i % 32);
+			visible++;
+		}
+}
+
+static void BatchSpheres(void)
+{
+	visible = CullSpheres(NextFrame(), centers, radii, count, NULL, mask, NULL);
+}
+
+static void BatchSpheresCached(void)
+{
+	visible = CullSpheres(NextFrame(), centers, radii, count, cache, mask, NULL);
+}
+
+static void LoopAABBs(void)
+{
+	const frustumPlanes *f = NextFrame();
+	int i;
+
+	visible = 0;
+	memset(loopMask, 0, CullMaskWords(count) * sizeof(unsigned int));
+	for (i = 0; i < count; i++)
+		if (AABBInFrustum(f, mins[i], maxs[i]))
+		{
+			loopMask[i / 32] |= 1u << (i % 32);
+			visible++;
+		}
+}
+
+static void BatchAABBs(void)
+{
+	visible = CullAABBs(NextFrame(), mins, maxs, count, NULL, mask, NULL);
+}
+
+static void BatchAABBsCached(void)
+{
+	visible = CullAABBs(NextFrame(), mins, maxs, count, cache, mask, NULL);
+}
+
+typedef struct
+{
+	const char *name;
+	void (*run)(void);
+} CullOp;
+
+static CullOp ops[] =
+{
+	{"SphereInFrustum_loop", LoopSpheres},
+	{"CullSpheres", BatchSpheres},
+	{"CullSpheres_cached", BatchSpheresCached},
+	{"AABBInFrustum_loop", LoopAABBs},
+	{"CullAABBs", BatchAABBs},
+	{"CullAABBs_cached", BatchAABBsCached},
+};
+
+static double TimeOp(CullOp *op)
+{
+	double t0, t, best = 1e30, total = 0.0;
+	int reps = 0;
+
+	memset(cache, 0, CullCacheSize(count));
+	op->run();
+	while (total < kMinTime || reps < 3)
+	{
+		t0 = BenchTime();
+		op->run();
+		t = BenchTime() - t0;
+		total += t;
+		reps++;
+		if (t < best)
+			best = t;
+	}
+	return best;
+}
+
+// --- Scene ---
+
+typedef struct
+{
+	unsigned long long key;
+	vec3 center;
+} SortItem;
+
+// Interleaves the bits of x, y and z, 21 each
+static unsigned long long Morton(unsigned int x, unsigned int y, unsigned int z)
+{
+	unsigned long long key = 0;
+	int b;
+
+	for (b = 0; b < 21; b++)
+		key |= ((unsigned long long)((x >> b) & 1) << (3*b))
+			| ((unsigned long long)((y >> b) & 1) << (3*b + 1))
+			| ((unsigned long long)((z >> b) & 1) << (3*b + 2));
+	return key;
+}
+
+static int CompareKeys(const void *a, const void *b)
+{
+	unsigned long long ka = ((const SortItem *)a)->key, kb = ((const SortItem *)b)->key;
+
+	return ka < kb ? -1 : (ka > kb ? 1 : 0);
+}
+
+static unsigned int Cell(GLfloat v)
+{
+	return (unsigned int)((v + kWorldSize) / (2 * kWorldSize) * 2097151.0);
+}
+
+static void Allocate(void)
+{
+	int i;
+
+	centers = (vec3 *)malloc(kMaxObjects * sizeof(vec3));
+	mins = (vec3 *)malloc(kMaxObjects * sizeof(vec3));
+	maxs = (vec3 *)malloc(kMaxObjects * sizeof(vec3));
+	radii = (GLfloat *)malloc(kMaxObjects * sizeof(GLfloat));
+	mask = (unsigned int *)malloc(CullMaskWords(kMaxObjects) * sizeof(unsigned int));
+	loopMask = (unsigned int *)malloc(CullMaskWords(kMaxObjects) * sizeof(unsigned int));
+	cache = (unsigned char *)malloc(CullCacheSize(kMaxObjects));
+
+	// From the center, turning half a degree per frame
+	for (i = 0; i < kFrames; i++)
+		frames[i] = ExtractFrustumPlanes(Mult(perspective(60, 16.0 / 9.0, 0.1, 150),
+			lookAt(0, 0, 0, sin(i * M_PI / 360), 0, -cos(i * M_PI / 360), 0, 1, 0)));
+}
+
+// count objects spread over the whole world, then sorted
+static void MakeScene(void)
+{
+	SortItem *items;
+	GLfloat r;
+	int i;
+
+	items = (SortItem *)malloc(count * sizeof(SortItem));
+	for (i = 0; i < count; i++)
+	{
+		items[i].center = SetVector(BenchUniform(-kWorldSize, kWorldSize),
+			BenchUniform(-kWorldSize, kWorldSize), BenchUniform(-kWorldSize, kWorldSize));
+		items[i].key = Morton(Cell(items[i].center.x), Cell(items[i].center.y), Cell(items[i].center.z));
+	}
+	qsort(items, count, sizeof(SortItem), CompareKeys);
+	for (i = 0; i < count; i++)
+	{
+		r = BenchUniform(0.5, 2.0);
+		centers[i] = items[i].center;
+		radii[i] = r;
+		mins[i] = VectorSub(centers[i], SetVector(r, r, r));
+		maxs[i] = VectorAdd(centers[i], SetVector(r, r, r));
+	}
+	free(items);
+}
+
+// The batch calls must give the same mask and count as the loops
+static int SameAsLoop(void (*loop)(void), void (*batch)(void))
+{
+	int loopVisible;
+
+	frame = 0;
+	loop();
+	loopVisible = visible;
+	frame = 0;
+	batch();
+	return visible == loopVisible && memcmp(mask, loopMask, CullMaskWords(count) * sizeof(unsigned int)) == 0;
+}
+
+int main(int argc, char **argv)
+{
+	char param[32];
+	double t;
+	int j, threads = 1;
+
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	BenchInit("cull");
+	Allocate();
+	for (count = 1000; count <= kMaxObjects; count *= 10)
+	{
+		MakeScene();
+		sprintf(param, "%d", count);
+		for (j = 0; j < (int)(sizeof(ops) / sizeof(ops[0])); j++)
+		{
+			t = TimeOp(&ops[j]);
+			BenchReport(ops[j].name, param, "ns_per_object", t / count * 1e9);
+			BenchReport(ops[j].name, param, "mobjects_s", count / t * 1e-6);
+		}
+		BenchReport("scene", param, "visible_pct", 100.0 * visible / count);
+		memset(cache, 0, CullCacheSize(count));
+		BenchReport("CullSpheres", param, "same_as_loop", SameAsLoop(LoopSpheres, BatchSpheres));
+		BenchReport("CullSpheres_cached", param, "same_as_loop", SameAsLoop(LoopSpheres, BatchSpheresCached));
+		BenchReport("CullAABBs", param, "same_as_loop", SameAsLoop(LoopAABBs, BatchAABBs));
+		BenchReport("CullAABBs_cached", param, "same_as_loop", SameAsLoop(LoopAABBs, BatchAABBsCached));
+	}
+	BenchReport("all", "threads", "count", threads);
+	return 0;
+}
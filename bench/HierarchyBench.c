@@ -0,0 +1,165 @@
+// HierarchyBench, THUpdate on 10^5 nodes against recomputing every world
+// matrix. A deep chain (every node the child of the one before, like the
+// lab2-ny bones) and a wide tree (8 children per node), with everything,
+// the root, one node halfway down, one leaf or nothing changed per frame.
+// The locals are set before the clock starts; set_all times THSetLocal on
+// every node by itself.
+
+// 261019: First version.
+// 261019: THSetLocal is timed apart from THUpdate.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "VectorUtils3.h"
+#include "TransformHierarchy.h"
+#include "BenchUtils.h"
+
+#define kNodes 100000
+#define kBranching 8
+#define kMinTime 0.05
+
+static TransformHierarchy *h;
+static mat4 localA[kNodes], localB[kNodes], naiveWorld[kNodes];
+static int frame, changedNode, recomputed;
+
+// Alternates between two sets of locals, so every set is a real change
+static mat4 *FrameLocals(void)
+{
+	frame++;
+	return (frame & 1) ? localB : localA;
+}
+
+static void SetAll(void)
+{
+	mat4 *l = FrameLocals();
+	int i;
+
+	for (i = 0; i < kNodes; i++)
+		THSetLocal(h, i, &l[i]);
+	recomputed = 0;
+}
+
+static void SetOne(void)
+{
+	THSetLocal(h, changedNode, &FrameLocals()[changedNode]);
+}
+
+static void Update(void)
+{
+	recomputed = THUpdate(h);
+}
+
+// What lab2-ny did before, every product every frame
+static void Naive(void)
+{
+	int i, p;
+
+	for (i = 0; i < kNodes; i++)
+	{
+		p = h->parent[i];
+		naiveWorld[i] = p < 0 ? h->local[i] : Mult(naiveWorld[p], h->local[i]);
+	}
+	recomputed = kNodes;
+}
+
+typedef struct
+{
+	const char *name;
+	void (*prepare)(void); // Before each run, not timed
+	void (*run)(void);
+	int node; // For SetOne, -1 for the middle, -2 for the last leaf
+} HierarchyCase;
+
+static HierarchyCase cases[] =
+{
+	{"set_all", NULL, SetAll, 0},
+	{"all_dirty", SetAll, Update, 0},
+	{"root_dirty", SetOne, Update, 0},
+	{"middle_dirty", SetOne, Update, -1},
+	{"leaf_dirty", SetOne, Update, -2},
+	{"none_dirty", NULL, Update, 0},
+	{"naive", NULL, Naive, 0},
+};
+
+static double TimeCase(HierarchyCase *c)
+{
+	double t0, t, best = 1e30, total = 0.0;
+	int reps = 0;
+
+	if (c->prepare)
+		c->prepare();
+	c->run();
+	while (total < kMinTime || reps < 3)
+	{
+		if (c->prepare)
+			c->prepare();
+		t0 = BenchTime();
+		c->run();
+		t = BenchTime() - t0;
+		total += t;
+		reps++;
+		if (t < best)
+			best = t;
+	}
+	return best;
+}
+
+// Small rigid steps, so 10^5 of them in a row stay finite
+static void MakeLocals(void)
+{
+	vec3 axis;
+	int i;
+
+	for (i = 0; i < kNodes; i++)
+	{
+		axis = Normalize(SetVector(BenchUniform(-1, 1), BenchUniform(-1, 1), BenchUniform(-1, 1)));
+		localA[i] = Mult(T(BenchUniform(-1, 1), 1, 0), ArbRotate(axis, BenchUniform(-0.01, 0.01)));
+		localB[i] = Mult(T(BenchUniform(-1, 1), 1, 0), ArbRotate(axis, BenchUniform(-0.01, 0.01)));
+	}
+}
+
+static TransformHierarchy *MakeTree(int wide)
+{
+	TransformHierarchy *t = THCreate(kNodes);
+	int i;
+
+	for (i = 0; i < kNodes; i++)
+		THAddNode(t, i == 0 ? -1 : (wide ? (i - 1) / kBranching : i - 1), localA[i]);
+	THUpdate(t);
+	return t;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *shapes[2] = {"chain", "wide"};
+	double t;
+	int s, j;
+
+	BenchInit("hierarchy");
+	MakeLocals();
+	for (s = 0; s < 2; s++)
+	{
+		h = MakeTree(s);
+		for (j = 0; j < (int)(sizeof(cases) / sizeof(cases[0])); j++)
+		{
+			changedNode = cases[j].node;
+			if (changedNode == -1)
+				changedNode = s ? kBranching + 1 : kNodes / 2; // Depth 2 in the wide tree
+			else if (changedNode == -2)
+				changedNode = kNodes - 1;
+			t = TimeCase(&cases[j]);
+			BenchReport(cases[j].name, shapes[s], "us", t * 1e6);
+			BenchReport(cases[j].name, shapes[s], "nodes_recomputed", recomputed);
+		}
+		// THUpdate must give exactly the products the naive loop does
+		SetAll();
+		Update();
+		Naive();
+		BenchReport("THUpdate", shapes[s], "same_as_naive", memcmp(h->world, naiveWorld, kNodes * sizeof(mat4)) == 0);
+		THDispose(h);
+	}
+	return 0;
+}
@@ -0,0 +1,272 @@
+// KernelBench, two lab hot loops built with and without VECTORUTILS3_INLINE.
+// The lab3 physics step (updateWorld, without the drawing) and the lab2-ny
+// CPU deformation (DeformCylinder as the lab hands it out, a MultVec3,
+// ScalarMult and VectorAdd per vertex and bone, plus SkinVec3Array for
+// comparison). The makefile builds it twice, "make run" prints both. The
+// checksums must be the same in both builds.
+
+// 261019: First version.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "VectorUtils3.h"
+#include "BenchUtils.h"
+
+#define kMinTime 0.05
+
+// --- lab3 ---
+
+#define kBallSize 0.1
+#define kMaxBalls 64
+#define kSteps 1000
+#define kDeltaT 0.01
+
+typedef struct
+{
+	GLfloat mass;
+	vec3 position, linearMomentum, angularMomentum;
+	quat rotation;
+	vec3 F, T;
+	vec3 angularVelocity;
+	vec3 v;
+} Ball;
+
+static Ball ball[kMaxBalls];
+static int numBalls;
+static const float friction = 0.1;
+
+// As in lab3.c, but fabs where lab3 has abs
+static void UpdateWorld(void)
+{
+	int i, j;
+
+	for (i = 0; i < numBalls; i++)
+	{
+		ball[i].F = SetVector(0,0,0);
+		ball[i].T = SetVector(0,0,0);
+	}
+
+	for (i = 0; i < numBalls; i++)
+	{
+		if (ball[i].position.x < -0.82266270 + kBallSize)
+			ball[i].linearMomentum.x = fabs(ball[i].linearMomentum.x);
+		if (ball[i].position.x > 0.82266270 - kBallSize)
+			ball[i].linearMomentum.x = -fabs(ball[i].linearMomentum.x);
+		if (ball[i].position.z < -1.84146270 + kBallSize)
+			ball[i].linearMomentum.z = fabs(ball[i].linearMomentum.z);
+		if (ball[i].position.z > 1.84146270 - kBallSize)
+			ball[i].linearMomentum.z = -fabs(ball[i].linearMomentum.z);
+	}
+
+	for (i = 0; i < numBalls; i++)
+		for (j = i+1; j < numBalls; j++)
+		{
+			vec3 positionDiff = VectorSub(ball[i].position, ball[j].position);
+			float ballDistance = Norm(positionDiff) - kBallSize*2;
+			if (ballDistance <= 0)
+			{
+				vec3 collisionNormal = Normalize(positionDiff);
+				ball[i].position = VectorAdd(ball[i].position, ScalarMult(collisionNormal, -ballDistance/2));
+				ball[j].position = VectorAdd(ball[j].position, ScalarMult(collisionNormal, ballDistance/2));
+
+				vec3 paVelocity = CrossProduct(ball[i].angularVelocity, ScalarMult(collisionNormal, kBallSize));
+				vec3 pbVelocity = CrossProduct(ball[j].angularVelocity, ScalarMult(collisionNormal, kBallSize));
+				vec3 relativeVelocity = VectorSub(
+					VectorAdd(ball[i].v, paVelocity),
+					VectorAdd(ball[j].v, pbVelocity));
+				float vrel = DotProduct(collisionNormal, relativeVelocity);
+				float elasticity = 1.0;
+				float impulseFactor = (1 + elasticity) * vrel / (1/ball[i].mass + 1/ball[j].mass);
+				ball[i].linearMomentum = VectorAdd(ball[i].linearMomentum, ScalarMult(collisionNormal, -impulseFactor));
+				ball[j].linearMomentum = VectorAdd(ball[j].linearMomentum, ScalarMult(collisionNormal, impulseFactor));
+			}
+		}
+
+	for (i = 0; i < numBalls; i++)
+	{
+		vec3 surfaceVelocity = VectorAdd(
+			ball[i].v,
+			CrossProduct(ball[i].angularVelocity, SetVector(0, -kBallSize, 0)));
+		ball[i].F = ScalarMult(surfaceVelocity, -friction * ball[i].mass * 10);
+		ball[i].T = CrossProduct(ball[i].F, SetVector(0, kBallSize, 0));
+	}
+
+	for (i = 0; i < numBalls; i++)
+	{
+		float inertia = 2.0f/5.0f * ball[i].mass * pow(kBallSize, 2);
+		ball[i].angularVelocity = ScalarMult(ball[i].angularMomentum, 1/inertia);
+		ball[i].v = ScalarMult(ball[i].linearMomentum, 1.0/(ball[i].mass));
+		ball[i].position = VectorAdd(ball[i].position, ScalarMult(ball[i].v, kDeltaT));
+		ball[i].rotation = QuatIntegrate(ball[i].rotation, ball[i].angularVelocity, kDeltaT);
+		ball[i].linearMomentum = VectorAdd(ball[i].linearMomentum, ScalarMult(ball[i].F, kDeltaT));
+		ball[i].angularMomentum = VectorAdd(ball[i].angularMomentum, ScalarMult(ball[i].T, kDeltaT));
+	}
+}
+
+// The same start every time, so both builds do the same work
+static void ResetBalls(void)
+{
+	int i;
+
+	BenchSeed(3);
+	for (i = 0; i < numBalls; i++)
+	{
+		memset(&ball[i], 0, sizeof(Ball));
+		ball[i].mass = 1.0;
+		ball[i].position = SetVector(BenchUniform(-0.7, 0.7), 0, BenchUniform(-1.7, 1.7));
+		ball[i].linearMomentum = SetVector(BenchUniform(-1, 1), 0, BenchUniform(-1, 1));
+		ball[i].rotation = IdentityQuat();
+	}
+}
+
+static void PhysicsRun(void)
+{
+	int s;
+
+	ResetBalls();
+	for (s = 0; s < kSteps; s++)
+		UpdateWorld();
+}
+
+// --- lab2-ny ---
+
+#define kMaxBones 10
+#define kCorners 8
+
+static mat4 boneRot[kMaxBones], boneRest[kMaxBones], completeMatrix[kMaxBones];
+static vec3 bonePos[kMaxBones];
+static vec3 *vertsOrg, *vertsRes;
+static GLfloat *boneWeights;
+static int rows;
+
+static void DeformCylinder(void)
+{
+	mat4 boneLocal[kMaxBones], boneAnim[kMaxBones];
+	int v, b, n = rows * kCorners;
+
+	for (b = 0; b < kMaxBones; b++)
+		boneLocal[b] = Mult(T(bonePos[b].x, bonePos[b].y, bonePos[b].z), boneRot[b]);
+	boneAnim[0] = boneLocal[0];
+	for (b = 1; b < kMaxBones; b++)
+		boneAnim[b] = Mult(boneAnim[b-1], boneLocal[b]);
+	for (b = 0; b < kMaxBones; b++)
+		completeMatrix[b] = Mult(boneAnim[b], boneRest[b]);
+
+	for (v = 0; v < n; v++)
+	{
+		vertsRes[v] = SetVector(0, 0, 0);
+		for (b = 0; b < kMaxBones; b++)
+		{
+			vec3 transformedVert = MultVec3(completeMatrix[b], vertsOrg[v]);
+			vec3 weightedVert = ScalarMult(transformedVert, boneWeights[v * kMaxBones + b]);
+			vertsRes[v] = VectorAdd(vertsRes[v], weightedVert);
+		}
+	}
+}
+
+// After DeformCylinder, which set completeMatrix
+static void SkinCylinder(void)
+{
+	SkinVec3Array(completeMatrix, kMaxBones, boneWeights, vertsOrg, vertsRes, rows * kCorners);
+}
+
+// As the lab builds the cylinder and its weights, for any number of rows
+static void MakeCylinder(int n)
+{
+	int row, corner, b;
+	double d, sum;
+	GLfloat *w;
+
+	rows = n;
+	free(vertsOrg);
+	free(vertsRes);
+	free(boneWeights);
+	vertsOrg = (vec3 *)malloc(rows * kCorners * sizeof(vec3));
+	vertsRes = (vec3 *)malloc(rows * kCorners * sizeof(vec3));
+	boneWeights = (GLfloat *)malloc(rows * kCorners * kMaxBones * sizeof(GLfloat));
+	for (row = 0; row < rows; row++)
+		for (corner = 0; corner < kCorners; corner++)
+		{
+			vertsOrg[row * kCorners + corner] = SetVector(row * 10.0 / rows * 10,
+				cos(corner * 2 * M_PI / kCorners), sin(corner * 2 * M_PI / kCorners));
+			w = &boneWeights[(row * kCorners + corner) * kMaxBones];
+			sum = 0.0;
+			for (b = 0; b < kMaxBones; b++)
+			{
+				d = (row + 0.5) * kMaxBones / rows - (b + 0.5);
+				sum += w[b] = exp(-d * d);
+			}
+			for (b = 0; b < kMaxBones; b++)
+				w[b] /= sum;
+		}
+	for (b = 0; b < kMaxBones; b++)
+	{
+		bonePos[b] = SetVector(b == 0 ? 0.0 : 10.0, 0, 0);
+		boneRest[b] = T(-b * 10.0, 0, 0);
+		boneRot[b] = Rz(0.5 * (b < 5 ? 1 : -1) * 0.3);
+	}
+}
+
+// --- Test ---
+
+static double TimeRun(void (*run)(void))
+{
+	double t0, t, best = 1e30, total = 0.0;
+	int reps = 0;
+
+	run();
+	while (total < kMinTime || reps < 3)
+	{
+		t0 = BenchTime();
+		run();
+		t = BenchTime() - t0;
+		total += t;
+		reps++;
+		if (t < best)
+			best = t;
+	}
+	return best;
+}
+
+static double Checksum(const vec3 *v, int n)
+{
+	double sum = 0.0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		sum += v[i].x * (i % 7 + 1) + v[i].y * (i % 5 + 1) + v[i].z * (i % 3 + 1);
+	return sum;
+}
+
+int main(int argc, char **argv)
+{
+	static const int ballCounts[3] = {4, 16, 64};
+	static const int rowCounts[2] = {100, 10000};	// The lab has 100
+	char param[32];
+	vec3 positions[kMaxBalls];
+	int i, n;
+
+	BenchInit("kernel");
+	for (i = 0; i < 3; i++)
+	{
+		numBalls = ballCounts[i];
+		sprintf(param, "%d_balls", numBalls);
+		BenchReport("updateWorld", param, "ns_per_step", TimeRun(PhysicsRun) / kSteps * 1e9);
+		PhysicsRun();
+		for (n = 0; n < numBalls; n++)
+			positions[n] = ball[n].position;
+		BenchReport("updateWorld", param, "checksum", Checksum(positions, numBalls));
+	}
+	for (i = 0; i < 2; i++)
+	{
+		MakeCylinder(rowCounts[i]);
+		sprintf(param, "%d_vertices", rows * kCorners);
+		BenchReport("DeformCylinder", param, "ns_per_vertex", TimeRun(DeformCylinder) / (rows * kCorners) * 1e9);
+		BenchReport("DeformCylinder", param, "checksum", Checksum(vertsRes, rows * kCorners));
+		BenchReport("SkinVec3Array", param, "ns_per_vertex", TimeRun(SkinCylinder) / (rows * kCorners) * 1e9);
+	}
+	return 0;
+}
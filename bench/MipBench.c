@@ -0,0 +1,318 @@
+// MipBench, speed and accuracy of BuildTGAMipChain.
+// Every level is compared to a reference chain built in double with the
+// exact sRGB curves and kernels, where LoadTGA uses floats and tables.
+// Images are the bundled textures and a few synthetic ones: NPOT sizes,
+// hard alpha edges (dark halos if alpha is not premultiplied), a zone plate
+// (aliasing) and 8 bit data. Both filters, Kaiser and Lanczos 3.
+
+// 261019: First version.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "LoadTGA.h"
+#include "BenchUtils.h"
+
+#define kRadius 3.0 // In destination pixels, as in LoadTGA
+#define kPasses 3
+
+static char *files[] =
+{
+	"../Lab0/textures/maskros512.tga",
+	"../Lab0/textures/grass.tga",
+	"../lab1-2/bumpmaps/noise.tga",
+	"../lab3/balls/8.tga",
+	"../lab3/surface.tga",
+	"../lab4/bilder/leaves.tga",
+	"../lab4/bilder/dog.tga",
+};
+
+// --- Reference ---
+
+static double SRGBToLinear(double c)
+{
+	return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+}
+
+static double LinearToSRGB(double l)
+{
+	return l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+}
+
+static double Sinc(double x)
+{
+	if (x == 0.0)
+		return 1.0;
+	x *= M_PI;
+	return sin(x) / x;
+}
+
+// Summed until the terms no longer matter
+static double BesselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	int k;
+
+	for (k = 1; term > sum * 1e-17; k++)
+	{
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static double Kernel(int filter, double t)
+{
+	if (fabs(t) >= kRadius)
+		return 0.0;
+	if (filter == kTGAMipmapLanczos)
+		return Sinc(t) * Sinc(t / kRadius);
+	return Sinc(t) * BesselI0(4.0 * sqrt(1.0 - (t / kRadius) * (t / kRadius))) / BesselI0(4.0);
+}
+
+// One axis of a level, RGBA doubles, edges clamped. stride is in pixels.
+static void FilterAxis(int filter, const double *src, int srcSize, double *dest, int destSize,
+	int count, int srcStride, int destStride, int lineStrideSrc, int lineStrideDest)
+{
+	double scale = (double)srcSize / destSize, center, w, sum, acc[4];
+	int line, d, i, first, last, j, c;
+
+	for (line = 0; line < count; line++)
+		for (d = 0; d < destSize; d++)
+		{
+			center = (d + 0.5) * scale;
+			first = (int)floor(center - kRadius * scale);
+			last = (int)ceil(center + kRadius * scale);
+			sum = 0.0;
+			acc[0] = acc[1] = acc[2] = acc[3] = 0.0;
+			for (i = first; i <= last; i++)
+			{
+				w = Kernel(filter, (i + 0.5 - center) / scale);
+				j = i < 0 ? 0 : (i >= srcSize ? srcSize - 1 : i);
+				for (c = 0; c < 4; c++)
+					acc[c] += w * src[(line * lineStrideSrc + j * srcStride) * 4 + c];
+				sum += w;
+			}
+			for (c = 0; c < 4; c++)
+				dest[(line * lineStrideDest + d * destStride) * 4 + c] = acc[c] / sum;
+		}
+}
+
+static unsigned char ToByte(double v)
+{
+	v = floor(v * 255.0 + 0.5);
+	return v < 0.0 ? 0 : (v > 255.0 ? 255 : (unsigned char)v);
+}
+
+// Builds the reference for level 1 and down, tightly packed like TGAMipChain
+static int ReferenceChain(TextureData *t, int filter, unsigned char **levels)
+{
+	int bytes = t->bpp / 8, w = t->width, h = t->height, nw, nh, n = 1, x, y, c;
+	double *cur, *tmp, *next, a;
+	unsigned char *p, *out;
+
+	cur = (double *)malloc((long)w * h * 4 * sizeof(double));
+	for (y = 0; y < h; y++)
+		for (x = 0; x < w; x++)
+		{
+			p = &t->imageData[((long)y * t->w + x) * bytes];
+			if (bytes == 1)
+			{
+				cur[((long)y * w + x) * 4] = p[0] / 255.0;
+				for (c = 1; c < 4; c++)
+					cur[((long)y * w + x) * 4 + c] = 0.0;
+				continue;
+			}
+			a = bytes == 4 ? p[3] / 255.0 : 1.0;
+			for (c = 0; c < 3; c++)
+				cur[((long)y * w + x) * 4 + c] = SRGBToLinear(p[c] / 255.0) * a;
+			cur[((long)y * w + x) * 4 + 3] = a;
+		}
+	while ((w > 1 || h > 1) && n < kTGAMaxMipLevels)
+	{
+		nw = w > 1 ? w / 2 : 1;
+		nh = h > 1 ? h / 2 : 1;
+		tmp = (double *)malloc((long)nw * h * 4 * sizeof(double));
+		next = (double *)malloc((long)nw * nh * 4 * sizeof(double));
+		FilterAxis(filter, cur, w, tmp, nw, h, 1, 1, w, nw);	// Rows
+		FilterAxis(filter, tmp, h, next, nh, nw, nw, nw, 1, 1);	// Columns
+		free(tmp);
+		free(cur);
+		cur = next;
+		w = nw;
+		h = nh;
+
+		out = levels[n++] = (unsigned char *)malloc((long)w * h * bytes);
+		for (x = 0; x < w * h; x++)
+		{
+			if (bytes == 1)
+			{
+				out[x] = ToByte(cur[x * 4]);
+				continue;
+			}
+			a = cur[x * 4 + 3];
+			for (c = 0; c < 3; c++)
+				out[x * bytes + c] = ToByte(LinearToSRGB(a > 0.0 ? fmin(fmax(cur[x * 4 + c] / a, 0.0), 1.0) : 0.0));
+			if (bytes == 4)
+				out[x * 4 + 3] = ToByte(a);
+		}
+	}
+	free(cur);
+	return n;
+}
+
+// --- Synthetic images ---
+
+static void NewImage(TextureData *t, int width, int height, int bpp)
+{
+	memset(t, 0, sizeof(TextureData));
+	t->width = t->w = width;
+	t->height = t->h = height;
+	t->bpp = bpp;
+	t->imageData = (GLubyte *)malloc((long)width * height * (bpp / 8));
+}
+
+// Saturated colors inside a disc, transparent black outside
+static void MakeAlphaDisc(TextureData *t)
+{
+	int x, y;
+	GLubyte *p;
+	double dx, dy;
+
+	NewImage(t, 301, 203, 32);
+	for (y = 0; y < 203; y++)
+		for (x = 0; x < 301; x++)
+		{
+			p = &t->imageData[(y * 301 + x) * 4];
+			dx = x - 150.5;
+			dy = y - 101.5;
+			p[0] = (x / 16) & 1 ? 255 : 0;
+			p[1] = (y / 16) & 1 ? 255 : 0;
+			p[2] = 255;
+			p[3] = dx*dx + dy*dy < 90.0 * 90.0 ? 255 : 0;
+			if (p[3] == 0)
+				p[0] = p[1] = p[2] = 0;
+		}
+}
+
+// Frequency rises from the center out, to past Nyquist
+static void MakeZonePlate(TextureData *t)
+{
+	int x, y;
+	double dx, dy, v;
+
+	NewImage(t, 1000, 600, 24);
+	for (y = 0; y < 600; y++)
+		for (x = 0; x < 1000; x++)
+		{
+			dx = x - 500;
+			dy = y - 300;
+			v = 0.5 + 0.5 * cos(M_PI * (dx*dx + dy*dy) / 1000.0);
+			memset(&t->imageData[(y * 1000 + x) * 3], (int)(v * 255.0 + 0.5), 3);
+		}
+}
+
+static void MakeHeightField(TextureData *t)
+{
+	int x, y;
+
+	NewImage(t, 333, 197, 8);
+	for (y = 0; y < 197; y++)
+		for (x = 0; x < 333; x++)
+			t->imageData[y * 333 + x] = (x * 255 / 332 + BenchRandom() % 16) & 255;
+}
+
+// --- Test ---
+
+static void TestImage(const char *name, TextureData *t)
+{
+	static const int filters[2] = {kTGAMipmapKaiser, kTGAMipmapLanczos};
+	static const char *filterNames[2] = {"kaiser", "lanczos"};
+	unsigned char *ref[kTGAMaxMipLevels];
+	TGAMipChain chain;
+	double t0, best, sum, sq, psnr, minPSNR, maxDiff, count, over1, d;
+	long i, n;
+	int f, pass, levels, l, bytes = t->bpp / 8;
+
+	for (f = 0; f < 2; f++)
+	{
+		LoadTGASetMipmapFilter(filters[f]);
+		best = 1e30;
+		for (pass = 0; pass < kPasses; pass++)
+		{
+			t0 = BenchTime();
+			BuildTGAMipChain(t, &chain);
+			t0 = BenchTime() - t0;
+			if (t0 < best)
+				best = t0;
+			if (pass < kPasses - 1)
+				DisposeTGAMipChain(&chain);
+		}
+
+		levels = ReferenceChain(t, filters[f], ref);
+		if (levels != chain.levels)
+		{
+			BenchReport(name, filterNames[f], "level_mismatch", 1);
+			levels = levels < chain.levels ? levels : chain.levels;
+		}
+		sum = count = over1 = maxDiff = 0.0;
+		minPSNR = 99.0;
+		for (l = 1; l < levels; l++)
+		{
+			n = (long)chain.width[l] * chain.height[l] * bytes;
+			sq = 0.0;
+			for (i = 0; i < n; i++)
+			{
+				d = fabs((double)chain.data[l][i] - ref[l][i]);
+				sum += d;
+				sq += d * d;
+				if (d > 1.0)
+					over1++;
+				if (d > maxDiff)
+					maxDiff = d;
+			}
+			count += n;
+			psnr = sq > 0.0 ? 10.0 * log10(255.0 * 255.0 * n / sq) : 99.0;
+			if (psnr < minPSNR)
+				minPSNR = psnr;
+			free(ref[l]);
+		}
+		BenchReport(name, filterNames[f], "ms", best * 1000.0);
+		BenchReport(name, filterNames[f], "mpix_s", t->width * t->height / best * 1e-6);
+		BenchReport(name, filterNames[f], "max_diff", maxDiff);
+		BenchReport(name, filterNames[f], "mean_diff", count > 0 ? sum / count : 0.0);
+		BenchReport(name, filterNames[f], "pct_over_1", count > 0 ? 100.0 * over1 / count : 0.0);
+		BenchReport(name, filterNames[f], "min_psnr", minPSNR);
+		DisposeTGAMipChain(&chain);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	TextureData t;
+	char *name;
+	int i;
+
+	BenchInit("mip");
+	for (i = 0; i < (int)(sizeof(files) / sizeof(files[0])); i++)
+	{
+		memset(&t, 0, sizeof(t));
+		if (!LoadTGATextureData(files[i], &t))
+			continue;
+		name = strrchr(files[i], '/') + 1;
+		TestImage(name, &t);
+		free(t.imageData);
+	}
+	MakeAlphaDisc(&t);
+	TestImage("alphadisc_301x203", &t);
+	free(t.imageData);
+	MakeZonePlate(&t);
+	TestImage("zoneplate_1000x600", &t);
+	free(t.imageData);
+	MakeHeightField(&t);
+	TestImage("height8_333x197", &t);
+	free(t.imageData);
+	return 0;
+}
@@ -0,0 +1,366 @@
+// QuatBench, quaternions and dual quaternions against mat4.
+// Per body: the lab3 orientation step (the old mat4 integration with
+// CrossMatrix, Mult, MatrixAdd and OrthoNormalizeMatrix against
+// QuatIntegrate), composing and applying rotations and rigid transforms,
+// and how far each drifts from the exact rotation over a long run.
+// Per vertex: the batch rotations and skinning, linear blend against dual
+// quaternion, plus the volume lost in a twisted joint.
+
+// 261019: First version.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "VectorUtils3.h"
+#include "BenchUtils.h"
+
+#define kBodies 10000
+#define kVertices 100000
+#define kBones 4
+#define kSteps 100000 // For the drift test
+#define kDeltaT 0.01
+#define kMinTime 0.05
+
+static mat4 rotA[kBodies], rotB[kBodies], rotOut[kBodies];
+static quat quatA[kBodies], quatB[kBodies], quatOut[kBodies];
+static dualquat dqA[kBodies], dqB[kBodies], dqOut[kBodies];
+static vec3 omega[kBodies], vecIn[kBodies], vecOut[kBodies];
+static vec3 *points, *outPoints;
+static GLfloat *weights;
+static mat4 boneMats[kBones];
+static dualquat boneDQs[kBones];
+
+// Element (row, col) as in the math, whatever the layout
+static double Get4(const mat4 *a, int r, int c)
+{
+	return VECTORUTILS3_TRANSPOSED ? a->m[c*4 + r] : a->m[r*4 + c];
+}
+
+// --- Per body ---
+
+// As lab3 did it before the quaternions
+static mat4 IntegrateMat4(mat4 r, vec3 w, GLfloat dt)
+{
+	mat4 rd;
+
+	rd = Mult(CrossMatrix(ScalarMult(w, dt)), r);
+	r = MatrixAdd(r, rd);
+	OrthoNormalizeMatrix(&r);
+	return r;
+}
+
+static void BodyIntegrateMat4(void)
+{
+	int i;
+
+	for (i = 0; i < kBodies; i++)
+		rotOut[i] = IntegrateMat4(rotA[i], omega[i], kDeltaT);
+}
+
+static void BodyIntegrateQuat(void)
+{
+	int i;
+
+	for (i = 0; i < kBodies; i++)
+		quatOut[i] = QuatIntegrate(quatA[i], omega[i], kDeltaT);
+}
+
+static void BodyMult(void)
+{
+	int i;
+
+	for (i = 0; i < kBodies; i++)
+		rotOut[i] = Mult(rotA[i], rotB[i]);
+}
+
+static void BodyQuatMult(void)
+{
+	int i;
+
+	for (i = 0; i < kBodies; i++)
+		quatOut[i] = QuatMult(quatA[i], quatB[i]);
+}
+
+static void BodyDualQuatMult(void)
+{
+	int i;
+
+	for (i = 0; i < kBodies; i++)
+		dqOut[i] = DualQuatMult(dqA[i], dqB[i]);
+}
+
+static void BodyMultVec3(void)
+{
+	int i;
+
+	for (i = 0; i < kBodies; i++)
+		vecOut[i] = MultVec3(rotA[i], vecIn[i]);
+}
+
+static void BodyQuatRotate(void)
+{
+	int i;
+
+	for (i = 0; i < kBodies; i++)
+		vecOut[i] = QuatRotateVec3(quatA[i], vecIn[i]);
+}
+
+static void BodyDualQuatPoint(void)
+{
+	int i;
+
+	for (i = 0; i < kBodies; i++)
+		vecOut[i] = DualQuatTransformPoint(dqA[i], vecIn[i]);
+}
+
+// What drawing costs on top of the quaternion
+static void BodyQuatToMat4(void)
+{
+	int i;
+
+	for (i = 0; i < kBodies; i++)
+		rotOut[i] = QuatToMat4(quatA[i]);
+}
+
+static void BodyDualQuatToMat4(void)
+{
+	int i;
+
+	for (i = 0; i < kBodies; i++)
+		rotOut[i] = DualQuatToMat4(dqA[i]);
+}
+
+// --- Per vertex ---
+
+static void VertexMultVec3Array(void)
+{
+	MultVec3Array(rotA[0], points, outPoints, kVertices);
+}
+
+static void VertexQuatRotateArray(void)
+{
+	QuatRotateVec3Array(quatA[0], points, outPoints, kVertices);
+}
+
+static void VertexSkinMat4(void)
+{
+	SkinVec3Array(boneMats, kBones, weights, points, outPoints, kVertices);
+}
+
+static void VertexSkinDualQuat(void)
+{
+	SkinDualQuatVec3Array(boneDQs, kBones, weights, points, outPoints, kVertices);
+}
+
+typedef struct
+{
+	const char *name;
+	void (*run)(void);
+	int count;
+	const char *metric;
+} QuatOp;
+
+static QuatOp ops[] =
+{
+	{"integrate_mat4", BodyIntegrateMat4, kBodies, "ns_per_body"},
+	{"QuatIntegrate", BodyIntegrateQuat, kBodies, "ns_per_body"},
+	{"Mult", BodyMult, kBodies, "ns_per_body"},
+	{"QuatMult", BodyQuatMult, kBodies, "ns_per_body"},
+	{"DualQuatMult", BodyDualQuatMult, kBodies, "ns_per_body"},
+	{"MultVec3", BodyMultVec3, kBodies, "ns_per_body"},
+	{"QuatRotateVec3", BodyQuatRotate, kBodies, "ns_per_body"},
+	{"DualQuatTransformPoint", BodyDualQuatPoint, kBodies, "ns_per_body"},
+	{"QuatToMat4", BodyQuatToMat4, kBodies, "ns_per_body"},
+	{"DualQuatToMat4", BodyDualQuatToMat4, kBodies, "ns_per_body"},
+	{"MultVec3Array", VertexMultVec3Array, kVertices, "ns_per_vertex"},
+	{"QuatRotateVec3Array", VertexQuatRotateArray, kVertices, "ns_per_vertex"},
+	{"SkinVec3Array", VertexSkinMat4, kVertices, "ns_per_vertex"},
+	{"SkinDualQuatVec3Array", VertexSkinDualQuat, kVertices, "ns_per_vertex"},
+};
+
+static double TimeOp(QuatOp *op)
+{
+	double t0, t, best = 1e30, total = 0.0;
+	int reps = 0;
+
+	op->run();
+	while (total < kMinTime || reps < 3)
+	{
+		t0 = BenchTime();
+		op->run();
+		t = BenchTime() - t0;
+		total += t;
+		reps++;
+		if (t < best)
+			best = t;
+	}
+	return best;
+}
+
+static vec3 RandomAxis(void)
+{
+	return Normalize(SetVector(BenchUniform(-1, 1), BenchUniform(-1, 1), BenchUniform(-1, 1)));
+}
+
+static void MakeData(void)
+{
+	double sum;
+	vec3 t;
+	int i, b;
+
+	for (i = 0; i < kBodies; i++)
+	{
+		quatA[i] = QuatFromAxisAngle(RandomAxis(), BenchUniform(0, M_PI));
+		quatB[i] = QuatFromAxisAngle(RandomAxis(), BenchUniform(0, M_PI));
+		rotA[i] = QuatToMat4(quatA[i]);
+		rotB[i] = QuatToMat4(quatB[i]);
+		t = SetVector(BenchUniform(-10, 10), BenchUniform(-10, 10), BenchUniform(-10, 10));
+		dqA[i] = DualQuatFromQuatTranslation(quatA[i], t);
+		dqB[i] = DualQuatFromQuatTranslation(quatB[i], ScalarMult(t, -0.5));
+		omega[i] = ScalarMult(RandomAxis(), BenchUniform(0.1, 10));
+		vecIn[i] = SetVector(BenchUniform(-1, 1), BenchUniform(-1, 1), BenchUniform(-1, 1));
+	}
+
+	points = (vec3 *)malloc(kVertices * sizeof(vec3));
+	outPoints = (vec3 *)malloc(kVertices * sizeof(vec3));
+	weights = (GLfloat *)malloc(kVertices * kBones * sizeof(GLfloat));
+	for (i = 0; i < kVertices; i++)
+	{
+		points[i] = SetVector(BenchUniform(-1, 1), BenchUniform(-1, 1), BenchUniform(-1, 1));
+		sum = 0.0;
+		for (b = 0; b < kBones; b++)
+			sum += weights[i * kBones + b] = BenchUniform(0, 1);
+		for (b = 0; b < kBones; b++)
+			weights[i * kBones + b] /= sum;
+	}
+	for (b = 0; b < kBones; b++)
+	{
+		boneDQs[b] = dqA[b];
+		boneMats[b] = DualQuatToMat4(dqA[b]);
+	}
+}
+
+// Largest element of R^T R - I
+static double OrthoError(const mat4 *r)
+{
+	double d, e = 0.0;
+	int i, j, k;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+		{
+			d = i == j ? -1.0 : 0.0;
+			for (k = 0; k < 3; k++)
+				d += Get4(r, k, i) * Get4(r, k, j);
+			if (fabs(d) > e)
+				e = fabs(d);
+		}
+	return e;
+}
+
+// Largest element difference from the exact rotation about axis by angle
+static double RotationError(const mat4 *r, vec3 axis, double angle)
+{
+	double a[3] = {axis.x, axis.y, axis.z}, c = cos(angle), s = sin(angle), n, ref, e = 0.0;
+	double k[3][3];
+	int i, j;
+
+	n = sqrt(a[0]*a[0] + a[1]*a[1] + a[2]*a[2]);
+	for (i = 0; i < 3; i++)
+		a[i] /= n;
+	// The cross product matrix of a
+	k[0][0] = 0.0;	k[0][1] = -a[2];	k[0][2] = a[1];
+	k[1][0] = a[2];	k[1][1] = 0.0;	k[1][2] = -a[0];
+	k[2][0] = -a[1];	k[2][1] = a[0];	k[2][2] = 0.0;
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+		{
+			// Rodrigues: c I + s K + (1 - c) a a^T
+			ref = (i == j ? c : 0.0) + s * k[i][j] + (1 - c) * a[i] * a[j];
+			if (fabs(Get4(r, i, j) - ref) > e)
+				e = fabs(Get4(r, i, j) - ref);
+		}
+	return e;
+}
+
+// Both integrators with constant angular velocity, against the exact answer
+static void TestDrift(void)
+{
+	vec3 w = SetVector(0.3, 1.0, -0.6);
+	mat4 r = IdentityMatrix(), fromQuat;
+	quat q = IdentityQuat();
+	char param[32];
+	int i;
+
+	sprintf(param, "%d_steps", kSteps);
+	for (i = 0; i < kSteps; i++)
+	{
+		r = IntegrateMat4(r, w, kDeltaT);
+		q = QuatIntegrate(q, w, kDeltaT);
+	}
+	fromQuat = QuatToMat4(q);
+	BenchReport("integrate_mat4", param, "ortho_error", OrthoError(&r));
+	BenchReport("QuatIntegrate", param, "ortho_error", OrthoError(&fromQuat));
+	BenchReport("integrate_mat4", param, "rotation_error", RotationError(&r, w, Norm(w) * kDeltaT * kSteps));
+	BenchReport("QuatIntegrate", param, "rotation_error", RotationError(&fromQuat, w, Norm(w) * kDeltaT * kSteps));
+}
+
+// A ring around the x axis, half on a bone twisted by 180 degrees. Linear
+// blending collapses it (the candy wrapper), dual quaternions keep the radius.
+static void TestTwist(void)
+{
+	dualquat dq[2];
+	mat4 m[2];
+	vec3 ring[64], out[64];
+	GLfloat w[128];
+	double r, minMat = 1e30, minDQ = 1e30;
+	int i;
+
+	dq[0] = DualQuatFromQuatTranslation(IdentityQuat(), SetVector(0, 0, 0));
+	dq[1] = DualQuatFromQuatTranslation(QuatFromAxisAngle(SetVector(1, 0, 0), M_PI * 0.999), SetVector(0, 0, 0));
+	m[0] = DualQuatToMat4(dq[0]);
+	m[1] = DualQuatToMat4(dq[1]);
+	for (i = 0; i < 64; i++)
+	{
+		ring[i] = SetVector(0, cos(i * M_PI / 32), sin(i * M_PI / 32));
+		w[i*2] = w[i*2 + 1] = 0.5;
+	}
+	SkinVec3Array(m, 2, w, ring, out, 64);
+	for (i = 0; i < 64; i++)
+	{
+		r = sqrt(out[i].y * out[i].y + out[i].z * out[i].z);
+		if (r < minMat)
+			minMat = r;
+	}
+	SkinDualQuatVec3Array(dq, 2, w, ring, out, 64);
+	for (i = 0; i < 64; i++)
+	{
+		r = sqrt(out[i].y * out[i].y + out[i].z * out[i].z);
+		if (r < minDQ)
+			minDQ = r;
+	}
+	BenchReport("SkinVec3Array", "twist_180", "min_radius", minMat);
+	BenchReport("SkinDualQuatVec3Array", "twist_180", "min_radius", minDQ);
+}
+
+int main(int argc, char **argv)
+{
+	double t;
+	int j;
+
+	BenchInit("quat");
+	MakeData();
+	for (j = 0; j < (int)(sizeof(ops) / sizeof(ops[0])); j++)
+	{
+		t = TimeOp(&ops[j]);
+		BenchReport(ops[j].name, "random", ops[j].metric, t / ops[j].count * 1e9);
+	}
+	BenchReport("mat4", "size", "bytes", sizeof(mat4));
+	BenchReport("quat", "size", "bytes", sizeof(quat));
+	BenchReport("dualquat", "size", "bytes", sizeof(dualquat));
+	TestDrift();
+	TestTwist();
+	return 0;
+}
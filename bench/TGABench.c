@@ -0,0 +1,460 @@
+// TGABench, correctness and speed of LoadTGATextureData.
+// Writes a synthetic corpus to tgacorpus/: types 2, 3, 10 and 11, 8, 24 and
+// 32 bit, both origins (flipped or not), odd NPOT sizes and RLE packets that
+// run over row ends. Every file is decoded by LoadTGA and by the reference
+// decoder below, which must agree. Big images are then timed.
+// "malformed" only runs the broken files: truncated files, bad headers,
+// random bit flips and RLE past the end of the image. Those must be rejected
+// or decoded like the reference does. The makefile also builds this with
+// AddressSanitizer and UndefinedBehaviorSanitizer for that run.
+
+// 261019: First version.
+
+#define _POSIX_C_SOURCE 200809L // fileno
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "LoadTGA.h"
+#include "BenchUtils.h"
+
+#define kCorpusDir "tgacorpus/"
+#define kSpeedSize 2048
+#define kPasses 5
+
+typedef struct
+{
+	int type, bpp;
+} TGAKind;
+
+static TGAKind kinds[] = {{2, 24}, {2, 32}, {3, 8}, {10, 24}, {10, 32}, {11, 8}};
+static int sizes[][2] = {{1, 1}, {7, 3}, {131, 67}, {1021, 509}};
+
+// --- Writing ---
+
+// Runs of equal pixels, 1 to 300 long so they pass both row ends and the
+// 128 pixel packet limit, mixed with noise.
+static unsigned char *MakePixels(int width, int height, int bytes)
+{
+	long n = (long)width * height, i = 0, run, k;
+	unsigned char *p = (unsigned char *)malloc(n * bytes), pixel[4];
+	int c, exact;
+
+	while (i < n)
+	{
+		run = 1 + BenchRandom() % 300;
+		exact = BenchRandom() & 1; // Otherwise noisy, for raw packets
+		for (c = 0; c < bytes; c++)
+			pixel[c] = BenchRandom();
+		for (k = 0; k < run && i < n; k++, i++)
+			for (c = 0; c < bytes; c++)
+				p[i * bytes + c] = exact ? pixel[c] : pixel[c] ^ (BenchRandom() & 3);
+	}
+	return p;
+}
+
+// One stream of packets for the whole image, not per row
+static long EncodeRLE(const unsigned char *p, long n, int bytes, unsigned char *out)
+{
+	long i = 0, o = 0, run, raw;
+
+	while (i < n)
+	{
+		run = 1;
+		while (i + run < n && run < 128 && memcmp(&p[i * bytes], &p[(i + run) * bytes], bytes) == 0)
+			run++;
+		if (run > 1)
+		{
+			out[o++] = 128 + run - 1;
+			memcpy(&out[o], &p[i * bytes], bytes);
+			o += bytes;
+			i += run;
+		}
+		else
+		{
+			raw = 1;
+			while (i + raw < n && raw < 128 &&
+				(i + raw + 1 >= n || memcmp(&p[(i + raw) * bytes], &p[(i + raw + 1) * bytes], bytes) != 0))
+				raw++;
+			out[o++] = raw - 1;
+			memcpy(&out[o], &p[i * bytes], raw * bytes);
+			o += raw * bytes;
+			i += raw;
+		}
+	}
+	return o;
+}
+
+// Returns the file in memory, file order (bottom row first unless flipped)
+static unsigned char *MakeTGA(int type, int bpp, int width, int height, int flipped, long *size)
+{
+	int bytes = bpp / 8;
+	long n = (long)width * height;
+	unsigned char *pixels = MakePixels(width, height, bytes);
+	unsigned char *file = (unsigned char *)malloc(18 + n * (bytes + 1) + 16);
+
+	memset(file, 0, 18);
+	file[2] = type;
+	file[12] = width & 255;
+	file[13] = width >> 8;
+	file[14] = height & 255;
+	file[15] = height >> 8;
+	file[16] = bpp;
+	file[17] = (flipped ? 32 : 0) | (bpp == 32 ? 8 : 0);
+	if (type >= 9)
+		*size = 18 + EncodeRLE(pixels, n, bytes, file + 18);
+	else
+	{
+		memcpy(file + 18, pixels, n * bytes);
+		*size = 18 + n * bytes;
+	}
+	free(pixels);
+	return file;
+}
+
+static void WriteFile(const char *name, const unsigned char *data, long size)
+{
+	FILE *f = fopen(name, "wb");
+
+	if (f == NULL)
+	{
+		fprintf(stderr, "TGABench: could not write %s\n", name);
+		exit(1);
+	}
+	fwrite(data, 1, size, f);
+	fclose(f);
+}
+
+// --- Reference decoder ---
+// Straightforward and separate from LoadTGA: the whole file in memory, the
+// pixels decoded in file order, then placed top row first as RGB(A).
+// Returns NULL for what LoadTGA must reject.
+static unsigned char *ReferenceDecode(const unsigned char *file, long size, int *width, int *height, int *bpp)
+{
+	static const unsigned char zero[12] = {0};
+	unsigned char *stream, *image;
+	long n, i = 0, pos, count, k, row;
+	int bytes, flipped, c, type;
+
+	if (size < 18)
+		return NULL;
+	type = file[2];
+	if (file[0] != 0 || file[1] != 0 || (type != 2 && type != 3 && type != 10 && type != 11) ||
+		memcmp(file + 3, zero, 9) != 0)
+		return NULL;
+	*width = file[12] | file[13] << 8;
+	*height = file[14] | file[15] << 8;
+	*bpp = file[16];
+	flipped = (file[17] & 32) != 0;
+	if (*width == 0 || *height == 0 || (*bpp != 8 && *bpp != 24 && *bpp != 32))
+		return NULL;
+	bytes = *bpp / 8;
+	n = (long)*width * *height;
+	stream = (unsigned char *)malloc(n * bytes);
+	pos = 18;
+	if (type == 2 || type == 3)
+	{
+		if (size - pos < n * bytes)
+		{
+			free(stream);
+			return NULL;
+		}
+		memcpy(stream, file + pos, n * bytes);
+	}
+	else
+		for (i = 0; i < n; )
+		{
+			if (pos >= size)
+				break;
+			count = (file[pos] & 127) + 1;
+			if (file[pos] & 128)
+			{
+				if (size - pos - 1 < bytes)
+					break;
+				for (k = 0; k < count && i < n; k++, i++)
+					memcpy(&stream[i * bytes], file + pos + 1, bytes);
+				pos += 1 + bytes;
+			}
+			else
+			{
+				if (size - pos - 1 < count * bytes)
+					break;
+				for (k = 0; k < count && i < n; k++, i++)
+					memcpy(&stream[i * bytes], file + pos + 1 + k * bytes, bytes);
+				pos += 1 + count * bytes;
+			}
+			if (i == n)
+				break;
+		}
+	if ((type == 10 || type == 11) && i < n)
+	{
+		free(stream);
+		return NULL;
+	}
+	image = (unsigned char *)malloc(n * bytes);
+	for (row = 0; row < *height; row++)
+		memcpy(&image[(flipped ? row : *height - 1 - row) * (long)*width * bytes],
+			&stream[row * (long)*width * bytes], (long)*width * bytes);
+	if (bytes >= 3)
+		for (i = 0; i < n; i++)
+		{
+			c = image[i * bytes];
+			image[i * bytes] = image[i * bytes + 2];
+			image[i * bytes + 2] = c;
+		}
+	free(stream);
+	return image;
+}
+
+// LoadTGA prints its errors, which would end up in the CSV
+static int gSavedStdout = -1;
+
+static void Quiet(int on)
+{
+	int devnull;
+
+	fflush(stdout);
+	if (on)
+	{
+		gSavedStdout = dup(fileno(stdout));
+		devnull = open("/dev/null", O_WRONLY);
+		dup2(devnull, fileno(stdout));
+		close(devnull);
+	}
+	else
+	{
+		dup2(gSavedStdout, fileno(stdout));
+		close(gSavedStdout);
+	}
+}
+
+// 1 if LoadTGA and the reference agree (both reject, or the same pixels)
+static int Agrees(const char *name, const unsigned char *file, long size, int *accepted)
+{
+	TextureData t;
+	unsigned char *ref;
+	int width, height, bpp, ok, same;
+
+	memset(&t, 0, sizeof(t));
+	Quiet(1);
+	ok = LoadTGATextureData((char *)name, &t);
+	Quiet(0);
+	ref = ReferenceDecode(file, size, &width, &height, &bpp);
+	*accepted = ok;
+	if (!ok || ref == NULL)
+		same = !ok && ref == NULL;
+	else
+		same = (int)t.width == width && (int)t.height == height && (int)t.bpp == bpp &&
+			memcmp(t.imageData, ref, (long)width * height * (bpp / 8)) == 0;
+	if (ok)
+		free(t.imageData);
+	free(ref);
+	return same;
+}
+
+// --- The tests ---
+
+static void KindName(char *s, TGAKind *k, int flipped)
+{
+	sprintf(s, "type%d_%dbit_%s", k->type, k->bpp, flipped ? "topdown" : "bottomup");
+}
+
+static void TestCorpus(void)
+{
+	char name[256], test[64];
+	unsigned char *file;
+	long size;
+	int k, s, flipped, mismatches, accepted;
+
+	mkdir(kCorpusDir, 0755);
+	for (k = 0; k < (int)(sizeof(kinds) / sizeof(kinds[0])); k++)
+		for (flipped = 0; flipped < 2; flipped++)
+		{
+			mismatches = 0;
+			for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+			{
+				file = MakeTGA(kinds[k].type, kinds[k].bpp, sizes[s][0], sizes[s][1], flipped, &size);
+				KindName(test, &kinds[k], flipped);
+				sprintf(name, kCorpusDir "%s_%dx%d.tga", test, sizes[s][0], sizes[s][1]);
+				WriteFile(name, file, size);
+				if (!Agrees(name, file, size, &accepted) || !accepted)
+					mismatches++;
+				free(file);
+			}
+			BenchReport(test, "corpus", "mismatches", mismatches);
+		}
+}
+
+static void TestSpeed(void)
+{
+	char name[256], test[64];
+	unsigned char *file, *ref;
+	long size;
+	double t0, best, bestRef;
+	int k, pass, width, height, bpp;
+	TextureData t;
+	FILE *f;
+
+	for (k = 0; k < (int)(sizeof(kinds) / sizeof(kinds[0])); k++)
+	{
+		file = MakeTGA(kinds[k].type, kinds[k].bpp, kSpeedSize, kSpeedSize, 0, &size);
+		KindName(test, &kinds[k], 0);
+		sprintf(name, kCorpusDir "%s_%dx%d.tga", test, kSpeedSize, kSpeedSize);
+		WriteFile(name, file, size);
+		best = bestRef = 1e30;
+		for (pass = 0; pass < kPasses; pass++)
+		{
+			t0 = BenchTime();
+			if (!LoadTGATextureData(name, &t))
+				break;
+			t0 = BenchTime() - t0;
+			free(t.imageData);
+			if (t0 < best)
+				best = t0;
+
+			// The reference reads the whole file too, to be fair
+			t0 = BenchTime();
+			f = fopen(name, "rb");
+			if (fread(file, 1, size, f) != (size_t)size)
+				break;
+			fclose(f);
+			ref = ReferenceDecode(file, size, &width, &height, &bpp);
+			t0 = BenchTime() - t0;
+			free(ref);
+			if (t0 < bestRef)
+				bestRef = t0;
+		}
+		BenchReport(test, "2048x2048", "file_mb", size / 1048576.0);
+		BenchReport(test, "2048x2048", "loadtga_mpix_s", kSpeedSize * kSpeedSize / best * 1e-6);
+		BenchReport(test, "2048x2048", "reference_mpix_s", kSpeedSize * kSpeedSize / bestRef * 1e-6);
+		free(file);
+	}
+}
+
+// Tries one broken file, counts the result
+static void TryMalformed(const unsigned char *file, long size, int *cases, int *rejected, int *disagreements)
+{
+	int accepted;
+
+	WriteFile(kCorpusDir "malformed.tga", file, size);
+	if (!Agrees(kCorpusDir "malformed.tga", file, size, &accepted))
+		(*disagreements)++;
+	(*cases)++;
+	if (!accepted)
+		(*rejected)++;
+}
+
+static void ReportMalformed(const char *test, int cases, int rejected, int disagreements)
+{
+	BenchReport(test, "malformed", "cases", cases);
+	BenchReport(test, "malformed", "rejected", rejected);
+	BenchReport(test, "malformed", "disagreements", disagreements);
+}
+
+static void TestMalformed(void)
+{
+	unsigned char *file, *copy;
+	long size, cut, i;
+	int k, flipped, n, cases, rejected, disagreements;
+
+	mkdir(kCorpusDir, 0755);
+	BenchSeed(2); // The same files with or without the other tests
+
+	// Cut off anywhere, in the header, in a packet, in the last row
+	cases = rejected = disagreements = 0;
+	for (k = 0; k < (int)(sizeof(kinds) / sizeof(kinds[0])); k++)
+		for (flipped = 0; flipped < 2; flipped++)
+		{
+			file = MakeTGA(kinds[k].type, kinds[k].bpp, 131, 67, flipped, &size);
+			for (cut = 0; cut < size; cut += 1 + cut / 4)
+				TryMalformed(file, cut, &cases, &rejected, &disagreements);
+			TryMalformed(file, size - 1, &cases, &rejected, &disagreements);
+			free(file);
+		}
+	ReportMalformed("truncated", cases, rejected, disagreements);
+
+	// Header fields that must be rejected or handled: sizes, depths, types
+	cases = rejected = disagreements = 0;
+	for (k = 0; k < (int)(sizeof(kinds) / sizeof(kinds[0])); k++)
+	{
+		file = MakeTGA(kinds[k].type, kinds[k].bpp, 131, 67, 0, &size);
+		copy = (unsigned char *)malloc(size);
+		for (i = 0; i < 18 * 8; i++)
+		{
+			memcpy(copy, file, size);
+			copy[i / 8] ^= 1 << (i % 8);
+			TryMalformed(copy, size, &cases, &rejected, &disagreements);
+		}
+		// Much bigger than the data
+		memcpy(copy, file, size);
+		copy[13] = copy[15] = 16;
+		TryMalformed(copy, size, &cases, &rejected, &disagreements);
+		// Wrong depth for the type, still valid for LoadTGA
+		memcpy(copy, file, size);
+		copy[16] = kinds[k].bpp == 8 ? 24 : 8;
+		TryMalformed(copy, size, &cases, &rejected, &disagreements);
+		free(copy);
+		free(file);
+	}
+	ReportMalformed("header", cases, rejected, disagreements);
+
+	// Random bytes changed in the pixel data and packet headers
+	cases = rejected = disagreements = 0;
+	for (k = 0; k < (int)(sizeof(kinds) / sizeof(kinds[0])); k++)
+	{
+		file = MakeTGA(kinds[k].type, kinds[k].bpp, 131, 67, 1, &size);
+		copy = (unsigned char *)malloc(size);
+		for (n = 0; n < 100; n++)
+		{
+			memcpy(copy, file, size);
+			for (i = 0; i < 1 + n % 8; i++)
+				copy[18 + BenchRandom() % (size - 18)] = BenchRandom();
+			TryMalformed(copy, size, &cases, &rejected, &disagreements);
+		}
+		free(copy);
+		free(file);
+	}
+	ReportMalformed("bitflip", cases, rejected, disagreements);
+
+	// The last packet runs past the end of the image, which is clipped
+	cases = rejected = disagreements = 0;
+	for (k = 0; k < (int)(sizeof(kinds) / sizeof(kinds[0])); k++)
+	{
+		if (kinds[k].type < 9)
+			continue;
+		file = MakeTGA(kinds[k].type, kinds[k].bpp, 7, 3, 0, &size);
+		copy = (unsigned char *)malloc(18 + 2 * (1 + 128 * 4));
+		memcpy(copy, file, 18);
+		// One run of 128 and one raw packet of 128, for 21 pixels
+		copy[18] = 255;
+		memset(copy + 19, 0x5a, kinds[k].bpp / 8);
+		size = 19 + kinds[k].bpp / 8;
+		TryMalformed(copy, size, &cases, &rejected, &disagreements);
+		copy[18] = 127;
+		for (i = 0; i < 128 * kinds[k].bpp / 8; i++)
+			copy[19 + i] = BenchRandom();
+		size = 19 + 128 * kinds[k].bpp / 8;
+		TryMalformed(copy, size, &cases, &rejected, &disagreements);
+		free(copy);
+		free(file);
+	}
+	ReportMalformed("rle_overrun", cases, rejected, disagreements);
+}
+
+int main(int argc, char **argv)
+{
+	BenchInit("tga");
+	if (argc > 1 && strcmp(argv[1], "malformed") == 0)
+	{
+		TestMalformed();
+		return 0;
+	}
+	TestCorpus();
+	TestSpeed();
+	TestMalformed();
+	return 0;
+}
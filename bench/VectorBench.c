@@ -0,0 +1,617 @@
+// VectorBench, speed and accuracy of the VectorUtils3 matrix and vector calls.
+// The makefile builds it once per layout (VECTORUTILS3_ROW_MAJOR and
+// VECTORUTILS3_COLUMN_MAJOR), so both code paths are measured, and once
+// without SSE, to compare the SIMD Mult, MultVec4 and InvertMat4 with the
+// scalar code.
+// Each call is timed on hot data (a few inputs, in L1) and on cold data
+// (64K inputs, flushed from the caches and visited in random order), and
+// compared to the same math in double. Errors are in ULPs of the largest
+// element of the result, see BenchUlps.
+
+// 261019: First version.
+// 261019: Added MultVec4 and the build without SSE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "VectorUtils3.h"
+#include "BenchUtils.h"
+
+#define kHotCount 128
+#define kColdCount (1 << 16)
+#define kHotTime 0.02 // Seconds per hot measurement
+#define kPasses 5 // Best of
+
+// Inputs, and where the results go
+static mat4 *matA, *matB, *matInv, *matOrtho, *outM;
+static mat3 *outM3;
+static vec3 *vecA, *vecB, *outV;
+static vec4 *vec4A, *outV4;
+static GLfloat *angles, *aspects;
+
+typedef struct
+{
+	double max, sum;
+	long count;
+} ErrorStats;
+
+typedef struct
+{
+	const char *name;
+	void (*run)(const int *order, int n);
+	void (*check)(int i, ErrorStats *e);
+} BenchOp;
+
+// Element (row, col) as in the math, whatever the layout
+static double Get4(const mat4 *a, int r, int c)
+{
+	return VECTORUTILS3_TRANSPOSED ? a->m[c*4 + r] : a->m[r*4 + c];
+}
+
+static double Get3(const mat3 *a, int r, int c)
+{
+	return VECTORUTILS3_TRANSPOSED ? a->m[c*3 + r] : a->m[r*3 + c];
+}
+
+static void AddError(ErrorStats *e, double ulps)
+{
+	if (ulps > e->max)
+		e->max = ulps;
+	e->sum += ulps;
+	e->count++;
+}
+
+static void CompareMat4(const mat4 *f, double ref[4][4], ErrorStats *e)
+{
+	double scale = 0.0;
+	int r, c;
+
+	for (r = 0; r < 4; r++)
+		for (c = 0; c < 4; c++)
+			scale = fmax(scale, fabs(ref[r][c]));
+	for (r = 0; r < 4; r++)
+		for (c = 0; c < 4; c++)
+			AddError(e, BenchUlps(Get4(f, r, c), ref[r][c], scale));
+}
+
+static void CompareVec3(vec3 f, const double ref[3], ErrorStats *e)
+{
+	double scale = fmax(fabs(ref[0]), fmax(fabs(ref[1]), fabs(ref[2])));
+
+	AddError(e, BenchUlps(f.x, ref[0], scale));
+	AddError(e, BenchUlps(f.y, ref[1], scale));
+	AddError(e, BenchUlps(f.z, ref[2], scale));
+}
+
+static void ToDouble(const mat4 *a, double d[4][4])
+{
+	int r, c;
+
+	for (r = 0; r < 4; r++)
+		for (c = 0; c < 4; c++)
+			d[r][c] = Get4(a, r, c);
+}
+
+// Gauss-Jordan with partial pivoting
+static void InvertDouble(double a[4][4], double inv[4][4])
+{
+	double m[4][8], t;
+	int r, c, p, k;
+
+	for (r = 0; r < 4; r++)
+		for (c = 0; c < 4; c++)
+		{
+			m[r][c] = a[r][c];
+			m[r][c + 4] = r == c;
+		}
+	for (c = 0; c < 4; c++)
+	{
+		p = c;
+		for (r = c + 1; r < 4; r++)
+			if (fabs(m[r][c]) > fabs(m[p][c]))
+				p = r;
+		for (k = 0; k < 8; k++)
+		{
+			t = m[c][k];
+			m[c][k] = m[p][k];
+			m[p][k] = t;
+		}
+		t = m[c][c];
+		for (k = 0; k < 8; k++)
+			m[c][k] /= t;
+		for (r = 0; r < 4; r++)
+			if (r != c)
+			{
+				t = m[r][c];
+				for (k = 0; k < 8; k++)
+					m[r][k] -= t * m[c][k];
+			}
+	}
+	for (r = 0; r < 4; r++)
+		for (c = 0; c < 4; c++)
+			inv[r][c] = m[r][c + 4];
+}
+
+static void NormalizeDouble(double v[3])
+{
+	double n = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+
+	v[0] /= n;
+	v[1] /= n;
+	v[2] /= n;
+}
+
+static void CrossDouble(const double a[3], const double b[3], double r[3])
+{
+	r[0] = a[1]*b[2] - a[2]*b[1];
+	r[1] = a[2]*b[0] - a[0]*b[2];
+	r[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+// --- The calls ---
+
+static void RunMult(const int *order, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k++)
+		outM[order[k]] = Mult(matA[order[k]], matB[order[k]]);
+}
+
+static void CheckMult(int i, ErrorStats *e)
+{
+	double ref[4][4];
+	mat4 f = Mult(matA[i], matB[i]);
+	int r, c, k;
+
+	for (r = 0; r < 4; r++)
+		for (c = 0; c < 4; c++)
+		{
+			ref[r][c] = 0.0;
+			for (k = 0; k < 4; k++)
+				ref[r][c] += Get4(&matA[i], r, k) * Get4(&matB[i], k, c);
+		}
+	CompareMat4(&f, ref, e);
+}
+
+static void RunMultVec3(const int *order, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k++)
+		outV[order[k]] = MultVec3(matA[order[k]], vecA[order[k]]);
+}
+
+static void CheckMultVec3(int i, ErrorStats *e)
+{
+	double v[4] = {vecA[i].x, vecA[i].y, vecA[i].z, 1.0}, ref[3];
+	int r, c;
+
+	for (r = 0; r < 3; r++)
+	{
+		ref[r] = 0.0;
+		for (c = 0; c < 4; c++)
+			ref[r] += Get4(&matA[i], r, c) * v[c];
+	}
+	CompareVec3(MultVec3(matA[i], vecA[i]), ref, e);
+}
+
+static void RunMultVec4(const int *order, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k++)
+		outV4[order[k]] = MultVec4(matA[order[k]], vec4A[order[k]]);
+}
+
+static void CheckMultVec4(int i, ErrorStats *e)
+{
+	double v[4] = {vec4A[i].x, vec4A[i].y, vec4A[i].z, vec4A[i].w}, ref[4], scale = 0.0;
+	vec4 f = MultVec4(matA[i], vec4A[i]);
+	int r, c;
+
+	for (r = 0; r < 4; r++)
+	{
+		ref[r] = 0.0;
+		for (c = 0; c < 4; c++)
+			ref[r] += Get4(&matA[i], r, c) * v[c];
+		scale = fmax(scale, fabs(ref[r]));
+	}
+	AddError(e, BenchUlps(f.x, ref[0], scale));
+	AddError(e, BenchUlps(f.y, ref[1], scale));
+	AddError(e, BenchUlps(f.z, ref[2], scale));
+	AddError(e, BenchUlps(f.w, ref[3], scale));
+}
+
+static void RunInvertMat4(const int *order, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k++)
+		outM[order[k]] = InvertMat4(matInv[order[k]]);
+}
+
+static void CheckInvertMat4(int i, ErrorStats *e)
+{
+	double a[4][4], ref[4][4];
+	mat4 f = InvertMat4(matInv[i]);
+
+	ToDouble(&matInv[i], a);
+	InvertDouble(a, ref);
+	CompareMat4(&f, ref, e);
+}
+
+static void RunInverseTranspose(const int *order, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k++)
+		outM3[order[k]] = InverseTranspose(matInv[order[k]]);
+}
+
+static void CheckInverseTranspose(int i, ErrorStats *e)
+{
+	double a[3][3], ref[3][3], det, scale = 0.0;
+	mat3 f = InverseTranspose(matInv[i]);
+	int r, c;
+
+	for (r = 0; r < 3; r++)
+		for (c = 0; c < 3; c++)
+			a[r][c] = Get4(&matInv[i], r, c);
+	det = a[0][0]*(a[1][1]*a[2][2] - a[1][2]*a[2][1])
+		- a[0][1]*(a[1][0]*a[2][2] - a[1][2]*a[2][0])
+		+ a[0][2]*(a[1][0]*a[2][1] - a[1][1]*a[2][0]);
+	// The cofactors over the determinant, the inverse transposed
+	for (r = 0; r < 3; r++)
+		for (c = 0; c < 3; c++)
+		{
+			ref[r][c] = (a[(r+1)%3][(c+1)%3] * a[(r+2)%3][(c+2)%3]
+				- a[(r+1)%3][(c+2)%3] * a[(r+2)%3][(c+1)%3]) / det;
+			scale = fmax(scale, fabs(ref[r][c]));
+		}
+	for (r = 0; r < 3; r++)
+		for (c = 0; c < 3; c++)
+			AddError(e, BenchUlps(Get3(&f, r, c), ref[r][c], scale));
+}
+
+static void RunArbRotate(const int *order, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k++)
+		outM[order[k]] = ArbRotate(vecA[order[k]], angles[order[k]]);
+}
+
+// Rodrigues: cos(a) I + sin(a) [k]x + (1 - cos(a)) k k^T
+static void CheckArbRotate(int i, ErrorStats *e)
+{
+	double k[3] = {vecA[i].x, vecA[i].y, vecA[i].z}, ref[4][4];
+	double s = sin(angles[i]), c = cos(angles[i]);
+	mat4 f = ArbRotate(vecA[i], angles[i]);
+	int r, col;
+
+	NormalizeDouble(k);
+	for (r = 0; r < 4; r++)
+		for (col = 0; col < 4; col++)
+			ref[r][col] = (r < 3 && col < 3) ? (1.0 - c) * k[r] * k[col] + (r == col ? c : 0.0) : (r == col);
+	ref[0][1] -= s * k[2]; ref[1][0] += s * k[2];
+	ref[0][2] += s * k[1]; ref[2][0] -= s * k[1];
+	ref[1][2] -= s * k[0]; ref[2][1] += s * k[0];
+	CompareMat4(&f, ref, e);
+}
+
+static void RunOrthoNormalizeMatrix(const int *order, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k++)
+	{
+		outM[order[k]] = matOrtho[order[k]];
+		OrthoNormalizeMatrix(&outM[order[k]]);
+	}
+}
+
+// Keeps the direction of the first column and the plane of the first two
+static void CheckOrthoNormalizeMatrix(int i, ErrorStats *e)
+{
+	double x[3], y[3], z[3], ref[4][4];
+	mat4 f = matOrtho[i];
+	int r, c;
+
+	for (r = 0; r < 3; r++)
+	{
+		x[r] = Get4(&matOrtho[i], r, 0);
+		y[r] = Get4(&matOrtho[i], r, 1);
+	}
+	CrossDouble(x, y, z);
+	NormalizeDouble(z);
+	NormalizeDouble(x);
+	CrossDouble(z, x, y);
+	for (r = 0; r < 4; r++)
+		for (c = 0; c < 4; c++)
+			ref[r][c] = r == c;
+	for (r = 0; r < 3; r++)
+	{
+		ref[r][0] = x[r];
+		ref[r][1] = y[r];
+		ref[r][2] = z[r];
+	}
+	OrthoNormalizeMatrix(&f);
+	CompareMat4(&f, ref, e);
+}
+
+static void RunLookAt(const int *order, int n)
+{
+	int k, i;
+
+	for (k = 0; k < n; k++)
+	{
+		i = order[k];
+		outM[i] = lookAt(vecA[i].x * 10, vecA[i].y * 10, vecA[i].z * 10, vecB[i].x, vecB[i].y, vecB[i].z, 0, 1, 0);
+	}
+}
+
+static void CheckLookAt(int i, ErrorStats *e)
+{
+	double p[3] = {vecA[i].x * 10.0f, vecA[i].y * 10.0f, vecA[i].z * 10.0f};
+	double up[3] = {0, 1, 0}, n[3], u[3], v[3], ref[4][4];
+	mat4 f = lookAt(p[0], p[1], p[2], vecB[i].x, vecB[i].y, vecB[i].z, 0, 1, 0);
+	int c;
+
+	n[0] = p[0] - vecB[i].x;
+	n[1] = p[1] - vecB[i].y;
+	n[2] = p[2] - vecB[i].z;
+	NormalizeDouble(n);
+	CrossDouble(up, n, u);
+	NormalizeDouble(u);
+	CrossDouble(n, u, v);
+	for (c = 0; c < 3; c++)
+	{
+		ref[0][c] = u[c];
+		ref[1][c] = v[c];
+		ref[2][c] = n[c];
+		ref[3][c] = 0.0;
+	}
+	ref[0][3] = -(u[0]*p[0] + u[1]*p[1] + u[2]*p[2]);
+	ref[1][3] = -(v[0]*p[0] + v[1]*p[1] + v[2]*p[2]);
+	ref[2][3] = -(n[0]*p[0] + n[1]*p[1] + n[2]*p[2]);
+	ref[3][3] = 1.0;
+	CompareMat4(&f, ref, e);
+}
+
+static GLfloat FovOf(int i)
+{
+	return 30.0f + 90.0f * fabsf(angles[i]) / (GLfloat)M_PI;
+}
+
+static void RunPerspective(const int *order, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k++)
+		outM[order[k]] = perspective(FovOf(order[k]), aspects[order[k]], 0.1f, 1000.0f);
+}
+
+// Same choice of xmax/ymax as perspective, then glFrustum
+static void CheckPerspective(int i, ErrorStats *e)
+{
+	double ref[4][4], fov = FovOf(i), aspect = aspects[i], n = 0.1f, f = 1000.0f, xmax, ymax;
+	mat4 m = perspective(FovOf(i), aspects[i], 0.1f, 1000.0f);
+	int r, c;
+
+	if (aspect < 1.0)
+	{
+		ymax = n * tan(fov * M_PI / 360.0);
+		xmax = ymax * aspect;
+	}
+	else
+	{
+		xmax = n * tan(fov * M_PI / 360.0);
+		ymax = xmax / aspect;
+	}
+	for (r = 0; r < 4; r++)
+		for (c = 0; c < 4; c++)
+			ref[r][c] = 0.0;
+	ref[0][0] = n / xmax;
+	ref[1][1] = n / ymax;
+	ref[2][2] = -(f + n) / (f - n);
+	ref[2][3] = -2.0 * f * n / (f - n);
+	ref[3][2] = -1.0;
+	CompareMat4(&m, ref, e);
+}
+
+static void RunNormalize(const int *order, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k++)
+		outV[order[k]] = Normalize(vecA[order[k]]);
+}
+
+static void CheckNormalize(int i, ErrorStats *e)
+{
+	double ref[3] = {vecA[i].x, vecA[i].y, vecA[i].z};
+
+	NormalizeDouble(ref);
+	CompareVec3(Normalize(vecA[i]), ref, e);
+}
+
+static void RunCrossProduct(const int *order, int n)
+{
+	int k;
+
+	for (k = 0; k < n; k++)
+		outV[order[k]] = CrossProduct(vecA[order[k]], vecB[order[k]]);
+}
+
+static void CheckCrossProduct(int i, ErrorStats *e)
+{
+	double a[3] = {vecA[i].x, vecA[i].y, vecA[i].z}, b[3] = {vecB[i].x, vecB[i].y, vecB[i].z}, ref[3];
+
+	CrossDouble(a, b, ref);
+	CompareVec3(CrossProduct(vecA[i], vecB[i]), ref, e);
+}
+
+static BenchOp ops[] =
+{
+	{"Mult", RunMult, CheckMult},
+	{"MultVec3", RunMultVec3, CheckMultVec3},
+	{"MultVec4", RunMultVec4, CheckMultVec4},
+	{"InvertMat4", RunInvertMat4, CheckInvertMat4},
+	{"InverseTranspose", RunInverseTranspose, CheckInverseTranspose},
+	{"ArbRotate", RunArbRotate, CheckArbRotate},
+	{"OrthoNormalizeMatrix", RunOrthoNormalizeMatrix, CheckOrthoNormalizeMatrix},
+	{"lookAt", RunLookAt, CheckLookAt},
+	{"perspective", RunPerspective, CheckPerspective},
+	{"Normalize", RunNormalize, CheckNormalize},
+	{"CrossProduct", RunCrossProduct, CheckCrossProduct},
+};
+
+// --- Data and timing ---
+
+static mat4 RandomMat4(double lo, double hi)
+{
+	mat4 m;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		m.m[i] = BenchUniform(lo, hi);
+	return m;
+}
+
+static vec3 RandomVec3(void)
+{
+	vec3 v;
+
+	do
+		v = SetVector(BenchUniform(-1, 1), BenchUniform(-1, 1), BenchUniform(-1, 1));
+	while (DotProduct(v, v) < 0.01f);
+	return v;
+}
+
+static void MakeData(int n)
+{
+	int i, j;
+
+	matA = (mat4 *)malloc(n * sizeof(mat4));
+	matB = (mat4 *)malloc(n * sizeof(mat4));
+	matInv = (mat4 *)malloc(n * sizeof(mat4));
+	matOrtho = (mat4 *)malloc(n * sizeof(mat4));
+	outM = (mat4 *)malloc(n * sizeof(mat4));
+	outM3 = (mat3 *)malloc(n * sizeof(mat3));
+	vecA = (vec3 *)malloc(n * sizeof(vec3));
+	vecB = (vec3 *)malloc(n * sizeof(vec3));
+	outV = (vec3 *)malloc(n * sizeof(vec3));
+	vec4A = (vec4 *)malloc(n * sizeof(vec4));
+	outV4 = (vec4 *)malloc(n * sizeof(vec4));
+	angles = (GLfloat *)malloc(n * sizeof(GLfloat));
+	aspects = (GLfloat *)malloc(n * sizeof(GLfloat));
+	for (i = 0; i < n; i++)
+	{
+		matA[i] = RandomMat4(-1, 1);
+		matB[i] = RandomMat4(-1, 1);
+		// Diagonally dominant, so well conditioned
+		matInv[i] = RandomMat4(-1, 1);
+		for (j = 0; j < 16; j += 5)
+			matInv[i].m[j] += 5;
+		vecA[i] = RandomVec3();
+		vecB[i] = RandomVec3();
+		vec4A[i] = vec3tovec4(RandomVec3());
+		vec4A[i].w = BenchUniform(-1, 1);
+		angles[i] = BenchUniform(-M_PI, M_PI);
+		aspects[i] = BenchUniform(0.5, 2.0);
+		// A rotation that has drifted a little, as after many updates
+		matOrtho[i] = MatrixAdd(ArbRotate(vecA[i], angles[i]), RandomMat4(-0.001, 0.001));
+	}
+}
+
+static void EvictData(int n)
+{
+	BenchEvict(matA, n * sizeof(mat4));
+	BenchEvict(matB, n * sizeof(mat4));
+	BenchEvict(matInv, n * sizeof(mat4));
+	BenchEvict(matOrtho, n * sizeof(mat4));
+	BenchEvict(outM, n * sizeof(mat4));
+	BenchEvict(outM3, n * sizeof(mat3));
+	BenchEvict(vecA, n * sizeof(vec3));
+	BenchEvict(vecB, n * sizeof(vec3));
+	BenchEvict(outV, n * sizeof(vec3));
+	BenchEvict(vec4A, n * sizeof(vec4));
+	BenchEvict(outV4, n * sizeof(vec4));
+	BenchEvict(angles, n * sizeof(GLfloat));
+	BenchEvict(aspects, n * sizeof(GLfloat));
+}
+
+// ns per call, best of kPasses
+static double TimeHot(BenchOp *op, const int *order)
+{
+	double best = 1e30, t0, t;
+	long reps, r;
+	int pass;
+
+	op->run(order, kHotCount); // Warm up
+	for (reps = 1; ; reps *= 2)
+	{
+		t0 = BenchTime();
+		for (r = 0; r < reps; r++)
+			op->run(order, kHotCount);
+		if (BenchTime() - t0 > kHotTime / 4)
+			break;
+	}
+	for (pass = 0; pass < kPasses; pass++)
+	{
+		t0 = BenchTime();
+		for (r = 0; r < reps; r++)
+			op->run(order, kHotCount);
+		t = (BenchTime() - t0) / (reps * kHotCount);
+		if (t < best)
+			best = t;
+	}
+	return best * 1e9;
+}
+
+static double TimeCold(BenchOp *op, const int *order)
+{
+	double best = 1e30, t0, t;
+	int pass;
+
+	for (pass = 0; pass < kPasses; pass++)
+	{
+		EvictData(kColdCount);
+		t0 = BenchTime();
+		op->run(order, kColdCount);
+		t = (BenchTime() - t0) / kColdCount;
+		if (t < best)
+			best = t;
+	}
+	return best * 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	int *hotOrder, *coldOrder, i, j;
+	ErrorStats e;
+
+	BenchInit("vector");
+	MakeData(kColdCount);
+	hotOrder = (int *)malloc(kHotCount * sizeof(int));
+	for (i = 0; i < kHotCount; i++)
+		hotOrder[i] = i;
+	coldOrder = BenchShuffle(kColdCount);
+
+	for (j = 0; j < (int)(sizeof(ops) / sizeof(ops[0])); j++)
+	{
+		if (argc > 1 && strcmp(argv[1], ops[j].name) != 0)
+			continue;
+		BenchReport(ops[j].name, "hot", "ns", TimeHot(&ops[j], hotOrder));
+		BenchReport(ops[j].name, "cold", "ns", TimeCold(&ops[j], coldOrder));
+		memset(&e, 0, sizeof(e));
+		for (i = 0; i < kColdCount; i++)
+			ops[j].check(i, &e);
+		BenchReport(ops[j].name, "all", "max_ulp", e.max);
+		BenchReport(ops[j].name, "all", "mean_ulp", e.sum / e.count);
+	}
+	return 0;
+}
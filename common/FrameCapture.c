@@ -0,0 +1,650 @@
+// FrameCapture, asynchronous framebuffer capture to TGA files.
+// SaveFramebufferToTGA reads pixels synchronously, so the CPU waits for the GPU
+// to finish the frame, and then writes the file on the render thread.
+// Here glReadPixels goes to a ring of pixel pack buffers (PBOs) and returns at
+// once. FrameCapturePoll, called once per frame, checks the fences of earlier
+// reads, maps the finished ones (normally one or two frames later) and hands
+// the pixels to a writer thread, which encodes (optionally RLE) and writes.
+// Pixels are read as BGR(A), the order TGA wants, so nothing is swizzled.
+// If the ring is full, the oldest read is waited for. That is counted as a stall.
+// On Windows there is no writer thread, files are written in FrameCapturePoll.
+// Recording mode (FrameRecordStart) streams every frame through the same ring,
+// then through a bounded lock-free single producer/single consumer queue to an
+// I/O thread, which writes a Y4M video or a PPM sequence. When the disk can not
+// keep up, the queue fills and the policy decides: drop frames, block the render
+// thread, or store frames at half resolution (PPM only, Y4M has a fixed size).
+
+// 261019: First version.
+// 261019: Added recording mode.
+// 261019: No atexit shutdown, it made GL calls after the context was gone.
+
+#if !defined(_WIN32)
+	#define _XOPEN_SOURCE 700 // nanosleep
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+	#include <time.h>
+#else
+	#include <sys/time.h>
+	#include <pthread.h>
+	#include <time.h>
+#endif
+
+#include "FrameCapture.h"
+
+typedef struct
+{
+	GLuint pbo;
+	GLsync fence;
+	long size;					// Allocated size of the PBO
+	int width, height, pixelDepth;
+	char *filename;
+	bool record;				// A recorded frame, not a screenshot
+} CaptureSlot;
+
+typedef struct CaptureJob
+{
+	char *filename;
+	unsigned char *data;
+	int width, height, pixelDepth, flags;
+	struct CaptureJob *next;
+} CaptureJob;
+
+static CaptureSlot *gSlots = NULL;
+static int gSlotCount = 0;
+static int gSlotHead = 0;		// Oldest pending read
+static int gSlotPending = 0;
+static bool gCaptureAlpha = false;
+static bool gCaptureRLE = false;
+
+// Statistics
+static long gFramesRequested = 0;
+static long gFramesWritten = 0;
+static long gStalls = 0;
+static double gBytesWritten = 0;
+static double gWriteTime = 0;
+
+#if !defined(_WIN32)
+static pthread_t gWorker;
+static pthread_mutex_t gQueueMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gQueueCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t gIdleCond = PTHREAD_COND_INITIALIZER;
+static CaptureJob *gQueueHead = NULL, *gQueueTail = NULL;
+static int gJobsInFlight = 0;
+static bool gQuit = false;
+#endif
+
+static double CaptureTime(void)
+{
+#if defined(_WIN32)
+	return (double)clock() / CLOCKS_PER_SEC;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 0.000001;
+#endif
+}
+
+static void WriteCaptureJob(CaptureJob *job)
+{
+	double t0 = CaptureTime();
+	FILE *f;
+	long size = 0;
+	int err;
+
+	err = WriteTGA(job->filename, job->width, job->height, job->pixelDepth,
+			job->data, job->width, job->flags);
+	if (err != TGA_OK)
+		printf("FrameCapture: could not write %s (%d)\n", job->filename, err);
+	else
+	{
+		f = fopen(job->filename, "rb");
+		if (f != NULL)
+		{
+			fseek(f, 0, SEEK_END);
+			size = ftell(f);
+			fclose(f);
+		}
+	}
+
+#if !defined(_WIN32)
+	pthread_mutex_lock(&gQueueMutex);
+#endif
+	if (err == TGA_OK)
+		gFramesWritten++;
+	gBytesWritten += size;
+	gWriteTime += CaptureTime() - t0;
+#if !defined(_WIN32)
+	pthread_mutex_unlock(&gQueueMutex);
+#endif
+
+	free(job->filename);
+	free(job->data);
+	free(job);
+}
+
+#if !defined(_WIN32)
+static void *CaptureWorker(void *arg)
+{
+	CaptureJob *job;
+
+	pthread_mutex_lock(&gQueueMutex);
+	for (;;)
+	{
+		while (gQueueHead == NULL && !gQuit)
+			pthread_cond_wait(&gQueueCond, &gQueueMutex);
+		if (gQueueHead == NULL)
+			break; // Quitting, and nothing left to write
+		job = gQueueHead;
+		gQueueHead = job->next;
+		if (gQueueHead == NULL)
+			gQueueTail = NULL;
+		pthread_mutex_unlock(&gQueueMutex);
+
+		WriteCaptureJob(job);
+
+		pthread_mutex_lock(&gQueueMutex);
+		gJobsInFlight--;
+		pthread_cond_broadcast(&gIdleCond);
+	}
+	pthread_mutex_unlock(&gQueueMutex);
+	return NULL;
+}
+#endif
+
+static void QueueCaptureJob(CaptureJob *job)
+{
+#if !defined(_WIN32)
+	job->next = NULL;
+	pthread_mutex_lock(&gQueueMutex);
+	if (gQueueTail != NULL)
+		gQueueTail->next = job;
+	else
+		gQueueHead = job;
+	gQueueTail = job;
+	gJobsInFlight++;
+	pthread_cond_signal(&gQueueCond);
+	pthread_mutex_unlock(&gQueueMutex);
+#else
+	WriteCaptureJob(job);
+#endif
+}
+
+static void RecordPush(const unsigned char *pixels, int width, int height);
+
+// Maps the oldest pending read and queues it for writing. Returns false if the
+// GPU is not done with it yet and wait is false.
+static bool RetireOldestSlot(bool wait)
+{
+	CaptureSlot *slot = &gSlots[gSlotHead];
+	CaptureJob *job = NULL;
+	GLenum status;
+	void *pixels;
+	long bytes = (long)slot->width * slot->height * (slot->pixelDepth / 8);
+
+	do
+	{
+		status = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 100000000 : 0);
+		if (status == GL_WAIT_FAILED)
+			break;
+	} while (wait && status == GL_TIMEOUT_EXPIRED);
+	if (status == GL_TIMEOUT_EXPIRED)
+		return false;
+	glDeleteSync(slot->fence);
+	slot->fence = NULL;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+	pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+	if (slot->record)
+	{
+		// Straight from the PBO into the record queue
+		if (pixels != NULL)
+			RecordPush((unsigned char *)pixels, slot->width, slot->height);
+	}
+	else
+	{
+		job = (CaptureJob *)malloc(sizeof(CaptureJob));
+		job->filename = slot->filename;
+		job->data = (unsigned char *)malloc(bytes);
+		job->width = slot->width;
+		job->height = slot->height;
+		job->pixelDepth = slot->pixelDepth;
+		job->flags = kTGAWriteBGR | (gCaptureRLE ? kTGAWriteRLE : 0);
+		slot->filename = NULL;
+		if (pixels != NULL)
+			memcpy(job->data, pixels, bytes);
+		else
+			memset(job->data, 0, bytes);
+	}
+	if (pixels != NULL)
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	gSlotHead = (gSlotHead + 1) % gSlotCount;
+	gSlotPending--;
+	if (job != NULL)
+		QueueCaptureJob(job);
+	return true;
+}
+
+void FrameCaptureInit(int ringSize, bool alpha, bool rle)
+{
+	int i;
+
+	gCaptureAlpha = alpha;
+	gCaptureRLE = rle;
+	if (gSlots != NULL)
+		return;
+
+	if (ringSize < 1)
+		ringSize = 1;
+	gSlotCount = ringSize;
+	gSlotHead = 0;
+	gSlotPending = 0;
+	gSlots = (CaptureSlot *)calloc(ringSize, sizeof(CaptureSlot));
+	for (i = 0; i < ringSize; i++)
+		glGenBuffers(1, &gSlots[i].pbo);
+#if !defined(_WIN32)
+	gQuit = false;
+	pthread_create(&gWorker, NULL, CaptureWorker, NULL);
+#endif
+}
+
+// Starts an asynchronous read into the next PBO in the ring
+static CaptureSlot *StartRead(GLint x, GLint y, GLint w, GLint h, int pixelDepth)
+{
+	CaptureSlot *slot;
+	long bytes;
+
+	if (gSlots == NULL)
+		FrameCaptureInit(3, false, false);
+	if (gSlotPending == gSlotCount) // Ring full, must wait for the oldest
+	{
+		gStalls++;
+		RetireOldestSlot(true);
+	}
+
+	slot = &gSlots[(gSlotHead + gSlotPending) % gSlotCount];
+	slot->width = w;
+	slot->height = h;
+	slot->pixelDepth = pixelDepth;
+	slot->filename = NULL;
+	slot->record = false;
+	bytes = (long)w * h * (pixelDepth / 8);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+	if (slot->size < bytes)
+	{
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+		slot->size = bytes;
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(x, y, w, h, pixelDepth == 32 ? GL_BGRA : GL_BGR, GL_UNSIGNED_BYTE, NULL);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	gSlotPending++;
+	return slot;
+}
+
+void FrameCaptureRequest(char *filename, GLint x, GLint y, GLint w, GLint h)
+{
+	CaptureSlot *slot = StartRead(x, y, w, h, gCaptureAlpha ? 32 : 24);
+
+	slot->filename = (char *)malloc(strlen(filename) + 1);
+	strcpy(slot->filename, filename);
+	gFramesRequested++;
+}
+
+void FrameCapturePoll(void)
+{
+	while (gSlotPending > 0 && RetireOldestSlot(false))
+		;
+}
+
+void FrameCaptureFlush(void)
+{
+	while (gSlotPending > 0)
+		RetireOldestSlot(true);
+#if !defined(_WIN32)
+	pthread_mutex_lock(&gQueueMutex);
+	while (gJobsInFlight > 0)
+		pthread_cond_wait(&gIdleCond, &gQueueMutex);
+	pthread_mutex_unlock(&gQueueMutex);
+#endif
+}
+
+void FrameCaptureShutdown(void)
+{
+	int i;
+
+	FrameRecordStop();
+	if (gSlots == NULL)
+		return;
+	FrameCaptureFlush();
+#if !defined(_WIN32)
+	pthread_mutex_lock(&gQueueMutex);
+	gQuit = true;
+	pthread_cond_signal(&gQueueCond);
+	pthread_mutex_unlock(&gQueueMutex);
+	pthread_join(gWorker, NULL);
+#endif
+	for (i = 0; i < gSlotCount; i++)
+		glDeleteBuffers(1, &gSlots[i].pbo);
+	free(gSlots);
+	gSlots = NULL;
+	gSlotCount = 0;
+}
+
+void FrameCapturePrintStats(void)
+{
+#if !defined(_WIN32)
+	pthread_mutex_lock(&gQueueMutex);
+#endif
+	printf("FrameCapture: %ld frames requested, %ld written, %ld stalls (ring full)\n",
+		gFramesRequested, gFramesWritten, gStalls);
+	printf("FrameCapture: %.1f MB written in %.1f ms of writer time, %.1f MB/s\n",
+		gBytesWritten / 1048576.0, gWriteTime * 1000.0,
+		gWriteTime > 0 ? gBytesWritten / 1048576.0 / gWriteTime : 0.0);
+#if !defined(_WIN32)
+	pthread_mutex_unlock(&gQueueMutex);
+#endif
+}
+
+// --- Recording ---
+
+#define kRecordQueueFrames 16
+
+typedef struct
+{
+	unsigned char *data;		// BGR, bottom row first, as read
+	int width, height;
+} RecordFrame;
+
+static FILE *gRecordFile = NULL;
+static char *gRecordName = NULL;	// PPM filename pattern
+static bool gRecordY4M;
+static int gRecordWidth, gRecordHeight, gRecordPolicy;
+static unsigned char *gRecordPlanes = NULL;	// Y4M or PPM output for one frame
+
+// The queue. Only the render thread writes gRecordHead, only the I/O thread
+// writes gRecordTail, so no locks are needed, only acquire/release ordering.
+static RecordFrame gRecordQueue[kRecordQueueFrames];
+static unsigned long gRecordHead = 0, gRecordTail = 0;
+static int gRecordStopping = 0;
+
+// Statistics, written by the render thread
+static long gRecordCaptured = 0, gRecordDropped = 0, gRecordDownscaled = 0;
+static double gRecordBlockTime = 0, gRecordStartTime = 0;
+// Written by the I/O thread
+static long gRecordWritten = 0;
+static double gRecordBytes = 0, gRecordWriteTime = 0;
+
+#if !defined(_WIN32)
+static pthread_t gRecordThread;
+
+#define LoadAcquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define StoreRelease(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+static void RecordSleep(void)
+{
+	struct timespec ts = {0, 1000000}; // 1 ms
+	nanosleep(&ts, NULL);
+}
+#endif
+
+// Converts and writes one frame. Y4M is 4:2:0 BT.601, PPM is RGB, both top row first.
+static void RecordWriteFrame(RecordFrame *frame, long index)
+{
+	int w = frame->width, h = frame->height, x, y, i;
+	int r, g, b, sr, sg, sb;
+	unsigned char *src, *dest, *u, *v;
+	char name[1024];
+	FILE *f;
+	long size;
+	double t0 = CaptureTime();
+
+	if (gRecordY4M)
+	{
+		dest = gRecordPlanes;
+		u = dest + w * h;
+		v = u + (w / 2) * (h / 2);
+		for (y = 0; y < h; y++)
+		{
+			src = frame->data + (long)(h - 1 - y) * w * 3;
+			for (x = 0; x < w; x++, src += 3)
+				*dest++ = (unsigned char)(((66 * src[2] + 129 * src[1] + 25 * src[0] + 128) >> 8) + 16);
+		}
+		for (y = 0; y < h / 2; y++)
+			for (x = 0; x < w / 2; x++)
+			{
+				sr = sg = sb = 0;
+				for (i = 0; i < 4; i++)
+				{
+					src = frame->data + ((long)(h - 1 - (y*2 + i/2)) * w + x*2 + i%2) * 3;
+					sb += src[0]; sg += src[1]; sr += src[2];
+				}
+				r = sr / 4; g = sg / 4; b = sb / 4;
+				*u++ = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+				*v++ = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+			}
+		size = w * h + 2 * (w / 2) * (h / 2);
+		fputs("FRAME\n", gRecordFile);
+		fwrite(gRecordPlanes, 1, size, gRecordFile);
+		gRecordBytes += size + 6;
+	}
+	else
+	{
+		dest = gRecordPlanes;
+		for (y = 0; y < h; y++)
+		{
+			src = frame->data + (long)(h - 1 - y) * w * 3;
+			for (x = 0; x < w; x++, src += 3)
+			{
+				*dest++ = src[2];
+				*dest++ = src[1];
+				*dest++ = src[0];
+			}
+		}
+		snprintf(name, sizeof(name), gRecordName, (int)index);
+		f = fopen(name, "wb");
+		if (f != NULL)
+		{
+			size = fprintf(f, "P6\n%d %d\n255\n", w, h);
+			size += fwrite(gRecordPlanes, 1, (long)w * h * 3, f);
+			fclose(f);
+			gRecordBytes += size;
+		}
+	}
+	gRecordWritten++;
+	gRecordWriteTime += CaptureTime() - t0;
+}
+
+#if !defined(_WIN32)
+static void *RecordWorker(void *arg)
+{
+	unsigned long tail = 0;
+
+	for (;;)
+	{
+		if (tail == LoadAcquire(&gRecordHead))
+		{
+			if (LoadAcquire(&gRecordStopping))
+				break;
+			RecordSleep();
+			continue;
+		}
+		RecordWriteFrame(&gRecordQueue[tail % kRecordQueueFrames], tail);
+		tail++;
+		StoreRelease(&gRecordTail, tail);
+	}
+	return NULL;
+}
+#endif
+
+// Render thread: copies a mapped frame into the queue, following the policy when full
+static void RecordPush(const unsigned char *pixels, int width, int height)
+{
+	RecordFrame *frame;
+	unsigned long head = gRecordHead, used;
+	const unsigned char *s0, *s1;
+	unsigned char *d;
+	int x, y, c;
+	double t0;
+
+	if (gRecordFile == NULL && gRecordName == NULL)
+		return; // Stopped while frames were in flight
+	gRecordCaptured++;
+#if !defined(_WIN32)
+	used = head - LoadAcquire(&gRecordTail);
+	if (used == kRecordQueueFrames)
+	{
+		if (gRecordPolicy != kRecordBlock)
+		{
+			gRecordDropped++;
+			return;
+		}
+		t0 = CaptureTime();
+		while (head - LoadAcquire(&gRecordTail) == kRecordQueueFrames)
+			RecordSleep();
+		gRecordBlockTime += CaptureTime() - t0;
+	}
+#else
+	used = 0;
+	(void)t0;
+#endif
+
+	frame = &gRecordQueue[head % kRecordQueueFrames];
+	if (gRecordPolicy == kRecordDownscale && !gRecordY4M && used >= kRecordQueueFrames / 2 && width >= 2 && height >= 2)
+	{
+		// Falling behind, store a 2x2 box filtered frame
+		gRecordDownscaled++;
+		frame->width = width / 2;
+		frame->height = height / 2;
+		d = frame->data;
+		for (y = 0; y < frame->height; y++)
+		{
+			s0 = pixels + (long)(y * 2) * width * 3;
+			s1 = s0 + width * 3;
+			for (x = 0; x < frame->width; x++, s0 += 6, s1 += 6)
+				for (c = 0; c < 3; c++)
+					*d++ = (unsigned char)((s0[c] + s0[c + 3] + s1[c] + s1[c + 3] + 2) / 4);
+		}
+	}
+	else
+	{
+		frame->width = width;
+		frame->height = height;
+		memcpy(frame->data, pixels, (long)width * height * 3);
+	}
+
+#if !defined(_WIN32)
+	StoreRelease(&gRecordHead, head + 1);
+#else
+	RecordWriteFrame(frame, head);
+	gRecordHead = gRecordTail = head + 1;
+#endif
+}
+
+bool FrameRecordStart(char *filename, int width, int height, int fps, int policy)
+{
+	size_t len = strlen(filename);
+	int i;
+
+	if (gRecordFile != NULL || gRecordName != NULL)
+		FrameRecordStop();
+	gRecordY4M = len > 4 && strcmp(filename + len - 4, ".y4m") == 0;
+	if (gRecordY4M)
+	{
+		// 4:2:0 needs even sizes
+		width &= ~1;
+		height &= ~1;
+	}
+	if (width < 2 || height < 2)
+		return false;
+
+	if (gRecordY4M)
+	{
+		gRecordFile = fopen(filename, "wb");
+		if (gRecordFile == NULL)
+		{
+			printf("FrameRecord: could not open %s\n", filename);
+			return false;
+		}
+		fprintf(gRecordFile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+	}
+	else
+	{
+		gRecordName = (char *)malloc(len + 1);
+		strcpy(gRecordName, filename);
+	}
+
+	gRecordWidth = width;
+	gRecordHeight = height;
+	gRecordPolicy = policy;
+	gRecordPlanes = (unsigned char *)malloc((long)width * height * 3);
+	for (i = 0; i < kRecordQueueFrames; i++)
+		gRecordQueue[i].data = (unsigned char *)malloc((long)width * height * 3);
+	gRecordHead = gRecordTail = 0;
+	gRecordStopping = 0;
+	gRecordCaptured = gRecordDropped = gRecordDownscaled = gRecordWritten = 0;
+	gRecordBlockTime = gRecordBytes = gRecordWriteTime = 0;
+	gRecordStartTime = CaptureTime();
+#if !defined(_WIN32)
+	pthread_create(&gRecordThread, NULL, RecordWorker, NULL);
+#endif
+	printf("FrameRecord: recording %dx%d to %s\n", width, height, filename);
+	return true;
+}
+
+// Starts reading the lower left corner of the current framebuffer for the recording
+void FrameRecordFrame(void)
+{
+	CaptureSlot *slot;
+
+	if (gRecordFile == NULL && gRecordName == NULL)
+		return;
+	slot = StartRead(0, 0, gRecordWidth, gRecordHeight, 24);
+	slot->record = true;
+}
+
+void FrameRecordStop(void)
+{
+	double elapsed;
+	int i;
+
+	if (gRecordFile == NULL && gRecordName == NULL)
+		return;
+	// Frames still on the GPU go into the queue first
+	while (gSlotPending > 0)
+		RetireOldestSlot(true);
+#if !defined(_WIN32)
+	StoreRelease(&gRecordStopping, 1);
+	pthread_join(gRecordThread, NULL);
+#endif
+	elapsed = CaptureTime() - gRecordStartTime;
+
+	printf("FrameRecord: %ld frames captured, %ld written, %ld dropped, %ld downscaled\n",
+		gRecordCaptured, gRecordWritten, gRecordDropped, gRecordDownscaled);
+	printf("FrameRecord: %.1f MB in %.1f s, %.1f MB/s written (%.1f MB/s while writing), %.1f ms blocked\n",
+		gRecordBytes / 1048576.0, elapsed, elapsed > 0 ? gRecordBytes / 1048576.0 / elapsed : 0.0,
+		gRecordWriteTime > 0 ? gRecordBytes / 1048576.0 / gRecordWriteTime : 0.0, gRecordBlockTime * 1000.0);
+
+	if (gRecordFile != NULL)
+		fclose(gRecordFile);
+	gRecordFile = NULL;
+	free(gRecordName);
+	gRecordName = NULL;
+	free(gRecordPlanes);
+	for (i = 0; i < kRecordQueueFrames; i++)
+		free(gRecordQueue[i].data);
+}
+
+bool FrameRecordActive(void)
+{
+	return gRecordFile != NULL || gRecordName != NULL;
+}
@@ -0,0 +1,44 @@
+#ifndef _FRAME_CAPTURE_
+#define _FRAME_CAPTURE_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "LoadTGA.h"
+
+// ringSize is the number of frames that can be in flight on the GPU (2-3 is
+// enough). alpha saves RGBA instead of RGB, rle run length encodes the files.
+// Calling it again only changes alpha and rle.
+void FrameCaptureInit(int ringSize, bool alpha, bool rle);
+// Starts reading a rectangle of the current read framebuffer, to be saved as filename.
+void FrameCaptureRequest(char *filename, GLint x, GLint y, GLint w, GLint h);
+// Call once per frame. Passes finished reads to the writer thread.
+void FrameCapturePoll(void);
+// Waits until all requested frames are written.
+void FrameCaptureFlush(void);
+// Stops recording, writes what is left and frees the PBOs. Call it from the
+// program's own exit path while the context exists. With MicroGlut the context
+// is gone when glutMainLoop returns.
+void FrameCaptureShutdown(void);
+void FrameCapturePrintStats(void);
+
+// Policies for FrameRecordStart, when the writer can not keep up
+#define kRecordDrop			0	// Skip frames
+#define kRecordBlock		1	// Wait for the writer, lowering the frame rate
+#define kRecordDownscale	2	// Half resolution while behind, then drop (PPM only)
+
+// Records every frame. A filename ending in .y4m gives one Y4M video,
+// anything else is taken as a printf pattern for PPM files, like "frame%05d.ppm".
+bool FrameRecordStart(char *filename, int width, int height, int fps, int policy);
+// Call once per frame, before FrameCapturePoll.
+void FrameRecordFrame(void);
+// Writes what is left and reports captured/dropped frames and bandwidth.
+void FrameRecordStop(void);
+bool FrameRecordActive(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
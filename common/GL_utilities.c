@@ -12,15 +12,39 @@
 // 131014: Added tesselation shader support
 // 150812: Added a NULL check on file names in readFile, makes Visual Studio happier.
 // 160302: Uses fopen_s on Windows, as suggested by Jesper Post. Should reduce warnings a bit.
+// 261019: Uniform locations are looked up once per program at link time. Cached setters skip unchanged values.
+// 261019: Added the FrameConstants uniform block, bound to all programs at link time.
+// 261019: Added a GL state tracker. useFBO no longer queries GL, it uses the tracked viewport.
+// 261019: Added an FBO pool with half float and packed float formats, and disposeFBO.
+// 261019: compileShaders is public, for shaders generated at run time.
+// 261019: Linked programs are cached as program binaries on disk, keyed on the sources and driver.
+// 261019: Hot reload. Programs from the loaders are recompiled in the background when their files change.
+// 261019: UploadMat4x3 and UploadNormalMatrix moved here from VectorUtils3.
 
 //#define GL3_PROTOTYPES
 #include <stdlib.h>
 #include <stdio.h>
 #include <stddef.h>
 #include <string.h>
+#include <sys/stat.h>
+#if defined(_WIN32)
+	#include <direct.h>
+	#include <time.h>
+#else
+	#include <sys/time.h>
+#endif
+#if defined(__linux__)
+	#include <sys/inotify.h>
+	#include <unistd.h>
+#endif
 
 #include "GL_utilities.h"
 
+static void buildUniformTable(GLuint program);
+static void bindFrameConstants(GLuint program);
+static void resizeFBOPool(void);
+static void watchProgramFiles(GLuint program, const char *files[5]);
+
 // Shader loader
 
 char* readFile(char *file)
@@ -97,11 +121,202 @@ void printProgramInfoLog(GLuint obj, const char *vfn, const char *ffn,
 	}
 }
 
+// Program binary cache
+// Linked programs are saved with glGetProgramBinary in programCacheDir, named
+// by a hash of all stage sources and the GL vendor/renderer/version strings.
+// A new driver gives new names, and a binary that glProgramBinary still
+// refuses is compiled from source and overwritten.
+
+#define kProgramCacheMagic 0x31425047 // "GPB1"
+
+typedef struct
+{
+	unsigned int magic;
+	GLenum format;
+	GLint length;
+	unsigned long long key;
+} ProgramCacheHeader;
+
+static const char *programCacheDir = "shadercache";
+static int programCacheHits = 0, programCacheMisses = 0;
+static double programCacheHitTime = 0, programCacheMissTime = 0;
+
+void setProgramCacheDir(const char *dir)
+{
+	programCacheDir = dir;
+}
+
+static double programCacheTime(void)
+{
+#if defined(_WIN32)
+	return (double)clock() / CLOCKS_PER_SEC;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 0.000001;
+#endif
+}
+
+static unsigned long long hashProgramString(unsigned long long h, const char *s)
+{
+	if (s != NULL)
+		for (; *s; s++)
+			h = (h ^ (unsigned char)*s) * 1099511628211ULL;
+	return (h ^ 0xff) * 1099511628211ULL; // Separator, so NULL and "" differ from the next string
+}
+
+static unsigned long long programCacheKey(const char *sources[5])
+{
+	unsigned long long h = 14695981039346656037ULL;
+	int i;
+
+	h = hashProgramString(h, (const char *)glGetString(GL_VENDOR));
+	h = hashProgramString(h, (const char *)glGetString(GL_RENDERER));
+	h = hashProgramString(h, (const char *)glGetString(GL_VERSION));
+	for (i = 0; i < 5; i++)
+		h = hashProgramString(h, sources[i]);
+	return h;
+}
+
+static int programBinaryFormats(void)
+{
+	static int formats = -1;
+
+#ifdef GL_NUM_PROGRAM_BINARY_FORMATS
+	if (formats < 0)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+#endif
+	return formats;
+}
+
+static char programCacheEnabled(void)
+{
+	return programCacheDir != NULL && programBinaryFormats() > 0;
+}
+
+static char *programCacheName(unsigned long long key)
+{
+	char *name = (char *)malloc(strlen(programCacheDir) + 32);
+	sprintf(name, "%s/%016llx.bin", programCacheDir, key);
+	return name;
+}
+
+// Returns 0 if there is no usable binary.
+static GLuint loadProgramBinary(unsigned long long key)
+{
+	GLuint p = 0;
+#ifdef GL_PROGRAM_BINARY_LENGTH
+	ProgramCacheHeader header;
+	FILE *file;
+	char *name, *binary;
+	GLint status = 0;
+
+	name = programCacheName(key);
+	file = fopen(name, "rb");
+	free(name);
+	if (file == NULL)
+		return 0;
+	if (fread(&header, sizeof(header), 1, file) == 1 &&
+		header.magic == kProgramCacheMagic && header.key == key && header.length > 0)
+	{
+		binary = (char *)malloc(header.length);
+		if (fread(binary, 1, header.length, file) == (size_t)header.length)
+		{
+			p = glCreateProgram();
+			glProgramBinary(p, header.format, binary, header.length);
+			glGetError(); // An unknown format is GL_INVALID_ENUM, and we compile instead
+			glGetProgramiv(p, GL_LINK_STATUS, &status);
+			if (!status)
+			{
+				glDeleteProgram(p);
+				p = 0;
+			}
+		}
+		free(binary);
+	}
+	fclose(file);
+#endif
+	return p;
+}
+
+static void saveProgramBinary(unsigned long long key, GLuint p)
+{
+#ifdef GL_PROGRAM_BINARY_LENGTH
+	ProgramCacheHeader header;
+	FILE *file;
+	char *name, *binary;
+	GLint status = 0;
+
+	glGetProgramiv(p, GL_LINK_STATUS, &status);
+	if (!status)
+		return;
+	memset(&header, 0, sizeof(header));
+	glGetProgramiv(p, GL_PROGRAM_BINARY_LENGTH, &header.length);
+	if (header.length <= 0)
+		return;
+	binary = (char *)malloc(header.length);
+	glGetProgramBinary(p, header.length, NULL, &header.format, binary);
+	header.magic = kProgramCacheMagic;
+	header.key = key;
+
+	name = programCacheName(key);
+	file = fopen(name, "wb");
+	if (file == NULL)
+	{
+	#if defined(_WIN32)
+		_mkdir(programCacheDir);
+	#else
+		mkdir(programCacheDir, 0755);
+	#endif
+		file = fopen(name, "wb");
+	}
+	if (file != NULL)
+	{
+		fwrite(&header, sizeof(header), 1, file);
+		fwrite(binary, 1, header.length, file);
+		fclose(file);
+	}
+	else
+		fprintf(stderr, "Could not write program binary %s\n", name);
+	free(name);
+	free(binary);
+#endif
+}
+
+void printProgramCacheStats(void)
+{
+	fprintf(stderr, "Program cache: %d loaded from cache in %.1f ms, %d compiled in %.1f ms\n",
+		programCacheHits, programCacheHitTime * 1000.0, programCacheMisses, programCacheMissTime * 1000.0);
+}
+
+// End of program binary cache
+
 // Compile a shader, return reference to it
 GLuint compileShaders(const char *vs, const char *fs, const char *gs, const char *tcs, const char *tes,
 								const char *vfn, const char *ffn, const char *gfn, const char *tcfn, const char *tefn)
 {
-	GLuint v,f,g,tc,te,p;
+	GLuint v,f,g = 0,tc = 0,te = 0,p;
+	const char *sources[5] = {vs, fs, gs, tcs, tes};
+	unsigned long long key = 0;
+	char cached;
+	double t0;
+	
+	t0 = programCacheTime();
+	cached = programCacheEnabled();
+	if (cached)
+	{
+		key = programCacheKey(sources);
+		p = loadProgramBinary(key);
+		if (p != 0)
+		{
+			stateUseProgram(p);
+			buildUniformTable(p);
+			bindFrameConstants(p);
+			programCacheHits++;
+			programCacheHitTime += programCacheTime() - t0;
+			return p;
+		}
+	}
 	
 	v = glCreateShader(GL_VERTEX_SHADER);
 	f = glCreateShader(GL_FRAGMENT_SHADER);
@@ -138,8 +353,12 @@ GLuint compileShaders(const char *vs, const char *fs, const char *gs, const char
 		glAttachShader(p,tc);
 	if (tes != NULL)
 		glAttachShader(p,te);
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+	if (cached)
+		glProgramParameteri(p, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
 	glLinkProgram(p);
-	glUseProgram(p);
+	stateUseProgram(p);
 	
 	printShaderInfoLog(v, vfn);
 	printShaderInfoLog(f, ffn);
@@ -148,6 +367,12 @@ GLuint compileShaders(const char *vs, const char *fs, const char *gs, const char
 	if (tes != NULL)	printShaderInfoLog(te, tefn);
 	
 	printProgramInfoLog(p, vfn, ffn, gfn, tcfn, tefn);
+	buildUniformTable(p);
+	bindFrameConstants(p);
+	programCacheMisses++;
+	programCacheMissTime += programCacheTime() - t0;
+	if (cached)
+		saveProgramBinary(key, p);
 	
 	return p;
 }
@@ -168,6 +393,7 @@ GLuint loadShadersGT(const char *vertFileName, const char *fragFileName, const c
 // With tesselation shader support
 {
 	char *vs, *fs, *gs, *tcs, *tes;
+	const char *files[5] = {vertFileName, fragFileName, geomFileName, tcFileName, teFileName};
 	GLuint p = 0;
 	
 	vs = readFile((char *)vertFileName);
@@ -186,7 +412,10 @@ GLuint loadShadersGT(const char *vertFileName, const char *fragFileName, const c
 	if ((tes==NULL) && (teFileName != NULL))
 		fprintf(stderr, "Failed to read %s from disk.\n", teFileName);
 	if ((vs!=NULL)&&(fs!=NULL))
+	{
 		p = compileShaders(vs, fs, gs, tcs, tes, vertFileName, fragFileName, geomFileName, tcFileName, teFileName);
+		watchProgramFiles(p, files);
+	}
 	if (vs != NULL) free(vs);
 	if (fs != NULL) free(fs);
 	if (gs != NULL) free(gs);
@@ -197,6 +426,875 @@ GLuint loadShadersGT(const char *vertFileName, const char *fragFileName, const c
 
 // End of Shader loader
 
+// Shader reload
+// The files of every program from the loaders are watched with inotify.
+// The directories are watched, not the files, since many editors save by
+// renaming a new file over the old one. pollShaderReload starts compiling a
+// changed program into a new program object without waiting for it, and
+// picks it up on a later frame when GL_KHR_parallel_shader_compile says it
+// is done. Without the extension the compile blocks in the frame it starts.
+// A program that links replaces the old executable under the old handle,
+// so the caller never sees a new name. This is a glProgramBinary copy when
+// the driver has binary formats, otherwise a relink of the old program with
+// the new shaders. Attribute locations are kept, uniform values are copied
+// over and the uniform cache is rebuilt. A program that fails to compile
+// keeps running the old code.
+
+#if defined(__linux__)
+
+#define kReloadStages 5
+
+typedef struct ShaderWatch
+{
+	GLuint program;					// The handle the caller has
+	char *file[kReloadStages];		// vs, fs, gs, tcs, tes, NULL if unused
+	const char *base[kReloadStages];	// File name without the directory
+	int wd[kReloadStages];			// Watch of the directory
+	GLuint pending;					// Program being compiled, 0 if none
+	GLuint shader[kReloadStages];
+	char changed;
+	struct ShaderWatch *next;
+} ShaderWatch;
+
+// One value of an active uniform, one entry per array element
+typedef struct
+{
+	char *name;
+	GLenum type;
+	GLfloat value[16];				// Integer types hold GLint bits
+} UniformValue;
+
+static ShaderWatch *shaderWatches = NULL;
+static int reloadFd = -1;			// -2 if inotify is not available
+static char reloadParallel = 0;
+
+#ifndef GL_COMPLETION_STATUS_KHR
+	#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+static char hasExtension(const char *name)
+{
+	GLint i, n = 0;
+
+	glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+	for (i = 0; i < n; i++)
+		if (strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+			return 1;
+	return 0;
+}
+
+static void watchProgramFiles(GLuint program, const char *files[kReloadStages])
+{
+	ShaderWatch *w;
+	char *slash;
+	int i;
+
+	if (reloadFd == -1)
+	{
+		reloadFd = inotify_init1(IN_NONBLOCK);
+		if (reloadFd < 0)
+			reloadFd = -2;
+		reloadParallel = hasExtension("GL_KHR_parallel_shader_compile");
+#ifdef GL_KHR_parallel_shader_compile
+		if (reloadParallel)
+			glMaxShaderCompilerThreadsKHR(0xffffffff);
+#endif
+	}
+	if (reloadFd < 0 || program == 0)
+		return;
+
+	w = (ShaderWatch *)calloc(1, sizeof(ShaderWatch));
+	w->program = program;
+	for (i = 0; i < kReloadStages; i++)
+		if (files[i] != NULL)
+		{
+			w->file[i] = (char *)malloc(strlen(files[i]) + 1);
+			strcpy(w->file[i], files[i]);
+			// Split in place to get the directory, then put the slash back
+			slash = strrchr(w->file[i], '/');
+			if (slash == NULL)
+			{
+				w->base[i] = w->file[i];
+				w->wd[i] = inotify_add_watch(reloadFd, ".", IN_CLOSE_WRITE | IN_MOVED_TO);
+			}
+			else
+			{
+				w->base[i] = slash + 1;
+				*slash = 0;
+				w->wd[i] = inotify_add_watch(reloadFd, slash == w->file[i] ? "/" : w->file[i], IN_CLOSE_WRITE | IN_MOVED_TO);
+				*slash = '/';
+			}
+		}
+	w->next = shaderWatches;
+	shaderWatches = w;
+}
+
+// Binds the attributes of the current executable of from to the same
+// locations in to, so VAOs set up for the old program still work.
+static void keepAttribLocations(GLuint from, GLuint to)
+{
+	GLint count = 0, maxLength = 0, size, location;
+	GLenum type;
+	char *name;
+	int i;
+
+	glGetProgramiv(from, GL_ACTIVE_ATTRIBUTES, &count);
+	glGetProgramiv(from, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+	name = (char *)malloc(maxLength + 1);
+	for (i = 0; i < count; i++)
+	{
+		glGetActiveAttrib(from, i, maxLength + 1, NULL, &size, &type, name);
+		location = glGetAttribLocation(from, name);
+		if (location >= 0) // Not for built-ins like gl_VertexID
+			glBindAttribLocation(to, location, name);
+	}
+	free(name);
+}
+
+// Number of components, 0 for types that are not copied
+static int uniformComponents(GLenum type, char *isInt)
+{
+	*isInt = 0;
+	switch (type)
+	{
+		case GL_FLOAT: return 1;
+		case GL_FLOAT_VEC2: return 2;
+		case GL_FLOAT_VEC3: return 3;
+		case GL_FLOAT_VEC4: return 4;
+		case GL_FLOAT_MAT2: return 4;
+		case GL_FLOAT_MAT3: return 9;
+		case GL_FLOAT_MAT4: return 16;
+	}
+	*isInt = 1;
+	switch (type)
+	{
+		case GL_INT_VEC2: case GL_BOOL_VEC2: return 2;
+		case GL_INT_VEC3: case GL_BOOL_VEC3: return 3;
+		case GL_INT_VEC4: case GL_BOOL_VEC4: return 4;
+		case GL_INT: case GL_BOOL:
+		case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+		case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_CUBE_SHADOW: case GL_SAMPLER_2D_RECT:
+		case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_2D_ARRAY_SHADOW: case GL_SAMPLER_BUFFER:
+		case GL_SAMPLER_2D_MULTISAMPLE: case GL_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_2D:
+			return 1;
+	}
+	return 0;
+}
+
+static UniformValue *saveUniforms(GLuint program, int *count)
+{
+	UniformValue *values = NULL;
+	GLint n = 0, maxLength = 0, size, location;
+	GLenum type;
+	char *name, *element, *bracket, isInt;
+	int i, j;
+
+	*count = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &n);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	name = (char *)malloc(maxLength + 1);
+	element = (char *)malloc(maxLength + 16);
+	for (i = 0; i < n; i++)
+	{
+		glGetActiveUniform(program, i, maxLength + 1, NULL, &size, &type, name);
+		if (uniformComponents(type, &isInt) == 0)
+			continue;
+		bracket = strchr(name, '[');
+		if (bracket != NULL)
+			*bracket = 0;
+		for (j = 0; j < size; j++)
+		{
+			if (bracket != NULL)
+				sprintf(element, "%s[%d]", name, j);
+			else
+				strcpy(element, name);
+			location = glGetUniformLocation(program, element);
+			if (location < 0) // In a uniform block
+				continue;
+			values = (UniformValue *)realloc(values, (*count + 1) * sizeof(UniformValue));
+			values[*count].name = (char *)malloc(strlen(element) + 1);
+			strcpy(values[*count].name, element);
+			values[*count].type = type;
+			if (isInt)
+				glGetUniformiv(program, location, (GLint *)values[*count].value);
+			else
+				glGetUniformfv(program, location, values[*count].value);
+			(*count)++;
+		}
+	}
+	free(name);
+	free(element);
+	return values;
+}
+
+// Sets the saved values on the current program, and frees them
+static void restoreUniforms(GLuint program, UniformValue *values, int count)
+{
+	GLint location;
+	GLint *iv;
+	GLfloat *v;
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		location = glGetUniformLocation(program, values[i].name);
+		v = values[i].value;
+		iv = (GLint *)values[i].value;
+		if (location >= 0)
+			switch (values[i].type)
+			{
+				case GL_FLOAT: glUniform1fv(location, 1, v); break;
+				case GL_FLOAT_VEC2: glUniform2fv(location, 1, v); break;
+				case GL_FLOAT_VEC3: glUniform3fv(location, 1, v); break;
+				case GL_FLOAT_VEC4: glUniform4fv(location, 1, v); break;
+				case GL_FLOAT_MAT2: glUniformMatrix2fv(location, 1, GL_FALSE, v); break;
+				case GL_FLOAT_MAT3: glUniformMatrix3fv(location, 1, GL_FALSE, v); break;
+				case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, v); break;
+				case GL_INT_VEC2: case GL_BOOL_VEC2: glUniform2iv(location, 1, iv); break;
+				case GL_INT_VEC3: case GL_BOOL_VEC3: glUniform3iv(location, 1, iv); break;
+				case GL_INT_VEC4: case GL_BOOL_VEC4: glUniform4iv(location, 1, iv); break;
+				default: glUniform1iv(location, 1, iv); break;
+			}
+		free(values[i].name);
+	}
+	free(values);
+}
+
+static void startReload(ShaderWatch *w)
+{
+	static const GLenum stages[kReloadStages] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER,
+		GL_GEOMETRY_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER};
+	char *source[kReloadStages];
+	int i, ok = 1;
+
+	for (i = 0; i < kReloadStages; i++)
+	{
+		source[i] = readFile(w->file[i]);
+		if (w->file[i] != NULL && source[i] == NULL)
+			ok = 0; // Probably in the middle of a save, try again next frame
+	}
+	if (ok)
+	{
+		w->changed = 0;
+		w->pending = glCreateProgram();
+		for (i = 0; i < kReloadStages; i++)
+			if (source[i] != NULL)
+			{
+				w->shader[i] = glCreateShader(stages[i]);
+				glShaderSource(w->shader[i], 1, (const char **)&source[i], NULL);
+				glCompileShader(w->shader[i]);
+				glAttachShader(w->pending, w->shader[i]);
+			}
+		keepAttribLocations(w->program, w->pending);
+#ifdef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+		glProgramParameteri(w->pending, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+#endif
+		glLinkProgram(w->pending);
+	}
+	for (i = 0; i < kReloadStages; i++)
+		if (source[i] != NULL)
+			free(source[i]);
+}
+
+// Moves the executable of w->pending into w->program
+static void swapProgram(ShaderWatch *w)
+{
+	UniformValue *values;
+	GLuint attached[kReloadStages];
+	GLsizei n = 0;
+	GLint status = 0, deleted;
+	int i, count;
+
+	values = saveUniforms(w->program, &count);
+#ifdef GL_PROGRAM_BINARY_LENGTH
+	if (programBinaryFormats() > 0)
+	{
+		GLint length = 0;
+		GLenum format;
+		char *binary;
+
+		glGetProgramiv(w->pending, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length > 0)
+		{
+			binary = (char *)malloc(length);
+			glGetProgramBinary(w->pending, length, NULL, &format, binary);
+			glProgramBinary(w->program, format, binary, length);
+			glGetProgramiv(w->program, GL_LINK_STATUS, &status);
+			free(binary);
+		}
+	}
+#endif
+	if (!status)
+	{
+		// The new shaders are known to link, so this does not fail
+		keepAttribLocations(w->pending, w->program);
+		glGetAttachedShaders(w->program, kReloadStages, &n, attached);
+		for (i = 0; i < n; i++)
+		{
+			// Shaders from an earlier reload are already flagged for deletion
+			glGetShaderiv(attached[i], GL_DELETE_STATUS, &deleted);
+			glDetachShader(w->program, attached[i]);
+			if (!deleted)
+				glDeleteShader(attached[i]);
+		}
+		for (i = 0; i < kReloadStages; i++)
+			if (w->shader[i] != 0)
+				glAttachShader(w->program, w->shader[i]);
+		glLinkProgram(w->program);
+	}
+	buildUniformTable(w->program);
+	bindFrameConstants(w->program);
+	stateUseProgram(w->program);
+	restoreUniforms(w->program, values, count);
+}
+
+static void finishReload(ShaderWatch *w)
+{
+	GLint done = 1, status = 0;
+	int i;
+
+	if (reloadParallel)
+	{
+		glGetProgramiv(w->pending, GL_COMPLETION_STATUS_KHR, &done);
+		if (!done)
+			return;
+	}
+	glGetProgramiv(w->pending, GL_LINK_STATUS, &status);
+	for (i = 0; i < kReloadStages; i++)
+		if (w->shader[i] != 0)
+			printShaderInfoLog(w->shader[i], w->file[i]);
+	printProgramInfoLog(w->pending, w->file[0], w->file[1], w->file[2], w->file[3], w->file[4]);
+	if (status)
+	{
+		swapProgram(w);
+		fprintf(stderr, "Reloaded %s+%s\n", w->file[0], w->file[1]);
+	}
+	else
+		fprintf(stderr, "Reload of %s+%s failed, the old program is kept\n", w->file[0], w->file[1]);
+
+	for (i = 0; i < kReloadStages; i++)
+		if (w->shader[i] != 0)
+		{
+			glDeleteShader(w->shader[i]); // Only flagged if the old program has it now
+			w->shader[i] = 0;
+		}
+	glDeleteProgram(w->pending);
+	w->pending = 0;
+}
+
+void pollShaderReload(void)
+{
+	long events[512]; // Aligned for struct inotify_event
+	char *buf = (char *)events, *next;
+	struct inotify_event *e;
+	ShaderWatch *w;
+	ssize_t length;
+	int i;
+
+	if (reloadFd < 0)
+		return;
+	while ((length = read(reloadFd, buf, sizeof(events))) > 0)
+		for (next = buf; next < buf + length; next += sizeof(struct inotify_event) + e->len)
+		{
+			e = (struct inotify_event *)next;
+			if (e->len > 0)
+				for (w = shaderWatches; w != NULL; w = w->next)
+					for (i = 0; i < kReloadStages; i++)
+						if (w->file[i] != NULL && w->wd[i] == e->wd && strcmp(w->base[i], e->name) == 0)
+							w->changed = 1;
+		}
+
+	for (w = shaderWatches; w != NULL; w = w->next)
+	{
+		if (w->pending != 0)
+			finishReload(w);
+		// Saved again while compiling, start over when that is done
+		if (w->pending == 0 && w->changed)
+			startReload(w);
+	}
+}
+
+#else
+
+static void watchProgramFiles(GLuint program, const char *files[5])
+{
+}
+
+void pollShaderReload(void)
+{
+}
+
+#endif
+
+// End of shader reload
+
+// Uniform cache
+// All active uniforms of a program are read once after linking and put in
+// a perfect hash table (the seed is searched until no two names collide),
+// so a lookup is one hash, one string compare and no GL call.
+// Each entry also keeps the last value set through the setters below, and
+// a setter with the same value does not call GL at all.
+
+typedef struct
+{
+	char *name;
+	GLint location;
+	char valid;				// 0 until set, then 1 (or 2 for a transposed matrix)
+	GLfloat value[16];
+} UniformEntry;
+
+typedef struct UniformTable
+{
+	GLuint program;
+	unsigned int seed, mask;
+	int count;
+	UniformEntry *entries;
+	int *slots;				// Index into entries, -1 if empty
+	struct UniformTable *next;
+} UniformTable;
+
+static UniformTable *uniformTables = NULL;
+static UniformTable *lastUniformTable = NULL;
+
+static unsigned int hashUniformName(const char *name, unsigned int seed)
+{
+	unsigned int h = 2166136261u ^ seed;
+
+	while (*name)
+		h = (h ^ (unsigned char)*name++) * 16777619u;
+	return h ^ (h >> 15);
+}
+
+static void freeUniformTable(UniformTable *t)
+{
+	int i;
+
+	for (i = 0; i < t->count; i++)
+		free(t->entries[i].name);
+	free(t->entries);
+	free(t->slots);
+}
+
+static void buildUniformTable(GLuint program)
+{
+	UniformTable *t;
+	GLint count = 0, maxLength = 0, size;
+	GLenum type;
+	char *bracket;
+	int i, ok;
+	unsigned int size2, h;
+
+	for (t = uniformTables; t != NULL; t = t->next)
+		if (t->program == program)
+			break;
+	if (t == NULL)
+	{
+		t = (UniformTable *)malloc(sizeof(UniformTable));
+		t->program = program;
+		t->next = uniformTables;
+		uniformTables = t;
+	}
+	else
+		freeUniformTable(t); // Relinked, or a reused program name
+
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	t->count = count;
+	t->entries = (UniformEntry *)calloc(count > 0 ? count : 1, sizeof(UniformEntry));
+	for (i = 0; i < count; i++)
+	{
+		t->entries[i].name = (char *)malloc(maxLength + 1);
+		glGetActiveUniform(program, i, maxLength + 1, NULL, &size, &type, t->entries[i].name);
+		// Arrays are reported as "name[0]", look them up as "name"
+		bracket = strchr(t->entries[i].name, '[');
+		if (bracket != NULL && strcmp(bracket, "[0]") == 0)
+			*bracket = 0;
+		t->entries[i].location = glGetUniformLocation(program, t->entries[i].name);
+	}
+
+	// Search for a seed without collisions, grow the table if it takes long
+	size2 = 4;
+	while (size2 < 2 * (unsigned int)count)
+		size2 = size2 << 1;
+	t->slots = NULL;
+	for (ok = 0; !ok; size2 = size2 << 1)
+	{
+		t->slots = (int *)realloc(t->slots, size2 * sizeof(int));
+		t->mask = size2 - 1;
+		for (t->seed = 0; t->seed < 64 && !ok; t->seed++)
+		{
+			memset(t->slots, -1, size2 * sizeof(int));
+			ok = 1;
+			for (i = 0; i < count && ok; i++)
+			{
+				h = hashUniformName(t->entries[i].name, t->seed) & t->mask;
+				if (t->slots[h] >= 0)
+					ok = 0;
+				else
+					t->slots[h] = i;
+			}
+		}
+	}
+	t->seed--;
+	lastUniformTable = t;
+}
+
+static UniformEntry *findUniform(GLuint program, const char *name, GLint *location)
+{
+	UniformTable *t = lastUniformTable;
+	int e;
+
+	if (t == NULL || t->program != program)
+	{
+		for (t = uniformTables; t != NULL; t = t->next)
+			if (t->program == program)
+				break;
+		if (t == NULL) // Not made by compileShaders
+		{
+			*location = glGetUniformLocation(program, name);
+			return NULL;
+		}
+		lastUniformTable = t;
+	}
+	e = t->slots[hashUniformName(name, t->seed) & t->mask];
+	if (e >= 0 && strcmp(t->entries[e].name, name) == 0)
+	{
+		*location = t->entries[e].location;
+		return &t->entries[e];
+	}
+	// Array elements other than the first are not in the table.
+	// Anything else is not an active uniform.
+	*location = strchr(name, '[') != NULL ? glGetUniformLocation(program, name) : -1;
+	return NULL;
+}
+
+GLint getUniformLocation(GLuint program, const char *name)
+{
+	GLint location;
+
+	findUniform(program, name, &location);
+	return location;
+}
+
+void invalidateUniformCache(GLuint program)
+{
+	UniformTable *t;
+	int i;
+
+	for (t = uniformTables; t != NULL; t = t->next)
+		if (t->program == program)
+			for (i = 0; i < t->count; i++)
+				t->entries[i].valid = 0;
+}
+
+// Returns the location if the value must be uploaded, otherwise -1
+static GLint uniformChanged(GLuint program, const char *name, const void *value, int bytes, char tag)
+{
+	UniformEntry *e;
+	GLint location;
+
+	e = findUniform(program, name, &location);
+	if (e == NULL || location < 0)
+		return location;
+	if (e->valid == tag && memcmp(e->value, value, bytes) == 0)
+		return -1;
+	memcpy(e->value, value, bytes);
+	e->valid = tag;
+	return location;
+}
+
+void setUniform1i(GLuint program, const char *name, GLint v)
+{
+	GLint location = uniformChanged(program, name, &v, sizeof(GLint), 1);
+	if (location >= 0)
+		glUniform1i(location, v);
+}
+
+void setUniform1f(GLuint program, const char *name, GLfloat v)
+{
+	GLint location = uniformChanged(program, name, &v, sizeof(GLfloat), 1);
+	if (location >= 0)
+		glUniform1f(location, v);
+}
+
+void setUniform2f(GLuint program, const char *name, GLfloat x, GLfloat y)
+{
+	GLfloat v[2] = {x, y};
+	GLint location = uniformChanged(program, name, v, sizeof(v), 1);
+	if (location >= 0)
+		glUniform2fv(location, 1, v);
+}
+
+void setUniform3fv(GLuint program, const char *name, const GLfloat *v)
+{
+	GLint location = uniformChanged(program, name, v, 3 * sizeof(GLfloat), 1);
+	if (location >= 0)
+		glUniform3fv(location, 1, v);
+}
+
+void setUniform4f(GLuint program, const char *name, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+	GLfloat v[4] = {x, y, z, w};
+	GLint location = uniformChanged(program, name, v, sizeof(v), 1);
+	if (location >= 0)
+		glUniform4fv(location, 1, v);
+}
+
+void setUniform4fv(GLuint program, const char *name, const GLfloat *v)
+{
+	GLint location = uniformChanged(program, name, v, 4 * sizeof(GLfloat), 1);
+	if (location >= 0)
+		glUniform4fv(location, 1, v);
+}
+
+void setUniformMatrix4fv(GLuint program, const char *name, GLboolean transpose, const GLfloat *m)
+{
+	GLint location = uniformChanged(program, name, m, 16 * sizeof(GLfloat), transpose ? 2 : 1);
+	if (location >= 0)
+		glUniformMatrix4fv(location, 1, transpose, m);
+}
+
+void UploadMat4x3(GLint location, mat4x3 a)
+{
+	glUniformMatrix4x3fv(location, 1, GL_TRUE, a.m);
+}
+
+void UploadNormalMatrix(GLint location, mat4x3 a)
+{
+	mat3 n = NormalMatrixMat4x3(a);
+
+	glUniformMatrix3fv(location, 1, VECTORUTILS3_TRANSPOSED ? GL_FALSE : GL_TRUE, n.m);
+}
+
+// End of uniform cache
+
+// Frame constants
+// One uniform buffer for everything that is the same for all programs
+// during a frame. Every program that declares the FrameConstants block
+// gets it bound at link time, so one buffer write per frame replaces
+// the per-program uploads of camera and light data.
+
+static GLuint frameConstantsBuffer = 0;
+static FrameConstants lastFrameConstants;
+
+static void bindFrameConstants(GLuint program)
+{
+	GLuint index = glGetUniformBlockIndex(program, "FrameConstants");
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, index, kFrameConstantsBinding);
+}
+
+void uploadFrameConstants(const FrameConstants *fc)
+{
+	if (frameConstantsBuffer == 0)
+	{
+		glGenBuffers(1, &frameConstantsBuffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, frameConstantsBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameConstants), NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, kFrameConstantsBinding, frameConstantsBuffer);
+	}
+	else
+	{
+		if (memcmp(fc, &lastFrameConstants, sizeof(FrameConstants)) == 0)
+			return;
+		glBindBuffer(GL_UNIFORM_BUFFER, frameConstantsBuffer);
+	}
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameConstants), fc);
+	lastFrameConstants = *fc;
+}
+
+// End of frame constants
+
+// GL state tracker
+// A copy of the binding and enable state as it was last set through these
+// calls. A call that would set what is already set is dropped, and GL is
+// never queried. The copy starts out as the GL defaults (everything 0 or
+// disabled) except the viewport, which is unknown until set.
+// Anything that changes this state behind the tracker's back must call
+// stateInvalidate, or stateForgetTexture after deleting a texture.
+
+#define kStateUnknown 0xffffffff
+#define kStateUnits 16
+#define kStateTargets 4
+
+static const GLenum stateTargets[kStateTargets] = {GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_3D};
+static const GLenum stateCaps[] = {GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_SCISSOR_TEST, GL_STENCIL_TEST, GL_POLYGON_OFFSET_FILL};
+#define kStateCaps (sizeof(stateCaps) / sizeof(stateCaps[0]))
+
+static GLuint stateProgram = 0, stateFramebuffer = 0, stateVertexArray = 0;
+static GLuint stateUnit = 0;
+static GLuint stateTextures[kStateUnits][kStateTargets];
+static GLint stateView[4] = {0, 0, -1, -1};
+static char stateEnables[kStateCaps];
+static long stateIssued = 0, stateElided = 0;
+
+// Used by useFBO when the window framebuffer is the output
+static int lastw = 0;
+static int lasth = 0;
+
+void stateInvalidate(void)
+{
+	int i, j;
+
+	stateProgram = stateFramebuffer = stateVertexArray = stateUnit = kStateUnknown;
+	for (i = 0; i < kStateUnits; i++)
+		for (j = 0; j < kStateTargets; j++)
+			stateTextures[i][j] = kStateUnknown;
+	stateView[2] = stateView[3] = -1;
+	for (i = 0; i < (int)kStateCaps; i++)
+		stateEnables[i] = -1;
+}
+
+void stateUseProgram(GLuint program)
+{
+	if (program == stateProgram)
+	{
+		stateElided++;
+		return;
+	}
+	glUseProgram(program);
+	stateProgram = program;
+	stateIssued++;
+}
+
+void stateBindFramebuffer(GLuint framebuffer)
+{
+	if (framebuffer == stateFramebuffer)
+	{
+		stateElided++;
+		return;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	stateFramebuffer = framebuffer;
+	stateIssued++;
+}
+
+void stateBindVertexArray(GLuint vao)
+{
+	if (vao == stateVertexArray)
+	{
+		stateElided++;
+		return;
+	}
+	glBindVertexArray(vao);
+	stateVertexArray = vao;
+	stateIssued++;
+}
+
+void stateViewport(GLint x, GLint y, GLsizei w, GLsizei h)
+{
+	// A viewport set on the window is taken as the window size
+	if (stateFramebuffer == 0 && w > 0 && h > 0 && (w != lastw || h != lasth))
+	{
+		lastw = w;
+		lasth = h;
+		resizeFBOPool();
+	}
+	if (x == stateView[0] && y == stateView[1] && w == stateView[2] && h == stateView[3])
+	{
+		stateElided++;
+		return;
+	}
+	glViewport(x, y, w, h);
+	stateView[0] = x;
+	stateView[1] = y;
+	stateView[2] = w;
+	stateView[3] = h;
+	stateIssued++;
+}
+
+void stateGetViewport(GLint *viewport)
+{
+	memcpy(viewport, stateView, sizeof(stateView));
+}
+
+// unit is GL_TEXTURE0 + i, like glActiveTexture
+void stateActiveTexture(GLenum unit)
+{
+	if (unit - GL_TEXTURE0 == stateUnit)
+	{
+		stateElided++;
+		return;
+	}
+	glActiveTexture(unit);
+	stateUnit = unit - GL_TEXTURE0;
+	stateIssued++;
+}
+
+// Binds to the active unit, like glBindTexture
+void stateBindTexture(GLenum target, GLuint texture)
+{
+	int t;
+
+	for (t = 0; t < kStateTargets; t++)
+		if (stateTargets[t] == target)
+			break;
+	if (t == kStateTargets || stateUnit >= kStateUnits) // Not tracked
+	{
+		glBindTexture(target, texture);
+		stateIssued++;
+		return;
+	}
+	if (stateTextures[stateUnit][t] == texture)
+	{
+		stateElided++;
+		return;
+	}
+	glBindTexture(target, texture);
+	stateTextures[stateUnit][t] = texture;
+	stateIssued++;
+}
+
+// A deleted texture is unbound by GL, and its name may come back from glGenTextures
+void stateForgetTexture(GLuint texture)
+{
+	int i, j;
+
+	for (i = 0; i < kStateUnits; i++)
+		for (j = 0; j < kStateTargets; j++)
+			if (stateTextures[i][j] == texture)
+				stateTextures[i][j] = 0;
+}
+
+static void stateSetEnable(GLenum cap, char on)
+{
+	int i;
+
+	for (i = 0; i < (int)kStateCaps; i++)
+		if (stateCaps[i] == cap)
+			break;
+	if (i < (int)kStateCaps && stateEnables[i] == on)
+	{
+		stateElided++;
+		return;
+	}
+	if (on)
+		glEnable(cap);
+	else
+		glDisable(cap);
+	if (i < (int)kStateCaps)
+		stateEnables[i] = on;
+	stateIssued++;
+}
+
+void stateEnable(GLenum cap)
+{
+	stateSetEnable(cap, 1);
+}
+
+void stateDisable(GLenum cap)
+{
+	stateSetEnable(cap, 0);
+}
+
+void printStateStats(void)
+{
+	fprintf(stderr, "GL state: %ld calls issued, %ld elided\n", stateIssued, stateElided);
+	stateIssued = stateElided = 0;
+}
+
+// End of GL state tracker
+
 void dumpInfo(void)
 {
    printf ("Vendor: %s\n", glGetString (GL_VENDOR));
@@ -278,13 +1376,14 @@ FBOstruct *initFBO(int width, int height, int int_method)
 
 	fbo->width = width;
 	fbo->height = height;
+	fbo->depth = 0;
 
 	// create objects
 	glGenFramebuffers(1, &fbo->fb); // frame buffer id
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo->fb);
+	stateBindFramebuffer(fbo->fb);
 	glGenTextures(1, &fbo->texid);
 	fprintf(stderr, "%i \n",fbo->texid);
-	glBindTexture(GL_TEXTURE_2D, fbo->texid);
+	stateBindTexture(GL_TEXTURE_2D, fbo->texid);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	if (int_method == 0)
@@ -309,7 +1408,7 @@ FBOstruct *initFBO(int width, int height, int int_method)
     CHECK_FRAMEBUFFER_STATUS();
 
 	fprintf(stderr, "Framebuffer object %d\n", fbo->fb);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	stateBindFramebuffer(0);
 	return fbo;
 }
 
@@ -321,14 +1420,15 @@ FBOstruct *initFBO2(int width, int height, int int_method, int create_depthimage
 
     fbo->width = width;
     fbo->height = height;
+    fbo->depth = 0;
 
     // create objects
     glGenRenderbuffers(1, &fbo->rb);
     glGenFramebuffers(1, &fbo->fb); // frame buffer id
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo->fb);
+    stateBindFramebuffer(fbo->fb);
     glGenTextures(1, &fbo->texid);
     fprintf(stderr, "%i \n",fbo->texid);
-    glBindTexture(GL_TEXTURE_2D, fbo->texid);
+    stateBindTexture(GL_TEXTURE_2D, fbo->texid);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     if (int_method == 0)
@@ -347,13 +1447,13 @@ FBOstruct *initFBO2(int width, int height, int int_method, int create_depthimage
     if (create_depthimage!=0)
     {
       glGenTextures(1, &fbo->depth);
-      glBindTexture(GL_TEXTURE_2D, fbo->depth);
+      stateBindTexture(GL_TEXTURE_2D, fbo->depth);
       glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, 0L);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      glBindTexture(GL_TEXTURE_2D, 0);
+      stateBindTexture(GL_TEXTURE_2D, 0);
       glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, fbo->depth, 0);	
       fprintf(stderr, "depthtexture: %i\n",fbo->depth);
     }
@@ -364,63 +1464,202 @@ FBOstruct *initFBO2(int width, int height, int int_method, int create_depthimage
     CHECK_FRAMEBUFFER_STATUS();
 
     fprintf(stderr, "Framebuffer object %d\n", fbo->fb);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stateBindFramebuffer(0);
     return fbo;
 }
 
-static int lastw = 0;
-static int lasth = 0;
-
-// Obsolete
+// Obsolete, stateViewport on the window does the same
 void updateScreenSizeForFBOHandler(int w, int h)
 {
 	lastw = w;
 	lasth = h;
+	resizeFBOPool();
 }
 
 // choose input (textures) and output (FBO)
+// The window size comes from the last viewport set on the window through
+// stateViewport, so there is no glGet here to stall on.
 void useFBO(FBOstruct *out, FBOstruct *in1, FBOstruct *in2)
 {
-	GLint curfbo;
-
-// This was supposed to catch changes in viewport size and update lastw/lasth.
-// It worked for me in the past, but now it causes problems to I have to
-// fall back to manual updating.
-	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &curfbo);
-	if (curfbo == 0)
+	if (out != 0L)
 	{
-		GLint viewport[4] = {0,0,0,0};
-		GLint w, h;
-		glGetIntegerv(GL_VIEWPORT, viewport);
-		w = viewport[2] - viewport[0];
-		h = viewport[3] - viewport[1];
-		if ((w > 0) && (h > 0) && (w < 65536) && (h < 65536)) // I don't believe in 64k pixel wide frame buffers for quite some time
-		{
-			lastw = viewport[2] - viewport[0];
-			lasth = viewport[3] - viewport[1];
-		}
+		stateBindFramebuffer(out->fb);
+		stateViewport(0, 0, out->width, out->height);
 	}
-	
-	if (out != 0L)
-		glViewport(0, 0, out->width, out->height);
 	else
-		glViewport(0, 0, lastw, lasth);
-
-	if (out != 0L)
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, out->fb);
-		glViewport(0, 0, out->width, out->height);
+		stateBindFramebuffer(0);
+		stateViewport(0, 0, lastw, lasth);
 	}
-	else
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glActiveTexture(GL_TEXTURE1);
+	stateActiveTexture(GL_TEXTURE1);
 	if (in2 != 0L)
-		glBindTexture(GL_TEXTURE_2D, in2->texid);
+		stateBindTexture(GL_TEXTURE_2D, in2->texid);
 	else
-		glBindTexture(GL_TEXTURE_2D, 0);
-	glActiveTexture(GL_TEXTURE0);
+		stateBindTexture(GL_TEXTURE_2D, 0);
+	stateActiveTexture(GL_TEXTURE0);
 	if (in1 != 0L)
-		glBindTexture(GL_TEXTURE_2D, in1->texid);
+		stateBindTexture(GL_TEXTURE_2D, in1->texid);
 	else
-		glBindTexture(GL_TEXTURE_2D, 0);
+		stateBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// For FBOs from initFBO and initFBO2, not from the pool
+void disposeFBO(FBOstruct *fbo)
+{
+	if (fbo == NULL)
+		return;
+	if (stateFramebuffer == fbo->fb)
+		stateFramebuffer = 0; // Deleting the bound framebuffer binds 0
+	glDeleteFramebuffers(1, &fbo->fb);
+	glDeleteTextures(1, &fbo->texid);
+	stateForgetTexture(fbo->texid);
+	if (fbo->depth != 0)
+	{
+		glDeleteTextures(1, &fbo->depth);
+		stateForgetTexture(fbo->depth);
+	}
+	if (fbo->rb != 0)
+		glDeleteRenderbuffers(1, &fbo->rb);
+	free(fbo);
 }
+
+// FBO pool
+// Render targets handed out by size, format and depth buffer, and handed
+// out again once released, so a frame that asks for the same targets every
+// time allocates nothing after the first frame.
+// Width and height 0 means the window size. Those targets are reallocated
+// when stateViewport sees a new window size.
+// GL_RGBA16F, GL_R11F_G11F_B10F and GL_RG16F are 2 to 4 times smaller than
+// GL_RGBA32F. GL_R11F_G11F_B10F has no sign bit, negative values become 0.
+
+typedef struct FBOPoolEntry
+{
+	FBOstruct fbo;			// First, so an FBOstruct pointer is also an entry pointer
+	GLenum format;
+	int hasDepth, screenSized, inUse, filter;
+	struct FBOPoolEntry *next;
+} FBOPoolEntry;
+
+static FBOPoolEntry *fboPool = NULL;
+
+static void allocateFBOStorage(FBOPoolEntry *e)
+{
+	GLenum format = GL_RGBA, type = GL_FLOAT;
+
+	if (e->format == GL_RG16F)
+		format = GL_RG;
+	if (e->format == GL_R11F_G11F_B10F)
+		format = GL_RGB;
+	if (e->format == GL_RGBA8)
+		type = GL_UNSIGNED_BYTE;
+	stateBindTexture(GL_TEXTURE_2D, e->fbo.texid);
+	glTexImage2D(GL_TEXTURE_2D, 0, e->format, e->fbo.width, e->fbo.height, 0, format, type, NULL);
+	if (e->hasDepth)
+	{
+		glBindRenderbuffer(GL_RENDERBUFFER, e->fbo.rb);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, e->fbo.width, e->fbo.height);
+	}
+}
+
+static void resizeFBOPool(void)
+{
+	FBOPoolEntry *e;
+
+	for (e = fboPool; e != NULL; e = e->next)
+		if (e->screenSized && (e->fbo.width != lastw || e->fbo.height != lasth))
+		{
+			e->fbo.width = lastw;
+			e->fbo.height = lasth;
+			allocateFBOStorage(e);
+		}
+}
+
+FBOstruct *acquireFBO(int width, int height, GLenum format, int depth, int int_method)
+{
+	FBOPoolEntry *e;
+	GLuint previous = stateFramebuffer;
+	int screenSized = (width <= 0 || height <= 0);
+
+	if (screenSized)
+	{
+		width = lastw > 0 ? lastw : 1;
+		height = lasth > 0 ? lasth : 1;
+	}
+	depth = (depth != 0);
+	for (e = fboPool; e != NULL; e = e->next)
+		if (!e->inUse && e->format == format && e->hasDepth == depth && e->screenSized == screenSized
+			&& e->fbo.width == width && e->fbo.height == height)
+			break;
+
+	if (e == NULL)
+	{
+		e = (FBOPoolEntry *)calloc(1, sizeof(FBOPoolEntry));
+		e->fbo.width = width;
+		e->fbo.height = height;
+		e->format = format;
+		e->hasDepth = depth;
+		e->screenSized = screenSized;
+		e->filter = -1;
+
+		glGenFramebuffers(1, &e->fbo.fb);
+		glGenTextures(1, &e->fbo.texid);
+		if (depth)
+			glGenRenderbuffers(1, &e->fbo.rb);
+		allocateFBOStorage(e);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		stateBindFramebuffer(e->fbo.fb);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, e->fbo.texid, 0);
+		if (depth)
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, e->fbo.rb);
+		CHECK_FRAMEBUFFER_STATUS();
+		stateBindFramebuffer(previous == kStateUnknown ? 0 : previous);
+
+		e->next = fboPool;
+		fboPool = e;
+	}
+
+	if (e->filter != int_method)
+	{
+		stateBindTexture(GL_TEXTURE_2D, e->fbo.texid);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, int_method == 0 ? GL_NEAREST : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, int_method == 0 ? GL_NEAREST : GL_LINEAR);
+		e->filter = int_method;
+	}
+	e->inUse = 1;
+	return &e->fbo;
+}
+
+// Only for FBOs from acquireFBO
+void releaseFBO(FBOstruct *fbo)
+{
+	if (fbo != NULL)
+		((FBOPoolEntry *)fbo)->inUse = 0;
+}
+
+// Deletes all targets that are not in use
+void trimFBOPool(void)
+{
+	FBOPoolEntry **ep = &fboPool, *e;
+
+	while (*ep != NULL)
+	{
+		e = *ep;
+		if (e->inUse)
+		{
+			ep = &e->next;
+			continue;
+		}
+		*ep = e->next;
+		if (stateFramebuffer == e->fbo.fb)
+			stateFramebuffer = 0;
+		glDeleteFramebuffers(1, &e->fbo.fb);
+		glDeleteTextures(1, &e->fbo.texid);
+		stateForgetTexture(e->fbo.texid);
+		if (e->hasDepth)
+			glDeleteRenderbuffers(1, &e->fbo.rb);
+		free(e);
+	}
+}
+
+// End of FBO pool
@@ -16,13 +16,85 @@ extern "C" {
 	#endif
 #endif
 #include <stdlib.h>
+#include "VectorUtils3.h"
 
 void printError(const char *functionName);
 GLuint loadShaders(const char *vertFileName, const char *fragFileName);
+GLuint compileShaders(const char *vs, const char *fs, const char *gs, const char *tcs, const char *tes,
+						const char *vfn, const char *ffn, const char *gfn, const char *tcfn, const char *tefn);
 GLuint loadShadersG(const char *vertFileName, const char *fragFileName, const char *geomFileName);
 GLuint loadShadersGT(const char *vertFileName, const char *fragFileName, const char *geomFileName,
 						const char *tcFileName, const char *teFileName);
 void dumpInfo(void);
+// Linked programs are cached in dir ("shadercache" by default), NULL turns the cache off.
+void setProgramCacheDir(const char *dir);
+void printProgramCacheStats(void);
+// Hot reload (Linux only). Programs from the loaders are recompiled when
+// their files change, and replace the old code under the same handle.
+// Call once per frame. It never waits for the compiler.
+void pollShaderReload(void);
+
+// Uniform cache, for programs made by the loaders above. Locations are
+// found without GL calls, and the setters skip values that are already set.
+// The setters work on the current program, like glUniform. If a uniform is
+// also set some other way, call invalidateUniformCache.
+GLint getUniformLocation(GLuint program, const char *name);
+void invalidateUniformCache(GLuint program);
+void setUniform1i(GLuint program, const char *name, GLint v);
+void setUniform1f(GLuint program, const char *name, GLfloat v);
+void setUniform2f(GLuint program, const char *name, GLfloat x, GLfloat y);
+void setUniform3fv(GLuint program, const char *name, const GLfloat *v);
+void setUniform4f(GLuint program, const char *name, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+void setUniform4fv(GLuint program, const char *name, const GLfloat *v);
+void setUniformMatrix4fv(GLuint program, const char *name, GLboolean transpose, const GLfloat *m);
+// VectorUtils3 affine transforms, to a mat4x3 and a mat3 uniform in the current program
+void UploadMat4x3(GLint location, mat4x3 a);
+void UploadNormalMatrix(GLint location, mat4x3 a);
+
+// Frame constants, one uniform buffer shared by all programs, written once
+// per frame. Shaders that want it declare this block (matrices are row
+// major, like the VectorUtils3 matrices uploaded with GL_TRUE):
+//
+// layout(std140, row_major) uniform FrameConstants
+// {
+//	mat4 frameView, frameProj, frameViewProj;
+//	vec4 frameCamPos;
+//	float frameTime;
+//	int frameLightCount;
+//	vec4 frameLightColor[8];
+//	vec4 frameLightPos[8];	// w = 0 for a direction, 1 for a position
+// };
+#define kFrameConstantsBinding 0
+#define kFrameMaxLights 8
+typedef struct
+{
+	GLfloat view[16], proj[16], viewProj[16];
+	GLfloat camPos[4];
+	GLfloat time;
+	GLint lightCount;
+	GLfloat pad[2];
+	GLfloat lightColor[kFrameMaxLights][4];
+	GLfloat lightPos[kFrameMaxLights][4];
+} FrameConstants;
+
+void uploadFrameConstants(const FrameConstants *fc);
+
+// GL state tracker. Drop-in replacements for the GL calls that skip
+// redundant changes and never query GL. All of common/ goes through these.
+// Code that changes the same state with plain GL calls must call
+// stateInvalidate afterwards. Delete textures with stateForgetTexture too.
+void stateUseProgram(GLuint program);
+void stateBindFramebuffer(GLuint framebuffer);
+void stateBindVertexArray(GLuint vao);
+void stateViewport(GLint x, GLint y, GLsizei w, GLsizei h);
+void stateGetViewport(GLint *viewport);
+void stateActiveTexture(GLenum unit);
+void stateBindTexture(GLenum target, GLuint texture);
+void stateForgetTexture(GLuint texture);
+void stateEnable(GLenum cap);
+void stateDisable(GLenum cap);
+void stateInvalidate(void);
+void printStateStats(void);
 
 // This is obsolete! Use the functions in MicroGlut instead!
 //void initKeymapManager();
@@ -44,6 +116,15 @@ FBOstruct *initFBO(int width, int height, int int_method);
 FBOstruct *initFBO2(int width, int height, int int_method, int create_depthimage);
 void useFBO(FBOstruct *out, FBOstruct *in1, FBOstruct *in2);
 void updateScreenSizeForFBOHandler(int w, int h); // Temporary workaround to inform useFBO of screen size changes
+void disposeFBO(FBOstruct *fbo);
+
+// FBO pool. Targets are reused by (width, height, format, depth). Width and
+// height 0 follows the window size, and is resized with it. format is
+// GL_RGBA16F, GL_R11F_G11F_B10F, GL_RG16F, GL_RGBA8 or GL_RGBA32F.
+// int_method is 0 for nearest, 1 for linear, like initFBO.
+FBOstruct *acquireFBO(int width, int height, GLenum format, int depth, int int_method);
+void releaseFBO(FBOstruct *fbo);
+void trimFBOPool(void);
 
 #ifdef __cplusplus
 }
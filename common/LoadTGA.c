@@ -9,13 +9,50 @@
 // 170220: Changed fopen_s to "rb". This made it fail for some textures.
 // 170331: Cleaned up a bit to remove warnings.
 // 170419: Fixed a bug that prevented monochrome images from loading.
+// 261019: Images are now stored in their exact size (NPOT) by default, with tightly packed
+// rows. Padding to power of two is available with LoadTGASetPadding. Added LoadTGAPrintMemoryStats.
+// SaveDataToTGA no longer assumes power-of-two row length.
+// 261019: Mipmaps are built on the CPU with a gamma correct Kaiser (or Lanczos) filter and
+// uploaded level by level. See LoadTGASetMipmapFilter and LoadTGASetMipmapCache.
+// 261019: Added WriteTGA, which saves RGBA, grayscale and RLE.
+// 261019: Added batch loading on several threads (LoadTGATextureBatch), and LoadTGAUploadTexture.
+// 261019: RLE packets that cross rows are decoded correctly, and can no longer write outside
+// the image. Truncated files fail instead of leaving garbage.
+// 261019: RLE is decoded a row segment at a time from a buffer, not a pixel at a time.
+// 261019: WriteTGA returns TGA_ERROR_WRITING_FILE when writing fails.
 
 // NOTE: LoadTGA does NOT support all TGA variants! You may need to re-save your TGA
 // with different settings to find a suitable format.
 
+#if !defined(_WIN32)
+	#define _XOPEN_SOURCE 700 // sysconf
+#endif
+
 #include "LoadTGA.h"
+#include "GL_utilities.h"
+#include <math.h>
+#include <sys/stat.h>
+#if !defined(_WIN32)
+	#include <unistd.h>
+	#include <pthread.h>
+#endif
+#if defined(__SSE__)
+	#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+#endif
 
 static bool gMipmap = true;
+static bool gPadToPow2 = false;
+
+// Memory statistics: what has been allocated, and what it would have cost with padding.
+// LoadTGATextureData may run on several threads, so they are updated under a lock.
+static long gTGABytesAllocated = 0;
+static long gTGABytesPadded = 0;
+static long gTGAImageCount = 0;
+#if !defined(_WIN32)
+static pthread_mutex_t gTGAStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 // Note that turning mimpapping on and off refers to the loading stage only.
 // If you want to turn off mipmapping later, use 
@@ -26,6 +63,77 @@ void LoadTGASetMipmapping(bool active)
 	gMipmap = active;
 }
 
+// OpenGL 3.2 supports non-power-of-two textures, so images are stored in their
+// exact size, giving texWidth = texHeight = 1.0. Padding to power of two is only
+// needed for very old hardware, or code that relies on texWidth/texHeight < 1.
+void LoadTGASetPadding(bool active)
+{
+	gPadToPow2 = active;
+}
+
+// Reports the memory used by all images loaded so far, compared to
+// the same images padded to power of two.
+void LoadTGAPrintMemoryStats(void)
+{
+	printf("LoadTGA: %ld images, %ld bytes (%ld bytes if padded to power of two, %ld bytes saved)\n",
+		gTGAImageCount, gTGABytesAllocated, gTGABytesPadded, gTGABytesPadded - gTGABytesAllocated);
+}
+
+// Buffered reads of RLE data, since the packets are often only a few bytes
+typedef struct
+{
+	FILE *file;
+	GLubyte data[16384];
+	long pos, len;
+} TGAStream;
+
+static bool ReadTGAStream(TGAStream *s, GLubyte *dest, long n)
+{
+	long c;
+
+	while (n > 0)
+	{
+		if (s->pos == s->len)
+		{
+			s->len = fread(s->data, 1, sizeof(s->data), s->file);
+			s->pos = 0;
+			if (s->len == 0)
+				return false;
+		}
+		c = s->len - s->pos;
+		if (c > n)
+			c = n;
+		memcpy(dest, &s->data[s->pos], c);
+		s->pos += c;
+		dest += c;
+		n -= c;
+	}
+	return true;
+}
+
+// Repeats one pixel n times, for RLE runs
+static void FillPixels(GLubyte *dest, const GLubyte *pixel, long n, GLuint bytesPerPixel)
+{
+	GLuint v;
+	long i;
+
+	if (bytesPerPixel == 1)
+		memset(dest, pixel[0], n);
+	else if (bytesPerPixel == 4)
+	{
+		memcpy(&v, pixel, 4);
+		for (i = 0; i < n; i++)
+			memcpy(&dest[i * 4], &v, 4);
+	}
+	else
+		for (i = 0; i < n; i++, dest += 3)
+		{
+			dest[0] = pixel[0];
+			dest[1] = pixel[1];
+			dest[2] = pixel[2];
+		}
+}
+
 bool LoadTGATextureData(char *filename, TextureData *texture)	// Loads A TGA File Into Memory
 {
 	GLuint i;
@@ -37,18 +145,18 @@ bool LoadTGATextureData(char *filename, TextureData *texture)	// Loads A TGA Fil
 		actualHeader[12],	// Used To Compare TGA Header
 		header[6];		// First 6 Useful Bytes From The Header
 	GLuint bytesPerPixel,		// Holds Number Of Bytes Per Pixel Used In The TGA File
-		imageSize,		// Used To Store The Image Size When Setting Aside Ram
 		temp;			// Temporary Variable
+	size_t imageSize, k;	// Used To Store The Image Size When Setting Aside Ram
 	long rowSize, stepSize, bytesRead;
-	long w, h;
+	long w, h, pw, ph;
 	GLubyte *rowP;
 	int err;
 	GLubyte rle;
-	int b;
-	long row, rowLimit;
-	GLubyte pixelData[4];
+	long x, count, span, pixelsLeft;
+	GLubyte packet[128 * 4], *src;
+	TGAStream stream;
 	
-	// Nytt fr flipping-std 111114
+	// Nytt f�r flipping-st�d 111114
 	char flipped;
 	long step;
 	
@@ -103,17 +211,36 @@ bool LoadTGATextureData(char *filename, TextureData *texture)	// Loads A TGA Fil
 	}
 	flipped = (header[5] & 32) != 0; // Testa om flipped
 	
-	w = 1;
-	while (w < texture->width) w = w << 1;
-	h = 1;
-	while (h < texture->height) h = h << 1;
+	pw = 1;
+	while (pw < texture->width) pw = pw << 1;
+	ph = 1;
+	while (ph < texture->height) ph = ph << 1;
+	if (gPadToPow2)
+	{
+		w = pw;
+		h = ph;
+	}
+	else
+	{
+		w = texture->width;
+		h = texture->height;
+	}
 	texture->texWidth = (GLfloat)texture->width / w;
 	texture->texHeight = (GLfloat)texture->height / h;
 	
 	
 	texture->bpp = header[4];		// Grab The TGA's Bits Per Pixel (24 or 32)
 	bytesPerPixel = texture->bpp/8;		// Divide By 8 To Get The Bytes Per Pixel
-	imageSize = w * h * bytesPerPixel;	// Calculate The Memory Required For The TGA Data
+#if !defined(_WIN32)
+	pthread_mutex_lock(&gTGAStatsMutex);
+#endif
+	gTGABytesAllocated += w * h * bytesPerPixel;
+	gTGABytesPadded += pw * ph * bytesPerPixel;
+	gTGAImageCount++;
+#if !defined(_WIN32)
+	pthread_mutex_unlock(&gTGAStatsMutex);
+#endif
+	imageSize = (size_t)w * h * bytesPerPixel;	// Calculate The Memory Required For The TGA Data
 	rowSize	= texture->width * bytesPerPixel;	// Image memory per row
 	stepSize = w * bytesPerPixel;		// Memory per row
 	texture->imageData = (GLubyte *)malloc(imageSize);	// Reserve Memory To Hold The TGA Data
@@ -129,14 +256,12 @@ bool LoadTGATextureData(char *filename, TextureData *texture)	// Loads A TGA Fil
 	if (!flipped)
 	{
 		step = -stepSize;
-		rowP = &texture->imageData[imageSize - stepSize];
-		row = 0 + (texture->height -1) * stepSize;
+		rowP = &texture->imageData[(texture->height - 1) * stepSize];
 	}
 	else
 	{
 		step = stepSize;
 		rowP = &texture->imageData[0];
-		row = 0;
 	}
 
 	if (actualHeader[2] == 2 || actualHeader[2] == 3) // uncompressed
@@ -148,6 +273,7 @@ bool LoadTGATextureData(char *filename, TextureData *texture)	// Loads A TGA Fil
 			if (bytesRead != rowSize)
 			{
 				free(texture->imageData);	// If So, Release The Image Data
+				texture->imageData = NULL;
 				fclose(file);			// Close The File
 				return false;			// Return False
 			}
@@ -155,45 +281,70 @@ bool LoadTGATextureData(char *filename, TextureData *texture)	// Loads A TGA Fil
 	}
 	else
 	{ // compressed
-//		row = 0 + (texture->height -1) * stepSize;
-		i = row;
-		rowLimit = row + rowSize;
-		do
+		// Packets may cross rows (many writers do that), so each packet is
+		// split at the row end and the rest goes to the next row. Packets are
+		// never allowed to write outside the image, and a truncated file is
+		// an error.
+		stream.file = file;
+		stream.pos = stream.len = 0;
+		x = 0;
+		pixelsLeft = (long)texture->width * texture->height;
+		while (pixelsLeft > 0)
 		{
-			bytesRead = fread(&rle, 1, 1, file);
+			if (!ReadTGAStream(&stream, &rle, 1))
+				break;
+			count = (rle & 127) + 1;
 			if (rle < 128)
 			{ // rle+1 raw pixels
-				bytesRead = fread(&texture->imageData[i], 1, (rle+1)*bytesPerPixel, file);
-				i += bytesRead;
-				if (bytesRead == 0)
-					i = imageSize;
+				if (!ReadTGAStream(&stream, packet, count * bytesPerPixel))
+					break;
 			}
 			else
 			{ // range of rle-127 pixels with a color that follows
-				bytesRead = fread(&pixelData, 1, bytesPerPixel, file);
-				do
-				{
-					for (b = 0; b < bytesPerPixel; b++)
-						texture->imageData[i+b] = pixelData[b];
-					i += bytesPerPixel;
-					rle = rle - 1;
-				} while (rle > 127);
+				if (!ReadTGAStream(&stream, packet, bytesPerPixel))
+					break;
 			}
-			if (i >= rowLimit)
-			{
-				row = row + step; // - stepSize;
-				rowLimit = row + rowSize;
-				i = row;
+			if (count > pixelsLeft)
+				count = pixelsLeft;
+			pixelsLeft -= count;
+			src = packet;
+			while (count > 0)
+			{ // The part of the packet that fits in this row
+				span = (long)texture->width - x;
+				if (span > count)
+					span = count;
+				if (rle < 128)
+				{
+					memcpy(&rowP[x * bytesPerPixel], src, span * bytesPerPixel);
+					src += span * bytesPerPixel;
+				}
+				else
+					FillPixels(&rowP[x * bytesPerPixel], packet, span, bytesPerPixel);
+				count -= span;
+				x += span;
+				if (x == (long)texture->width)
+				{
+					x = 0;
+					rowP += step;
+				}
 			}
-		} while (i < imageSize);
+		}
+		if (pixelsLeft > 0)
+		{
+			printf("%s is truncated\n", filename);
+			free(texture->imageData);
+			texture->imageData = NULL;
+			fclose(file);
+			return false;
+		}
 	}
 
 	if (bytesPerPixel >= 3) // if not monochrome	
-	for (i = 0; i < (int)(imageSize); i += bytesPerPixel)	// Loop Through The Image Data
+	for (k = 0; k < imageSize; k += bytesPerPixel)	// Loop Through The Image Data
 	{		// Swaps The 1st And 3rd Bytes ('R'ed and 'B'lue)
-		temp = texture->imageData[i];		// Temporarily Store The Value At Image Data 'i'
-		texture->imageData[i] = texture->imageData[i + 2];	// Set The 1st Byte To The Value Of The 3rd Byte
-		texture->imageData[i + 2] = temp;	// Set The 3rd Byte To The Value In 'temp' (1st Byte Value)
+		temp = texture->imageData[k];		// Temporarily Store The Value At Image Data 'k'
+		texture->imageData[k] = texture->imageData[k + 2];	// Set The 1st Byte To The Value Of The 3rd Byte
+		texture->imageData[k + 2] = temp;	// Set The 3rd Byte To The Value In 'temp' (1st Byte Value)
 	}
 	fclose (file);
 
@@ -203,18 +354,505 @@ texture->h = h;
 	return true;				// Texture loading Went Ok, Return True
 }
 
-bool LoadTGATexture(char *filename, TextureData *texture)	// Loads A TGA File Into Memory and creates texture object
+// --- CPU mipmap generation ---
+// Each level is filtered from the previous one with a separable windowed sinc
+// (Kaiser or Lanczos 3), which is sharper than the box filter of glGenerateMipmap.
+// RGB of 24 and 32 bit images is taken to be sRGB and filtered in linear light,
+// with premultiplied alpha so that transparent areas do not bleed dark halos.
+// 8 bit images are taken to be data (masks, heights) and filtered as they are.
+// Levels are kept as floats while building so errors do not add up.
+// Rows are split over threads, and the inner loops handle one RGBA pixel
+// at a time with SSE or NEON.
+
+#define kMipRadius 3.0	// Filter support, in destination pixels
+#define kMaxMipThreads 16
+#define kLinearToSRGBSize 8192
+
+#if defined(__SSE__)
+	typedef __m128 MipVec;
+	#define MipZero() _mm_setzero_ps()
+	#define MipLoad(p) _mm_loadu_ps(p)
+	#define MipStore(p, v) _mm_storeu_ps(p, v)
+	#define MipMulAdd(acc, v, w) _mm_add_ps(acc, _mm_mul_ps(v, _mm_set1_ps(w)))
+#elif defined(__ARM_NEON)
+	typedef float32x4_t MipVec;
+	#define MipZero() vdupq_n_f32(0.0f)
+	#define MipLoad(p) vld1q_f32(p)
+	#define MipStore(p, v) vst1q_f32(p, v)
+	#define MipMulAdd(acc, v, w) vmlaq_n_f32(acc, v, w)
+#else
+	typedef struct { float v[4]; } MipVec;
+	static MipVec MipZero(void) { MipVec r = {{0, 0, 0, 0}}; return r; }
+	static MipVec MipLoad(const float *p) { MipVec r = {{p[0], p[1], p[2], p[3]}}; return r; }
+	static void MipStore(float *p, MipVec v) { memcpy(p, v.v, sizeof(v.v)); }
+	static MipVec MipMulAdd(MipVec acc, MipVec v, float w)
+	{
+		int i;
+		for (i = 0; i < 4; i++)
+			acc.v[i] += v.v[i] * w;
+		return acc;
+	}
+#endif
+
+static int gMipmapFilter = kTGAMipmapKaiser;
+static bool gMipmapCache = false;
+
+static float gSRGBToLinear[256];
+static GLubyte gLinearToSRGB[kLinearToSRGBSize + 1];
+
+// Selects how LoadTGATexture makes mipmaps, kTGAMipmapGPU gives the old
+// glGenerateMipmap behavior.
+void LoadTGASetMipmapFilter(int filter)
 {
-	char ok;
-	GLuint type = GL_RGBA;		// Set The Default GL Mode To RBGA (32 BPP)
-	
-	ok = LoadTGATextureData(filename, texture);	// Loads A TGA File Into Memory
-	if (!ok)
+	gMipmapFilter = filter;
+}
+
+// When on, the mip levels built on the CPU are saved in filename.mip and
+// loaded from there as long as the TGA does not change.
+void LoadTGASetMipmapCache(bool active)
+{
+	gMipmapCache = active;
+}
+
+static void FillMipTables(void)
+{
+	double c;
+	int i;
+
+	for (i = 0; i < 256; i++)
+	{
+		c = i / 255.0;
+		gSRGBToLinear[i] = (float)(c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+	}
+	for (i = 0; i <= kLinearToSRGBSize; i++)
+	{
+		c = (double)i / kLinearToSRGBSize;
+		c = c <= 0.0031308 ? c * 12.92 : 1.055 * pow(c, 1.0 / 2.4) - 0.055;
+		gLinearToSRGB[i] = (GLubyte)(c * 255.0 + 0.5);
+	}
+}
+
+// Mip chains may be built on several threads at once
+static void InitMipTables(void)
+{
+#if !defined(_WIN32)
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+	pthread_once(&once, FillMipTables);
+#else
+	static bool done = false;
+	if (!done)
+		FillMipTables();
+	done = true;
+#endif
+}
+
+static double MipSinc(double x)
+{
+	if (fabs(x) < 0.000001)
+		return 1.0;
+	x *= 3.14159265358979323846;
+	return sin(x) / x;
+}
+
+static double MipBesselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	int k;
+
+	for (k = 1; k < 20; k++)
+	{
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+// t is the distance in destination pixels
+static double MipKernel(int filter, double t)
+{
+	if (fabs(t) >= kMipRadius)
+		return 0.0;
+	if (filter == kTGAMipmapLanczos)
+		return MipSinc(t) * MipSinc(t / kMipRadius);
+	return MipSinc(t) * MipBesselI0(4.0 * sqrt(1.0 - (t / kMipRadius) * (t / kMipRadius))) / MipBesselI0(4.0);
+}
+
+// Source pixels and weights for each destination pixel along one axis.
+// Works for odd sizes too, since NPOT levels are not exactly halved.
+typedef struct
+{
+	int taps;
+	int *index;		// destSize * taps, clamped to the edges
+	float *weight;
+} MipAxis;
+
+static void BuildMipAxis(int filter, int srcSize, int destSize, MipAxis *axis)
+{
+	double scale = (double)srcSize / destSize;
+	double center, sum, w;
+	int d, k, i, first;
+
+	axis->taps = (int)ceil(2.0 * kMipRadius * scale) + 1;
+	axis->index = (int *)malloc(destSize * axis->taps * sizeof(int));
+	axis->weight = (float *)malloc(destSize * axis->taps * sizeof(float));
+	for (d = 0; d < destSize; d++)
+	{
+		center = (d + 0.5) * scale;
+		first = (int)floor(center - kMipRadius * scale);
+		sum = 0.0;
+		for (k = 0; k < axis->taps; k++)
+		{
+			i = first + k;
+			w = MipKernel(filter, (i + 0.5 - center) / scale);
+			if (i < 0) i = 0;
+			if (i >= srcSize) i = srcSize - 1;
+			axis->index[d * axis->taps + k] = i;
+			axis->weight[d * axis->taps + k] = (float)w;
+			sum += w;
+		}
+		for (k = 0; k < axis->taps; k++)
+			axis->weight[d * axis->taps + k] /= (float)sum;
+	}
+}
+
+typedef struct
+{
+	const float *src;
+	float *dest;
+	int srcWidth, destWidth;	// RGBA pixels per row
+	MipAxis *axis;
+	bool vertical;
+	int first, last;			// Destination rows
+} MipJob;
+
+static void *FilterMipRows(void *arg)
+{
+	MipJob *job = (MipJob *)arg;
+	const float *s;
+	float *d;
+	const int *index;
+	const float *weight;
+	MipVec acc;
+	int x, y, k, taps = job->axis->taps;
+
+	for (y = job->first; y < job->last; y++)
+	{
+		d = job->dest + y * job->destWidth * 4;
+		if (!job->vertical)
+		{
+			s = job->src + y * job->srcWidth * 4;
+			for (x = 0; x < job->destWidth; x++)
+			{
+				index = &job->axis->index[x * taps];
+				weight = &job->axis->weight[x * taps];
+				acc = MipZero();
+				for (k = 0; k < taps; k++)
+					acc = MipMulAdd(acc, MipLoad(s + index[k] * 4), weight[k]);
+				MipStore(d + x * 4, acc);
+			}
+		}
+		else
+		{
+			// A weighted sum of whole source rows
+			for (x = 0; x < job->destWidth; x++)
+				MipStore(d + x * 4, MipZero());
+			for (k = 0; k < taps; k++)
+			{
+				s = job->src + job->axis->index[y * taps + k] * job->srcWidth * 4;
+				for (x = 0; x < job->destWidth; x++)
+					MipStore(d + x * 4, MipMulAdd(MipLoad(d + x * 4), MipLoad(s + x * 4), job->axis->weight[y * taps + k]));
+			}
+		}
+	}
+	return NULL;
+}
+
+static void RunMipPass(MipJob *job, int rows, int maxThreads)
+{
+	MipJob jobs[kMaxMipThreads];
+	int threads = 1, i;
+#if !defined(_WIN32)
+	pthread_t tid[kMaxMipThreads];
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	// Threads only pay off for larger levels
+	if (n > maxThreads)
+		n = maxThreads;
+	if ((long)rows * job->destWidth >= 16384 && n > 1)
+		threads = n > kMaxMipThreads ? kMaxMipThreads : (int)n;
+#endif
+	if (threads > rows)
+		threads = rows;
+	for (i = 0; i < threads; i++)
+	{
+		jobs[i] = *job;
+		jobs[i].first = rows * i / threads;
+		jobs[i].last = rows * (i+1) / threads;
+	}
+#if !defined(_WIN32)
+	for (i = 1; i < threads; i++)
+		if (pthread_create(&tid[i], NULL, FilterMipRows, &jobs[i]) != 0)
+		{
+			FilterMipRows(&jobs[i]);
+			tid[i] = 0;
+		}
+	FilterMipRows(&jobs[0]);
+	for (i = 1; i < threads; i++)
+		if (tid[i] != 0)
+			pthread_join(tid[i], NULL);
+#else
+	for (i = 0; i < threads; i++)
+		FilterMipRows(&jobs[i]);
+#endif
+}
+
+// To linear, premultiplied RGBA floats
+static void MipToFloat(const GLubyte *src, int rowLength, int width, int height, int bpp, float *dest)
+{
+	int bytesPerPixel = bpp / 8, x, y, c;
+	const GLubyte *p;
+	float *f, a;
+
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+		{
+			p = &src[(y * rowLength + x) * bytesPerPixel];
+			f = &dest[(y * width + x) * 4];
+			if (bytesPerPixel == 1)
+			{
+				f[0] = p[0] / 255.0f;
+				f[1] = f[2] = f[3] = 0.0f;
+				continue;
+			}
+			a = bytesPerPixel == 4 ? p[3] / 255.0f : 1.0f;
+			for (c = 0; c < 3; c++)
+				f[c] = gSRGBToLinear[p[c]] * a;
+			f[3] = a;
+		}
+}
+
+static GLubyte MipClampByte(float v)
+{
+	if (v <= 0.0f) return 0;
+	if (v >= 255.0f) return 255;
+	return (GLubyte)(v + 0.5f);
+}
+
+static void MipFromFloat(const float *src, int width, int height, int bpp, GLubyte *dest)
+{
+	int bytesPerPixel = bpp / 8, i, c;
+	const float *f;
+	float a, l;
+
+	for (i = 0; i < width * height; i++)
+	{
+		f = &src[i * 4];
+		if (bytesPerPixel == 1)
+		{
+			dest[i] = MipClampByte(f[0] * 255.0f);
+			continue;
+		}
+		a = f[3];
+		for (c = 0; c < 3; c++)
+		{
+			l = a > 0.0f ? f[c] / a : 0.0f;
+			if (l < 0.0f) l = 0.0f;
+			if (l > 1.0f) l = 1.0f;
+			dest[i * bytesPerPixel + c] = gLinearToSRGB[(int)(l * kLinearToSRGBSize + 0.5f)];
+		}
+		if (bytesPerPixel == 4)
+			dest[i * 4 + 3] = MipClampByte(a * 255.0f);
+	}
+}
+
+// maxThreads is 1 when called from the batch loader, which already has
+// one thread per image.
+static bool BuildMipChainThreads(TextureData *texture, TGAMipChain *chain, int maxThreads)
+{
+	int filter = gMipmapFilter == kTGAMipmapGPU ? kTGAMipmapKaiser : gMipmapFilter;
+	int w = texture->width, h = texture->height, nw, nh;
+	float *cur, *tmp, *next;
+	MipAxis ax, ay;
+	MipJob job;
+
+	memset(chain, 0, sizeof(TGAMipChain));
+	if (texture->imageData == NULL || w == 0 || h == 0)
 		return false;
+	InitMipTables();
+	chain->bpp = texture->bpp;
+	chain->levels = 1;
+	chain->width[0] = w;
+	chain->height[0] = h;
+	chain->data[0] = texture->imageData;
+
+	cur = (float *)malloc((long)w * h * 4 * sizeof(float));
+	MipToFloat(texture->imageData, texture->w, w, h, texture->bpp, cur);
+	while ((w > 1 || h > 1) && chain->levels < kTGAMaxMipLevels)
+	{
+		nw = w > 1 ? w / 2 : 1;
+		nh = h > 1 ? h / 2 : 1;
+		BuildMipAxis(filter, w, nw, &ax);
+		BuildMipAxis(filter, h, nh, &ay);
+		tmp = (float *)malloc((long)nw * h * 4 * sizeof(float));
+		next = (float *)malloc((long)nw * nh * 4 * sizeof(float));
+
+		job.src = cur; job.dest = tmp;
+		job.srcWidth = w; job.destWidth = nw;
+		job.axis = &ax; job.vertical = false;
+		RunMipPass(&job, h, maxThreads);
+		job.src = tmp; job.dest = next;
+		job.srcWidth = nw;
+		job.axis = &ay; job.vertical = true;
+		RunMipPass(&job, nh, maxThreads);
+
+		free(ax.index); free(ax.weight);
+		free(ay.index); free(ay.weight);
+		free(tmp);
+		free(cur);
+		cur = next;
+
+		chain->width[chain->levels] = nw;
+		chain->height[chain->levels] = nh;
+		chain->data[chain->levels] = (GLubyte *)malloc((long)nw * nh * (texture->bpp / 8));
+		MipFromFloat(cur, nw, nh, texture->bpp, chain->data[chain->levels]);
+		chain->levels++;
+		w = nw;
+		h = nh;
+	}
+	free(cur);
+	return true;
+}
+
+// Builds all mip levels down to 1x1. Level 0 is texture->imageData itself
+// (rows of texture->w pixels), the other levels are tightly packed.
+bool BuildTGAMipChain(TextureData *texture, TGAMipChain *chain)
+{
+	return BuildMipChainThreads(texture, chain, kMaxMipThreads);
+}
+
+// Frees the levels built by BuildTGAMipChain, but not level 0
+void DisposeTGAMipChain(TGAMipChain *chain)
+{
+	int i;
+
+	for (i = 1; i < chain->levels; i++)
+		free(chain->data[i]);
+	chain->levels = 0;
+}
+
+#define kMipCacheMagic 0x3150494D // "MIP1"
+
+typedef struct
+{
+	unsigned int magic;
+	unsigned int filter, bpp, width, height, levels;
+	long long sourceSize, sourceTime;
+} MipCacheHeader;
+
+static bool ReadMipCache(char *cachename, struct stat *st, TextureData *texture, TGAMipChain *chain)
+{
+	MipCacheHeader header;
+	FILE *file;
+	long size;
+	int i;
+	bool ok = true;
+
+	file = fopen(cachename, "rb");
+	if (file == NULL)
+		return false;
+	if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != kMipCacheMagic ||
+		header.filter != (unsigned int)gMipmapFilter || header.bpp != texture->bpp ||
+		header.width != texture->width || header.height != texture->height ||
+		header.sourceSize != st->st_size || header.sourceTime != st->st_mtime ||
+		header.levels < 1 || header.levels > kTGAMaxMipLevels)
+	{
+		fclose(file);
+		return false;
+	}
+	memset(chain, 0, sizeof(TGAMipChain));
+	chain->bpp = texture->bpp;
+	chain->levels = 1;
+	chain->width[0] = texture->width;
+	chain->height[0] = texture->height;
+	chain->data[0] = texture->imageData;
+	for (i = 1; i < (int)header.levels && ok; i++)
+	{
+		chain->width[i] = chain->width[i-1] > 1 ? chain->width[i-1] / 2 : 1;
+		chain->height[i] = chain->height[i-1] > 1 ? chain->height[i-1] / 2 : 1;
+		size = (long)chain->width[i] * chain->height[i] * (texture->bpp / 8);
+		chain->data[i] = (GLubyte *)malloc(size);
+		chain->levels++;
+		ok = fread(chain->data[i], 1, size, file) == (size_t)size;
+	}
+	fclose(file);
+	if (!ok)
+		DisposeTGAMipChain(chain);
+	return ok;
+}
+
+static void WriteMipCache(char *cachename, struct stat *st, TGAMipChain *chain)
+{
+	MipCacheHeader header;
+	FILE *file;
+	int i;
+
+	file = fopen(cachename, "wb");
+	if (file == NULL)
+		return;
+	memset(&header, 0, sizeof(header));
+	header.magic = kMipCacheMagic;
+	header.filter = gMipmapFilter;
+	header.bpp = chain->bpp;
+	header.width = chain->width[0];
+	header.height = chain->height[0];
+	header.levels = chain->levels;
+	header.sourceSize = st->st_size;
+	header.sourceTime = st->st_mtime;
+	fwrite(&header, sizeof(header), 1, file);
+	for (i = 1; i < chain->levels; i++)
+		fwrite(chain->data[i], 1, (long)chain->width[i] * chain->height[i] * (chain->bpp / 8), file);
+	fclose(file);
+}
+
+// True if the mip levels of this image are built on the CPU.
+// Padded images have garbage outside the image, leave them to the GL.
+static bool UsesCPUMipmaps(TextureData *texture)
+{
+	return gMipmap && gMipmapFilter != kTGAMipmapGPU &&
+		texture->w == texture->width && texture->h == texture->height;
+}
+
+// Builds the mip levels of a loaded image, or loads them from the cache. No GL calls,
+// so this can run on any thread.
+static void PrepareTGAMipmaps(char *filename, TextureData *texture, TGAMipChain *chain, int maxThreads)
+{
+	struct stat st;
+	char *cachename = NULL;
+	bool cached = false;
+
+	if (gMipmapCache && filename != NULL && stat(filename, &st) == 0)
+	{
+		cachename = (char *)malloc(strlen(filename) + 5);
+		sprintf(cachename, "%s.mip", filename);
+		cached = ReadMipCache(cachename, &st, texture, chain);
+	}
+	if (!cached)
+	{
+		BuildMipChainThreads(texture, chain, maxThreads);
+		if (cachename != NULL)
+			WriteMipCache(cachename, &st, chain);
+	}
+	free(cachename);
+}
+
+// Builds A Texture From The Data. chain holds the mip levels, if built on the CPU.
+static void UploadTGATexture(TextureData *texture, TGAMipChain *chain)
+{
+	GLuint type = GL_RGBA;		// Set The Default GL Mode To RBGA (32 BPP)
+	int i;
 
-	// Build A Texture From The Data
 	glGenTextures(1, &texture->texID);			// Generate OpenGL texture IDs
-	glBindTexture(GL_TEXTURE_2D, texture->texID);		// Bind Our Texture
+	stateBindTexture(GL_TEXTURE_2D, texture->texID);		// Bind Our Texture
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);	// Linear Filtered
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);	// Linear Filtered
 	if (texture->bpp == 8)						// Was The TGA 8 Bits? Should be grayscale then.
@@ -225,17 +863,180 @@ bool LoadTGATexture(char *filename, TextureData *texture)	// Loads A TGA File In
 	{
 		type=GL_RGB;			// If So Set The 'type' To GL_RGB
 	}
+	// Rows are tightly packed, so 8 and 24 bit images may need byte alignment
+	if ((texture->w * (texture->bpp/8)) % 4 != 0)
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glTexImage2D(GL_TEXTURE_2D, 0, type, texture->w, texture->h, 0, type, GL_UNSIGNED_BYTE, texture[0].imageData);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4); // Back to default
 	
 	if (gMipmap)
 	{
-		glGenerateMipmap(GL_TEXTURE_2D);
+		if (chain != NULL && chain->levels > 0)
+		{
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			for (i = 1; i < chain->levels; i++)
+				glTexImage2D(GL_TEXTURE_2D, i, type, chain->width[i], chain->height[i], 0, type, GL_UNSIGNED_BYTE, chain->data[i]);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, chain->levels - 1);
+		}
+		else
+			glGenerateMipmap(GL_TEXTURE_2D);
 		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);	// Linear Filtered
 	}
+}
+
+// Creates the texture object for an image loaded with LoadTGATextureData
+void LoadTGAUploadTexture(TextureData *texture)
+{
+	TGAMipChain chain;
+
+	memset(&chain, 0, sizeof(chain));
+	if (UsesCPUMipmaps(texture))
+		PrepareTGAMipmaps(NULL, texture, &chain, kMaxMipThreads);
+	UploadTGATexture(texture, &chain);
+	DisposeTGAMipChain(&chain);
+}
+
+bool LoadTGATexture(char *filename, TextureData *texture)	// Loads A TGA File Into Memory and creates texture object
+{
+	TGAMipChain chain;
+	char ok;
+	
+	ok = LoadTGATextureData(filename, texture);	// Loads A TGA File Into Memory
+	if (!ok)
+		return false;
+
+	memset(&chain, 0, sizeof(chain));
+	if (UsesCPUMipmaps(texture))
+		PrepareTGAMipmaps(filename, texture, &chain, kMaxMipThreads);
+	UploadTGATexture(texture, &chain);
+	DisposeTGAMipChain(&chain);
 	
 	return true;				// Texture Building Went Ok, Return True
 }
 
+// --- Batch loading ---
+// Files are decoded (and their mip levels built) on a pool of threads that
+// take the next file from a shared counter. Only the upload is on the GL thread.
+
+typedef struct
+{
+	char **filenames;
+	TextureData *textures;
+	TGAMipChain *chains;	// NULL when only decoding
+	bool *ok;
+	int count;
+	int next;				// Next file to take
+#if !defined(_WIN32)
+	pthread_mutex_t mutex;
+#endif
+} TGABatch;
+
+static void *LoadTGABatchWorker(void *arg)
+{
+	TGABatch *batch = (TGABatch *)arg;
+	int i;
+
+	for (;;)
+	{
+#if !defined(_WIN32)
+		pthread_mutex_lock(&batch->mutex);
+#endif
+		i = batch->next++;
+#if !defined(_WIN32)
+		pthread_mutex_unlock(&batch->mutex);
+#endif
+		if (i >= batch->count)
+			break;
+		memset(&batch->textures[i], 0, sizeof(TextureData));
+		batch->ok[i] = LoadTGATextureData(batch->filenames[i], &batch->textures[i]);
+		if (batch->chains != NULL)
+		{
+			memset(&batch->chains[i], 0, sizeof(TGAMipChain));
+			if (batch->ok[i] && UsesCPUMipmaps(&batch->textures[i]))
+				PrepareTGAMipmaps(batch->filenames[i], &batch->textures[i], &batch->chains[i], 1);
+		}
+	}
+	return NULL;
+}
+
+static void RunTGABatch(TGABatch *batch)
+{
+	int threads = 1, i;
+#if !defined(_WIN32)
+	pthread_t tid[kMaxMipThreads];
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	threads = n > kMaxMipThreads ? kMaxMipThreads : (n < 1 ? 1 : (int)n);
+	if (threads > batch->count)
+		threads = batch->count;
+	pthread_mutex_init(&batch->mutex, NULL);
+	InitMipTables();
+	for (i = 1; i < threads; i++)
+		if (pthread_create(&tid[i], NULL, LoadTGABatchWorker, batch) != 0)
+			tid[i] = 0; // The other threads take its share
+	LoadTGABatchWorker(batch);
+	for (i = 1; i < threads; i++)
+		if (tid[i] != 0)
+			pthread_join(tid[i], NULL);
+	pthread_mutex_destroy(&batch->mutex);
+#else
+	(void)i;
+	(void)threads;
+	LoadTGABatchWorker(batch);
+#endif
+}
+
+// Decodes count files in parallel into textures (an array of count), no GL calls.
+// Files that fail get imageData = NULL. Returns the number of files loaded.
+int LoadTGATextureDataBatch(char **filenames, int count, TextureData *textures)
+{
+	TGABatch batch;
+	int i, loaded = 0;
+
+	if (count <= 0)
+		return 0;
+	memset(&batch, 0, sizeof(batch));
+	batch.filenames = filenames;
+	batch.textures = textures;
+	batch.count = count;
+	batch.ok = (bool *)malloc(count * sizeof(bool));
+	RunTGABatch(&batch);
+	for (i = 0; i < count; i++)
+		if (batch.ok[i])
+			loaded++;
+	free(batch.ok);
+	return loaded;
+}
+
+// Like LoadTGATexture for count files. Decoding and mipmaps are done in parallel,
+// then all textures are uploaded here. Files that fail get texID = 0.
+int LoadTGATextureBatch(char **filenames, int count, TextureData *textures)
+{
+	TGABatch batch;
+	int i, loaded = 0;
+
+	if (count <= 0)
+		return 0;
+	memset(&batch, 0, sizeof(batch));
+	batch.filenames = filenames;
+	batch.textures = textures;
+	batch.count = count;
+	batch.ok = (bool *)malloc(count * sizeof(bool));
+	batch.chains = (TGAMipChain *)malloc(count * sizeof(TGAMipChain));
+	RunTGABatch(&batch);
+	for (i = 0; i < count; i++)
+		if (batch.ok[i])
+		{
+			UploadTGATexture(&textures[i], &batch.chains[i]);
+			DisposeTGAMipChain(&batch.chains[i]);
+			loaded++;
+		}
+	free(batch.chains);
+	free(batch.ok);
+	return loaded;
+}
+
 void LoadTGATextureSimple(char *filename, GLuint *tex) // If you really only need the texture object.
 {
 	TextureData texture;
@@ -252,84 +1053,150 @@ void LoadTGATextureSimple(char *filename, GLuint *tex) // If you really only nee
 }
 
 
+// Run length encodes one row. Packets never cross rows, as the TGA spec recommends.
+static unsigned char *EncodeTGARow(const unsigned char *row, int width, int bytesPerPixel, unsigned char *out)
+{
+	int i = 0, run, raw;
+
+	while (i < width)
+	{
+		run = 1;
+		while (i + run < width && run < 128 &&
+				memcmp(row + i * bytesPerPixel, row + (i + run) * bytesPerPixel, bytesPerPixel) == 0)
+			run++;
+		if (run >= 2)
+		{
+			*out++ = 0x80 | (run - 1);
+			memcpy(out, row + i * bytesPerPixel, bytesPerPixel);
+			out += bytesPerPixel;
+			i += run;
+		}
+		else
+		{
+			// Raw pixels up to the start of the next run
+			raw = 1;
+			while (i + raw < width && raw < 128 &&
+					!(i + raw + 1 < width &&
+					memcmp(row + (i + raw) * bytesPerPixel, row + (i + raw + 1) * bytesPerPixel, bytesPerPixel) == 0))
+				raw++;
+			*out++ = raw - 1;
+			memcpy(out, row + i * bytesPerPixel, raw * bytesPerPixel);
+			out += raw * bytesPerPixel;
+			i += raw;
+		}
+	}
+	return out;
+}
+
+// Writes an image as a TGA file, with alpha for 32 bit images and as grayscale
+// for 8 bit images. Unlike SaveDataToTGA, imageData is neither changed nor freed.
+// rowLength is the number of pixels per row in imageData.
+// The whole file is built in memory and written with one fwrite.
+int WriteTGA(char *filename, int width, int height, int pixelDepth,
+			const unsigned char *imageData, int rowLength, int flags)
+{
+	int bytesPerPixel = pixelDepth / 8, x, y;
+	unsigned char *file, *out, *row;
+	const unsigned char *src;
+	FILE *f;
+	size_t size, written;
+
+	if (bytesPerPixel != 1 && bytesPerPixel != 3 && bytesPerPixel != 4)
+		return TGA_ERROR_INDEXED_COLOR;
+	// Worst case for RLE is one packet byte per pixel
+	file = (unsigned char *)malloc(18 + (size_t)height * width * (bytesPerPixel + 1));
+	row = (unsigned char *)malloc((size_t)width * bytesPerPixel);
+	if (file == NULL || row == NULL)
+	{
+		free(file);
+		free(row);
+		return TGA_ERROR_MEMORY;
+	}
+
+	memset(file, 0, 18);
+	file[2] = (bytesPerPixel == 1 ? 3 : 2) + ((flags & kTGAWriteRLE) ? 8 : 0);
+	file[12] = width & 255; file[13] = width >> 8;
+	file[14] = height & 255; file[15] = height >> 8;
+	file[16] = pixelDepth;
+	file[17] = bytesPerPixel == 4 ? 8 : 0; // Alpha bits, origin in the lower left corner
+	out = file + 18;
+
+	for (y = 0; y < height; y++)
+	{
+		src = imageData + (size_t)y * rowLength * bytesPerPixel;
+		if (bytesPerPixel >= 3 && !(flags & kTGAWriteBGR))
+		{
+			// RGB(A) to BGR(A)
+			for (x = 0; x < width; x++)
+			{
+				row[x * bytesPerPixel] = src[x * bytesPerPixel + 2];
+				row[x * bytesPerPixel + 1] = src[x * bytesPerPixel + 1];
+				row[x * bytesPerPixel + 2] = src[x * bytesPerPixel];
+				if (bytesPerPixel == 4)
+					row[x * 4 + 3] = src[x * 4 + 3];
+			}
+			src = row;
+		}
+		if (flags & kTGAWriteRLE)
+			out = EncodeTGARow(src, width, bytesPerPixel, out);
+		else
+		{
+			memcpy(out, src, (size_t)width * bytesPerPixel);
+			out += (size_t)width * bytesPerPixel;
+		}
+	}
+	free(row);
+
+	size = out - file;
+	f = fopen(filename, "wb");
+	if (f == NULL)
+	{
+		free(file);
+		return TGA_ERROR_FILE_OPEN;
+	}
+	written = fwrite(file, 1, size, f);
+	free(file);
+	// fclose flushes, so a full disk may only show up there
+	if (fclose(f) != 0 || written != size)
+		return TGA_ERROR_WRITING_FILE;
+	return TGA_OK;
+}
+
 // saves an array of pixels as a TGA image
 // Was tgaSave, found in some reusable code.
-// Limitation: Can NOT save with transparency! Only RGB, not RGBA!
-// But it should! Why not?
+// Now a wrapper around WriteTGA, which also handles RGBA and grayscale.
+// imageData must have tightly packed rows, and is freed!
 int SaveDataToTGA(char			*filename, 
 			 short int		width, 
 			 short int		height, 
 			 unsigned char	pixelDepth,
 			 unsigned char	*imageData)
 {
-	unsigned char cGarbage = 0, mode,aux;
-	int i, w, ix;
-	FILE *file;
-	char /*GLubyte*/ TGAuncompressedheader[12]={ 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0};	// Uncompressed TGA Header
-
-// open file and check for errors
-	file = fopen(filename, "w");
-	if (file == NULL)
-		return(TGA_ERROR_FILE_OPEN);
-
-// compute image type: 2 for RGB(A), 3 for greyscale
-	mode = pixelDepth / 8;
-// NOT YET IMPLEMENTED
-//	if ((pixelDepth == 24) || (pixelDepth == 32))
-//		type = 2;
-//	else
-//		type = 3;
-
-// write the header
-	fwrite(&TGAuncompressedheader, 12, 1, file);
-	fwrite(&width, sizeof(short int), 1, file);
-	fwrite(&height, sizeof(short int), 1, file);
-	fwrite(&pixelDepth, sizeof(unsigned char), 1, file);
-
-	fwrite(&cGarbage, sizeof(unsigned char), 1, file);
-
-// convert the image data from RGB(a) to BGR(A)
-	if (mode >= 3)
-	for (i=0; i < width * height * mode ; i+= mode)
-	{
-		aux = imageData[i];
-		imageData[i] = imageData[i+2];
-		imageData[i+2] = aux;
-	}
-
-// save the image data
-	w = 1;
-	while (w < width) w = w << 1;
-//	bytesPerPixel = pixelDepth/8;	
-//	row = width * bytesPerPixel;
-	
-// Write one row at a time
-	for (i = 0; i < height; i++)
-	{
-		ix = i * w * mode;
-		fwrite(&imageData[ix], sizeof(unsigned char), width * mode, file);
-	}
-
-	fclose(file);
+	int err = WriteTGA(filename, width, height, pixelDepth, imageData, width, 0);
 // release the memory
 	free(imageData);
-
-	return(TGA_OK);
+	return err;
 }
 
 // Save a TextureData
 // Problem: Saves upside down!
+// Like SaveDataToTGA, the image data is freed!
 void SaveTGA(TextureData *tex, char *filename)
 {
-	SaveDataToTGA(filename, tex->width, tex->height, 
-			tex->bpp, tex->imageData);
+	WriteTGA(filename, tex->width, tex->height, tex->bpp, tex->imageData, tex->w, 0);
+	free(tex->imageData);
+	tex->imageData = NULL;
 }
 
+// Synchronous, stalls until the GPU is done. FrameCapture.c does the same
+// without stalling.
 void SaveFramebufferToTGA(char *filename, GLint x, GLint y, GLint w, GLint h)
 {
 	int err;
 	void *buffer = malloc(h*w*3);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1); // Tightly packed rows, as SaveDataToTGA expects
 	glReadPixels(x, y, w, h, GL_RGB, GL_UNSIGNED_BYTE, buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
 	err = SaveDataToTGA(filename, w, h, 
 			3*8, buffer);
 //	free(buffer); already done
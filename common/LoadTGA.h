@@ -46,9 +46,37 @@ typedef struct TextureData		// Create A Structure for .tga loading.
 bool LoadTGATexture(char *filename, TextureData *texture);
 void LoadTGATextureSimple(char *filename, GLuint *tex);
 void LoadTGASetMipmapping(bool active);
+void LoadTGASetPadding(bool active);
+void LoadTGAPrintMemoryStats(void);
 bool LoadTGATextureData(char *filename, TextureData *texture);
+void LoadTGAUploadTexture(TextureData *texture);
+// Load many files at once, decoding on several threads
+int LoadTGATextureDataBatch(char **filenames, int count, TextureData *textures);
+int LoadTGATextureBatch(char **filenames, int count, TextureData *textures);
+
+// Mipmap filters for LoadTGASetMipmapFilter
+#define kTGAMipmapGPU		0	// glGenerateMipmap, box filter in the driver
+#define kTGAMipmapKaiser	1	// CPU, gamma correct Kaiser windowed sinc (default)
+#define kTGAMipmapLanczos	2	// CPU, gamma correct Lanczos 3
+
+#define kTGAMaxMipLevels 16
+
+// Mip levels built on the CPU. data[0] is the image itself.
+typedef struct TGAMipChain
+{
+	GLuint	bpp;
+	int		levels;
+	GLuint	width[kTGAMaxMipLevels], height[kTGAMaxMipLevels];
+	GLubyte	*data[kTGAMaxMipLevels];
+} TGAMipChain;
+
+void LoadTGASetMipmapFilter(int filter);
+void LoadTGASetMipmapCache(bool active);
+bool BuildTGAMipChain(TextureData *texture, TGAMipChain *chain);
+void DisposeTGAMipChain(TGAMipChain *chain);
 
 // Constants for SaveTGA
+#define TGA_ERROR_WRITING_FILE			-6
 #define	TGA_ERROR_FILE_OPEN				-5
 #define TGA_ERROR_READING_FILE			-4
 #define TGA_ERROR_INDEXED_COLOR			-3
@@ -56,13 +84,21 @@ bool LoadTGATextureData(char *filename, TextureData *texture);
 #define TGA_ERROR_COMPRESSED_FILE		-1
 #define TGA_OK							 0
 
-// Save functions
+// Save functions. Both free the image data (tex->imageData for SaveTGA),
+// WriteTGA does not.
 int SaveDataToTGA(char			*filename, 
 			 short int		width, 
 			 short int		height, 
 			 unsigned char	pixelDepth,
 			 unsigned char	*imageData);
 void SaveTGA(TextureData *tex, char *filename);
+
+// Flags for WriteTGA
+#define kTGAWriteRLE	1	// Run length encoded (type 10/11)
+#define kTGAWriteBGR	2	// imageData is already BGR(A), as read with GL_BGR(A)
+
+int WriteTGA(char *filename, int width, int height, int pixelDepth,
+			const unsigned char *imageData, int rowLength, int flags);
 void SaveFramebufferToTGA(char *filename, GLint x, GLint y, GLint w, GLint h);
 
 #ifdef __cplusplus
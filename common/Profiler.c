@@ -0,0 +1,235 @@
+// Profiler, GPU time per named scope from timer queries.
+// ProfBegin and ProfEnd put a GL_TIMESTAMP query (glQueryCounter) before and
+// after the scope. Unlike GL_TIME_ELAPSED queries these can nest.
+// The queries of each frame are kept in a ring of kProfFrames frames.
+// ProfFrame checks if the last query of an earlier frame is available and
+// only then reads that frame, so the CPU never waits for the GPU. If the
+// GPU is more than kProfFrames frames behind, the frame is dropped.
+// Each name keeps its per-frame time for the last kProfWindow frames, and
+// the sum of the outermost scopes is kept as the frame total.
+
+// 261019: First version.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Profiler.h"
+
+typedef struct
+{
+	int name, depth;
+} ProfScope;
+
+typedef struct
+{
+	char *name;
+	int depth;					// Of the first use, for indenting
+	float samples[kProfWindow];	// ms per frame
+	int count, next;
+	double frameSum;
+	char seen;
+} ProfName;
+
+static GLuint profQueries[kProfFrames][2 * kProfMaxScopes];
+static ProfScope profScopes[kProfFrames][kProfMaxScopes];
+static int profCount[kProfFrames];
+static int profLastQuery[kProfFrames];	// Ends last, done last
+static char profWaiting[kProfFrames];	// Issued but not read
+static int profSlot = 0;
+static int profStack[kProfMaxDepth], profDepth = 0;
+static int profTooDeep = 0;				// Scopes past kProfMaxDepth
+static char profInitialized = 0;
+static long profFrames = 0, profDropped = 0, profSkipped = 0;
+
+static ProfName profNames[kProfMaxNames];
+static ProfName profTotal;
+static int profNumNames = 0;
+
+static void ProfAddSample(ProfName *n, float ms)
+{
+	n->samples[n->next] = ms;
+	n->next = (n->next + 1) % kProfWindow;
+	if (n->count < kProfWindow)
+		n->count++;
+}
+
+static int ProfFindName(const char *name)
+{
+	int i;
+
+	for (i = 0; i < profNumNames; i++)
+		if (strcmp(profNames[i].name, name) == 0)
+			return i;
+	if (profNumNames == kProfMaxNames)
+		return -1;
+	memset(&profNames[i], 0, sizeof(ProfName));
+	profNames[i].name = (char *)malloc(strlen(name) + 1);
+	strcpy(profNames[i].name, name);
+	profNames[i].depth = profDepth;
+	profNumNames++;
+	return i;
+}
+
+void ProfBegin(const char *name)
+{
+	int i, n;
+
+	if (!profInitialized)
+	{
+		for (i = 0; i < kProfFrames; i++)
+			glGenQueries(2 * kProfMaxScopes, profQueries[i]);
+		profInitialized = 1;
+	}
+	if (profDepth == kProfMaxDepth)
+	{
+		profSkipped++;
+		profTooDeep++;
+		return;
+	}
+	n = ProfFindName(name);
+	i = profCount[profSlot];
+	if (n < 0 || i == kProfMaxScopes)
+	{
+		profSkipped++;
+		profStack[profDepth++] = -1; // ProfEnd still pops it
+		return;
+	}
+	profScopes[profSlot][i].name = n;
+	profScopes[profSlot][i].depth = profDepth;
+	glQueryCounter(profQueries[profSlot][2 * i], GL_TIMESTAMP);
+	profLastQuery[profSlot] = 2 * i;
+	profCount[profSlot]++;
+	profStack[profDepth++] = i;
+}
+
+void ProfEnd(void)
+{
+	int i;
+
+	if (profTooDeep > 0)
+	{
+		profTooDeep--;
+		return;
+	}
+	if (profDepth == 0)
+		return;
+	i = profStack[--profDepth];
+	if (i < 0)
+		return;
+	glQueryCounter(profQueries[profSlot][2 * i + 1], GL_TIMESTAMP);
+	profLastQuery[profSlot] = 2 * i + 1;
+}
+
+// Returns 0 if the GPU is not done with the frame yet
+static char ProfRead(int slot)
+{
+	GLint available = 0;
+	GLuint64 begin, end;
+	double total = 0.0, ms;
+	int i;
+
+	glGetQueryObjectiv(profQueries[slot][profLastQuery[slot]], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return 0;
+	for (i = 0; i < profCount[slot]; i++)
+	{
+		glGetQueryObjectui64v(profQueries[slot][2 * i], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(profQueries[slot][2 * i + 1], GL_QUERY_RESULT, &end);
+		ms = (end - begin) * 0.000001;
+		profNames[profScopes[slot][i].name].frameSum += ms;
+		profNames[profScopes[slot][i].name].seen = 1;
+		if (profScopes[slot][i].depth == 0)
+			total += ms;
+	}
+	for (i = 0; i < profNumNames; i++)
+		if (profNames[i].seen)
+		{
+			ProfAddSample(&profNames[i], profNames[i].frameSum);
+			profNames[i].frameSum = 0.0;
+			profNames[i].seen = 0;
+		}
+	ProfAddSample(&profTotal, total);
+	return 1;
+}
+
+void ProfFrame(void)
+{
+	int i, slot;
+
+	if (!profInitialized)
+		return;
+	// Scopes left open end with the frame
+	profTooDeep = 0;
+	while (profDepth > 0)
+		ProfEnd();
+
+	profWaiting[profSlot] = profCount[profSlot] > 0;
+	profSlot = (profSlot + 1) % kProfFrames;
+	profFrames++;
+
+	// Oldest first, the slot to be used next is the oldest
+	for (i = 0; i < kProfFrames - 1; i++)
+	{
+		slot = (profSlot + i) % kProfFrames;
+		if (profWaiting[slot] && ProfRead(slot))
+			profWaiting[slot] = 0;
+	}
+	if (profWaiting[profSlot])
+	{
+		profDropped++;
+		profWaiting[profSlot] = 0;
+	}
+	profCount[profSlot] = 0;
+}
+
+static int ProfCompare(const void *a, const void *b)
+{
+	float x = *(const float *)a, y = *(const float *)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void ProfPrintName(ProfName *n, double frameAverage)
+{
+	float sorted[kProfWindow];
+	double sum = 0.0;
+	int i;
+
+	if (n->count == 0)
+		return;
+	memcpy(sorted, n->samples, n->count * sizeof(float));
+	qsort(sorted, n->count, sizeof(float), ProfCompare);
+	for (i = 0; i < n->count; i++)
+		sum += sorted[i];
+	printf("Prof: %*s%-*s min %7.3f  avg %7.3f  p99 %7.3f ms  %5.1f%%\n",
+		2 * n->depth, "", 20 - 2 * n->depth, n->name,
+		sorted[0], sum / n->count, sorted[(n->count * 99 - 1) / 100],
+		frameAverage > 0.0 ? 100.0 * sum / n->count / frameAverage : 0.0);
+}
+
+void ProfPrint(void)
+{
+	double frameAverage = 0.0;
+	int i;
+
+	for (i = 0; i < profTotal.count; i++)
+		frameAverage += profTotal.samples[i];
+	if (profTotal.count > 0)
+		frameAverage /= profTotal.count;
+	printf("Prof: last %d of %ld frames, %ld dropped, %ld scopes not timed\n",
+		profTotal.count, profFrames, profDropped, profSkipped);
+	for (i = 0; i < profNumNames; i++)
+		ProfPrintName(&profNames[i], frameAverage);
+	profTotal.name = "total";
+	ProfPrintName(&profTotal, frameAverage);
+}
+
+void ProfReset(void)
+{
+	int i;
+
+	for (i = 0; i < profNumNames; i++)
+		profNames[i].count = profNames[i].next = 0;
+	profTotal.count = profTotal.next = 0;
+	profFrames = profDropped = profSkipped = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef _PROFILER_
+#define _PROFILER_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "GL_utilities.h"
+
+// GPU time per named scope. Scopes may nest, and a name used several times
+// in a frame is added up for that frame.
+//
+//	ProfBegin("bloom");
+//	...
+//	ProfEnd();
+//	glutSwapBuffers();
+//	ProfFrame();
+
+#define kProfFrames 4			// Frames in flight before results are dropped
+#define kProfMaxScopes 512		// Per frame, more are not timed
+#define kProfMaxNames 64
+#define kProfMaxDepth 16
+#define kProfWindow 256			// Frames in the statistics
+
+void ProfBegin(const char *name);
+void ProfEnd(void);
+// Call once per frame. Reads the results of earlier frames that are done.
+void ProfFrame(void);
+// Min, average and 99th percentile per name over the last kProfWindow frames.
+void ProfPrint(void);
+void ProfReset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,376 @@
+// RenderGraph, declarative chains of full screen passes.
+// Passes are declared once with their inputs and output format, then
+// RGExecute runs them every frame. The graph is compiled on the first run:
+// - Passes that nothing on the window depends on are culled.
+// - Per-pixel shader passes (only a and b, no offsets) with a single reader
+// are fused into the reader's shader, so their target is never written.
+// - Shader passes with the same generated source share one program.
+// Targets come from the FBO pool and are released after their last reader,
+// so a long chain like a repeated blur ping-pongs between two targets
+// without any bookkeeping in the caller.
+// With timing on, every pass is a profiler scope with the pass name.
+
+// 261019: First version.
+// 261019: Timing uses the profiler instead of its own queries.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RenderGraph.h"
+#include "Profiler.h"
+
+typedef struct
+{
+	char *name;
+	GLenum format;				// 0 for the window
+	int depth;
+	RGDrawFunc draw;			// NULL for shader passes
+	void *data;
+	char *expression;
+	int input[2];
+	char pointwise;				// Expression reads a and b only
+	// Set by RGCompile
+	char live, fused;
+	int readers;				// Live passes reading this one
+	int lastReader;				// Last pass to run that reads this target
+	int numExternal, external[kRGMaxInputs]; // Targets bound as rgTex0...
+	GLuint program;
+	FBOstruct *target;
+} RGPass;
+
+struct RenderGraph
+{
+	int count;
+	RGPass *passes;
+	char compiled, timing;
+	GLuint vao;
+	int numPrograms;
+	char *sources[kRGMaxPasses];
+	GLuint programs[kRGMaxPasses];
+};
+
+// A full screen triangle from gl_VertexID, no vertex buffer needed
+static const char *rgVertexShader =
+	"#version 150\n"
+	"out vec2 outTexCoord;\n"
+	"void main(void)\n"
+	"{\n"
+	"	vec2 p = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);\n"
+	"	outTexCoord = p * 0.5 + 0.5;\n"
+	"	gl_Position = vec4(p, 0.0, 1.0);\n"
+	"}\n";
+
+typedef struct
+{
+	char *s;
+	int length, size;
+} RGString;
+
+static void Append(RGString *str, const char *s)
+{
+	int n = strlen(s);
+
+	if (str->length + n + 1 > str->size)
+	{
+		str->size = (str->length + n + 1) * 2;
+		str->s = (char *)realloc(str->s, str->size);
+	}
+	memcpy(str->s + str->length, s, n + 1);
+	str->length += n;
+}
+
+static char *CopyString(const char *s)
+{
+	char *c = (char *)malloc(strlen(s) + 1);
+	strcpy(c, s);
+	return c;
+}
+
+RenderGraph *RGCreate(void)
+{
+	RenderGraph *g = (RenderGraph *)calloc(1, sizeof(RenderGraph));
+	g->passes = (RGPass *)calloc(kRGMaxPasses, sizeof(RGPass));
+	return g;
+}
+
+static int AddPass(RenderGraph *g, const char *name, GLenum format, int a, int b)
+{
+	RGPass *p;
+
+	if (g->count == kRGMaxPasses || a >= g->count || b >= g->count
+		|| (a >= 0 && g->passes[a].format == 0) || (b >= 0 && g->passes[b].format == 0))
+	{
+		fprintf(stderr, "RenderGraph: can not add pass %s\n", name);
+		return -1;
+	}
+	p = &g->passes[g->count];
+	p->name = CopyString(name);
+	p->format = format;
+	p->input[0] = a;
+	p->input[1] = b;
+	g->compiled = 0;
+	return g->count++;
+}
+
+int RGDrawPass(RenderGraph *g, const char *name, GLenum format, int depth, RGDrawFunc draw, void *data)
+{
+	int i = AddPass(g, name, format, -1, -1);
+
+	if (i >= 0)
+	{
+		g->passes[i].depth = depth;
+		g->passes[i].draw = draw;
+		g->passes[i].data = data;
+	}
+	return i;
+}
+
+int RGShaderPass(RenderGraph *g, const char *name, GLenum format, const char *expression, int a, int b)
+{
+	int i = AddPass(g, name, format, a, b);
+
+	if (i >= 0)
+	{
+		g->passes[i].expression = CopyString(expression);
+		g->passes[i].pointwise = strstr(expression, "A(") == NULL && strstr(expression, "B(") == NULL;
+	}
+	return i;
+}
+
+// The targets a pass reads, looking through fused passes
+static void CollectExternal(RenderGraph *g, RGPass *root, int p)
+{
+	int k, j, in;
+
+	for (k = 0; k < 2; k++)
+	{
+		in = g->passes[p].input[k];
+		if (in < 0)
+			continue;
+		if (g->passes[in].fused)
+		{
+			CollectExternal(g, root, in);
+			continue;
+		}
+		for (j = 0; j < root->numExternal; j++)
+			if (root->external[j] == in)
+				break;
+		if (j < root->numExternal)
+			continue;
+		if (root->numExternal == kRGMaxInputs)
+			fprintf(stderr, "RenderGraph: %s reads more than %d targets\n", root->name, kRGMaxInputs);
+		else
+			root->external[root->numExternal++] = in;
+	}
+}
+
+// Emits a function for pass p, after the functions of the passes fused into it.
+// Functions are numbered in order, so equal chains give equal source.
+static int EmitPass(RenderGraph *g, RGPass *root, int p, RGString *src, int *counter)
+{
+	char line[256];
+	int k, j, in, f[2] = {-1, -1};
+
+	for (k = 0; k < 2; k++)
+		if (g->passes[p].input[k] >= 0 && g->passes[g->passes[p].input[k]].fused)
+			f[k] = EmitPass(g, root, g->passes[p].input[k], src, counter);
+
+	for (k = 0; k < 2; k++)
+	{
+		in = g->passes[p].input[k];
+		if (in < 0)
+			sprintf(line, "#define %c(dx, dy) vec4(0.0)\n", "AB"[k]);
+		else if (f[k] >= 0)
+			sprintf(line, "#define %c(dx, dy) f%d(uv + vec2(dx, dy) * rgTexel)\n", "AB"[k], f[k]);
+		else
+		{
+			for (j = 0; j < root->numExternal - 1 && root->external[j] != in; j++);
+			sprintf(line, "#define %c(dx, dy) texture(rgTex%d, uv + vec2(dx, dy) * rgTexel)\n", "AB"[k], j);
+		}
+		Append(src, line);
+	}
+	sprintf(line, "vec4 f%d(vec2 uv)\n{\n\tvec4 a = A(0.0, 0.0);\n\tvec4 b = B(0.0, 0.0);\n\treturn ", *counter);
+	Append(src, line);
+	Append(src, g->passes[p].expression);
+	Append(src, ";\n}\n#undef A\n#undef B\n");
+	return (*counter)++;
+}
+
+static GLuint ShaderPassProgram(RenderGraph *g, int p)
+{
+	RGString src = {NULL, 0, 0};
+	char line[64];
+	int i, counter = 0;
+
+	Append(&src, "#version 150\n"
+		"uniform sampler2D rgTex0, rgTex1, rgTex2, rgTex3;\n"
+		"uniform vec2 rgTexel;\n"
+		"in vec2 outTexCoord;\n"
+		"out vec4 fragColor;\n");
+	i = EmitPass(g, &g->passes[p], p, &src, &counter);
+	sprintf(line, "void main(void)\n{\n\tfragColor = f%d(outTexCoord);\n}\n", i);
+	Append(&src, line);
+
+	// Kept across recompiles, so a program is never deleted while in use
+	for (i = 0; i < g->numPrograms; i++)
+		if (strcmp(g->sources[i], src.s) == 0)
+		{
+			free(src.s);
+			return g->programs[i];
+		}
+	if (g->numPrograms == kRGMaxPasses)
+	{
+		fprintf(stderr, "RenderGraph: too many programs\n");
+		free(src.s);
+		return 0;
+	}
+	g->sources[g->numPrograms] = src.s;
+	g->programs[g->numPrograms] = compileShaders(rgVertexShader, src.s, NULL, NULL, NULL,
+		"RenderGraph", g->passes[p].name, NULL, NULL, NULL);
+	return g->programs[g->numPrograms++];
+}
+
+static void RGCompile(RenderGraph *g)
+{
+	RGPass *p;
+	int i, k, culled = 0, fused = 0;
+
+	for (i = 0; i < g->count; i++)
+	{
+		p = &g->passes[i];
+		p->live = (p->format == 0);
+		p->fused = 0;
+		p->readers = 0;
+		p->lastReader = -1;
+		p->numExternal = 0;
+	}
+	// Inputs always come before their readers
+	for (i = g->count - 1; i >= 0; i--)
+	{
+		p = &g->passes[i];
+		if (!p->live)
+		{
+			culled++;
+			continue;
+		}
+		for (k = 0; k < 2; k++)
+			if (p->input[k] >= 0 && (k == 0 || p->input[1] != p->input[0]))
+			{
+				g->passes[p->input[k]].live = 1;
+				g->passes[p->input[k]].readers++;
+				g->passes[p->input[k]].lastReader = i;
+			}
+	}
+	for (i = 0; i < g->count; i++)
+	{
+		p = &g->passes[i];
+		if (p->live && p->draw == NULL && p->pointwise && p->format != 0 && p->readers == 1
+			&& g->passes[p->lastReader].draw == NULL)
+		{
+			p->fused = 1;
+			fused++;
+		}
+	}
+	// Targets are released after the last pass that really reads them
+	for (i = 0; i < g->count; i++)
+		g->passes[i].lastReader = -1;
+	for (i = 0; i < g->count; i++)
+	{
+		p = &g->passes[i];
+		if (!p->live || p->fused || p->draw != NULL)
+			continue;
+		CollectExternal(g, p, i);
+		for (k = 0; k < p->numExternal; k++)
+			g->passes[p->external[k]].lastReader = i;
+		p->program = ShaderPassProgram(g, i);
+	}
+
+	if (g->vao == 0)
+		glGenVertexArrays(1, &g->vao);
+	g->compiled = 1;
+	printf("RenderGraph: %d passes, %d culled, %d fused, %d programs\n", g->count, culled, fused, g->numPrograms);
+}
+
+void RGExecute(RenderGraph *g)
+{
+	RGPass *p;
+	int i, k;
+
+	if (!g->compiled)
+		RGCompile(g);
+
+	for (i = 0; i < g->count; i++)
+	{
+		p = &g->passes[i];
+		if (!p->live || p->fused)
+			continue;
+
+		if (g->timing)
+			ProfBegin(p->name);
+
+		p->target = p->format != 0 ? acquireFBO(0, 0, p->format, p->depth, 1) : NULL;
+		if (p->draw != NULL)
+		{
+			useFBO(p->target, NULL, NULL);
+			p->draw(p->data);
+		}
+		else
+		{
+			useFBO(p->target,
+				p->numExternal > 0 ? g->passes[p->external[0]].target : NULL,
+				p->numExternal > 1 ? g->passes[p->external[1]].target : NULL);
+			for (k = 2; k < p->numExternal; k++)
+			{
+				stateActiveTexture(GL_TEXTURE0 + k);
+				stateBindTexture(GL_TEXTURE_2D, g->passes[p->external[k]].target->texid);
+			}
+			stateActiveTexture(GL_TEXTURE0);
+			stateUseProgram(p->program);
+			setUniform1i(p->program, "rgTex0", 0);
+			setUniform1i(p->program, "rgTex1", 1);
+			setUniform1i(p->program, "rgTex2", 2);
+			setUniform1i(p->program, "rgTex3", 3);
+			if (p->numExternal > 0)
+				setUniform2f(p->program, "rgTexel", 1.0 / g->passes[p->external[0]].target->width,
+					1.0 / g->passes[p->external[0]].target->height);
+			stateDisable(GL_DEPTH_TEST);
+			stateDisable(GL_CULL_FACE);
+			stateBindVertexArray(g->vao);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+
+		if (g->timing)
+			ProfEnd();
+		for (k = 0; k < p->numExternal; k++)
+			if (g->passes[p->external[k]].lastReader == i)
+				releaseFBO(g->passes[p->external[k]].target);
+	}
+}
+
+void RGEnableTiming(RenderGraph *g, char enable)
+{
+	g->timing = enable;
+}
+
+void RGDispose(RenderGraph *g)
+{
+	int i;
+
+	if (g == NULL)
+		return;
+	for (i = 0; i < g->count; i++)
+	{
+		free(g->passes[i].name);
+		free(g->passes[i].expression);
+	}
+	for (i = 0; i < g->numPrograms; i++)
+	{
+		free(g->sources[i]);
+		glDeleteProgram(g->programs[i]);
+	}
+	if (g->vao != 0)
+		glDeleteVertexArrays(1, &g->vao);
+	free(g->passes);
+	free(g);
+}
@@ -0,0 +1,37 @@
+#ifndef _RENDER_GRAPH_
+#define _RENDER_GRAPH_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "GL_utilities.h"
+
+// Passes are declared once, in order, and the graph is run every frame.
+// Each pass writes one new window sized target, and its number is used as
+// the input of later passes. Format 0 draws to the window instead.
+//
+// Shader passes are a GLSL expression for the colour. The inputs are
+// a and b (the texel under the pixel), or A(dx, dy) and B(dx, dy) for
+// a texel at an offset in texels. Pass -1 for an unused input.
+
+#define kRGMaxPasses 1024
+#define kRGMaxInputs 4
+
+typedef struct RenderGraph RenderGraph;
+typedef void (*RGDrawFunc)(void *data);
+
+RenderGraph *RGCreate(void);
+void RGDispose(RenderGraph *g);
+int RGDrawPass(RenderGraph *g, const char *name, GLenum format, int depth, RGDrawFunc draw, void *data);
+int RGShaderPass(RenderGraph *g, const char *name, GLenum format, const char *expression, int a, int b);
+void RGExecute(RenderGraph *g);
+
+// Makes every pass a profiler scope with the pass name (see Profiler.h)
+void RGEnableTiming(RenderGraph *g, char enable);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,302 @@
+// TextureAtlas, runtime atlas builder for sprites and other small textures.
+// Many images in one texture means that objects using different images can
+// be drawn without changing texture binding in between.
+// Two variants:
+// BuildTextureAtlas packs images of any size into one GL_TEXTURE_2D, using
+// shelf packing (sorted by height). The atlas is not padded to power of two.
+// Each image gets a border of replicated edge pixels and is placed on a
+// multiple of the border size, so the first mip levels do not bleed between
+// images.
+// BuildTextureArray stacks images of the same size into a GL_TEXTURE_2D_ARRAY.
+// Nothing can bleed there, and all mip levels are fine.
+// Images are always stored as RGBA. Grayscale images go to the red channel,
+// like LoadTGATexture does.
+
+// 261019: First version.
+// 261019: Images are decoded in parallel with LoadTGATextureDataBatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_WIN32)
+	#include <time.h>
+#else
+	#include <sys/time.h>
+#endif
+
+#include "TextureAtlas.h"
+#include "GL_utilities.h"
+
+static double AtlasTime(void)
+{
+#if defined(_WIN32)
+	return (double)clock() / CLOCKS_PER_SEC;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 0.000001;
+#endif
+}
+
+// Decodes all images in parallel, fails if any of them fails.
+static TextureData *LoadAtlasImages(char **filenames, int count)
+{
+	TextureData *images;
+	int i;
+
+	images = (TextureData *)calloc(count, sizeof(TextureData));
+	if (LoadTGATextureDataBatch(filenames, count, images) == count)
+		return images;
+	for (i = 0; i < count; i++)
+		if (images[i].imageData == NULL)
+			printf("TextureAtlas: could not load %s\n", filenames[i]);
+		else
+			free(images[i].imageData);
+	free(images);
+	return NULL;
+}
+
+static void FreeAtlasImages(TextureData *images, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		free(images[i].imageData);
+	free(images);
+}
+
+// Reads one pixel as RGBA
+static void GetRGBA(TextureData *t, int x, int y, GLubyte *dest)
+{
+	int bytesPerPixel = t->bpp / 8;
+	GLubyte *p = &t->imageData[(y * t->w + x) * bytesPerPixel];
+
+	dest[0] = p[0];
+	dest[1] = bytesPerPixel >= 3 ? p[1] : 0;
+	dest[2] = bytesPerPixel >= 3 ? p[2] : 0;
+	dest[3] = bytesPerPixel == 4 ? p[3] : 255;
+}
+
+// Copies an image to (x, y) in dest, with a border of replicated edge pixels
+static void BlitPadded(TextureData *t, GLubyte *dest, int destWidth, int x, int y, int padding)
+{
+	int dx, dy, sx, sy;
+
+	for (dy = 0; dy < (int)t->height + 2*padding; dy++)
+	{
+		sy = dy - padding;
+		if (sy < 0) sy = 0;
+		if (sy >= (int)t->height) sy = t->height - 1;
+		for (dx = 0; dx < (int)t->width + 2*padding; dx++)
+		{
+			sx = dx - padding;
+			if (sx < 0) sx = 0;
+			if (sx >= (int)t->width) sx = t->width - 1;
+			GetRGBA(t, sx, sy, &dest[((y + dy) * destWidth + x + dx) * 4]);
+		}
+	}
+}
+
+// Shelf packing into the given width. order is sorted by decreasing height.
+// Returns the height needed.
+static int PackShelves(int count, int *order, int *pw, int *ph, int width, int *x, int *y)
+{
+	int shelfX = 0, shelfY = 0, shelfH = 0;
+	int i, k;
+
+	for (k = 0; k < count; k++)
+	{
+		i = order[k];
+		if (shelfX + pw[i] > width) // New shelf
+		{
+			shelfY += shelfH;
+			shelfX = 0;
+			shelfH = 0;
+		}
+		x[i] = shelfX;
+		y[i] = shelfY;
+		shelfX += pw[i];
+		if (ph[i] > shelfH)
+			shelfH = ph[i];
+	}
+	return shelfY + shelfH;
+}
+
+TextureAtlas *BuildTextureAtlas(char **filenames, int count, int padding)
+{
+	TextureData *images;
+	TextureAtlas *atlas;
+	GLubyte *data;
+	GLint maxSize;
+	int *order, *pw, *ph, *x, *y;
+	int i, j, tmp, align, width, height, w, h, minWidth;
+	long area = 0, used = 0;
+	double t0 = AtlasTime();
+
+	if (count <= 0)
+		return NULL;
+	images = LoadAtlasImages(filenames, count);
+	if (images == NULL)
+		return NULL;
+
+	// Positions are aligned to the padding, rounded up to power of two
+	align = 1;
+	while (align < padding) align = align << 1;
+
+	order = (int *)malloc(count * sizeof(int));
+	pw = (int *)malloc(count * sizeof(int));
+	ph = (int *)malloc(count * sizeof(int));
+	x = (int *)malloc(count * sizeof(int));
+	y = (int *)malloc(count * sizeof(int));
+	for (i = 0; i < count; i++)
+	{
+		order[i] = i;
+		pw[i] = (images[i].width + 2*padding + align - 1) / align * align;
+		ph[i] = (images[i].height + 2*padding + align - 1) / align * align;
+		area += pw[i] * ph[i];
+		used += images[i].width * images[i].height;
+	}
+	// Sort by height, tallest first (insertion sort, there are not that many)
+	for (i = 1; i < count; i++)
+		for (j = i; j > 0 && ph[order[j]] > ph[order[j-1]]; j--)
+		{
+			tmp = order[j]; order[j] = order[j-1]; order[j-1] = tmp;
+		}
+
+	// The atlas does not need to be power of two. Try all widths from the
+	// square root of the area and up, and keep the one with the least area.
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	minWidth = align;
+	while ((long)minWidth * minWidth < area) minWidth += align;
+	for (i = 0; i < count; i++)
+		if (pw[i] > minWidth) minWidth = pw[i];
+	width = height = 0;
+	for (w = minWidth; w <= maxSize && w <= 2 * minWidth; w += align)
+	{
+		h = PackShelves(count, order, pw, ph, w, x, y);
+		if (h <= maxSize && (width == 0 || (long)w * h < (long)width * height))
+		{
+			width = w;
+			height = h;
+		}
+	}
+	if (width == 0)
+	{
+		printf("TextureAtlas: %d images do not fit in %dx%d\n", count, maxSize, maxSize);
+		free(order); free(pw); free(ph); free(x); free(y);
+		FreeAtlasImages(images, count);
+		return NULL;
+	}
+	PackShelves(count, order, pw, ph, width, x, y);
+
+	data = (GLubyte *)calloc(width * height, 4);
+	atlas = (TextureAtlas *)malloc(sizeof(TextureAtlas));
+	atlas->rects = (AtlasRect *)malloc(count * sizeof(AtlasRect));
+	atlas->count = count;
+	atlas->width = width;
+	atlas->height = height;
+	atlas->layers = 1;
+	atlas->target = GL_TEXTURE_2D;
+	for (i = 0; i < count; i++)
+	{
+		BlitPadded(&images[i], data, width, x[i], y[i], padding);
+		atlas->rects[i].u0 = (GLfloat)(x[i] + padding) / width;
+		atlas->rects[i].v0 = (GLfloat)(y[i] + padding) / height;
+		atlas->rects[i].u1 = (GLfloat)(x[i] + padding + images[i].width) / width;
+		atlas->rects[i].v1 = (GLfloat)(y[i] + padding + images[i].height) / height;
+		atlas->rects[i].layer = 0;
+		atlas->rects[i].width = images[i].width;
+		atlas->rects[i].height = images[i].height;
+	}
+
+	glGenTextures(1, &atlas->texID);
+	stateBindTexture(GL_TEXTURE_2D, atlas->texID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	glGenerateMipmap(GL_TEXTURE_2D);
+
+	printf("TextureAtlas: %d images in %dx%d, %.1f%% used, built in %.1f ms\n",
+		count, width, height, 100.0 * used / ((long)width * height), (AtlasTime() - t0) * 1000.0);
+
+	free(data);
+	free(order); free(pw); free(ph); free(x); free(y);
+	FreeAtlasImages(images, count);
+	return atlas;
+}
+
+TextureAtlas *BuildTextureArray(char **filenames, int count)
+{
+	TextureData *images;
+	TextureAtlas *atlas;
+	GLubyte *data;
+	int i, x, y, width, height;
+	double t0 = AtlasTime();
+
+	if (count <= 0)
+		return NULL;
+	images = LoadAtlasImages(filenames, count);
+	if (images == NULL)
+		return NULL;
+
+	width = images[0].width;
+	height = images[0].height;
+	for (i = 1; i < count; i++)
+		if ((int)images[i].width != width || (int)images[i].height != height)
+		{
+			printf("TextureAtlas: %s is not %dx%d, can not be in an array texture\n", filenames[i], width, height);
+			FreeAtlasImages(images, count);
+			return NULL;
+		}
+
+	atlas = (TextureAtlas *)malloc(sizeof(TextureAtlas));
+	atlas->rects = (AtlasRect *)malloc(count * sizeof(AtlasRect));
+	atlas->count = count;
+	atlas->width = width;
+	atlas->height = height;
+	atlas->layers = count;
+	atlas->target = GL_TEXTURE_2D_ARRAY;
+
+	glGenTextures(1, &atlas->texID);
+	stateBindTexture(GL_TEXTURE_2D_ARRAY, atlas->texID);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, count, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	data = (GLubyte *)malloc(width * height * 4);
+	for (i = 0; i < count; i++)
+	{
+		for (y = 0; y < height; y++)
+			for (x = 0; x < width; x++)
+				GetRGBA(&images[i], x, y, &data[(y * width + x) * 4]);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+
+		atlas->rects[i].u0 = 0.0;
+		atlas->rects[i].v0 = 0.0;
+		atlas->rects[i].u1 = 1.0;
+		atlas->rects[i].v1 = 1.0;
+		atlas->rects[i].layer = i;
+		atlas->rects[i].width = width;
+		atlas->rects[i].height = height;
+	}
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+	printf("TextureAtlas: %d images in %dx%dx%d array, 100.0%% used, built in %.1f ms\n",
+		count, width, height, count, (AtlasTime() - t0) * 1000.0);
+
+	free(data);
+	FreeAtlasImages(images, count);
+	return atlas;
+}
+
+void DisposeTextureAtlas(TextureAtlas *atlas)
+{
+	if (atlas == NULL)
+		return;
+	glDeleteTextures(1, &atlas->texID);
+	stateForgetTexture(atlas->texID);
+	free(atlas->rects);
+	free(atlas);
+}
@@ -0,0 +1,39 @@
+#ifndef _TEXTURE_ATLAS_
+#define _TEXTURE_ATLAS_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "LoadTGA.h"
+
+// Where one image ended up
+typedef struct
+{
+	GLfloat u0, v0, u1, v1;		// Texture coordinates in the atlas
+	GLint layer;				// Layer in an array texture, 0 for an atlas
+	GLuint width, height;		// Image size in pixels
+} AtlasRect;
+
+typedef struct
+{
+	GLuint texID;
+	GLenum target;				// GL_TEXTURE_2D (atlas) or GL_TEXTURE_2D_ARRAY
+	GLuint width, height, layers;
+	int count;
+	AtlasRect *rects;			// One per image, in the order given
+} TextureAtlas;
+
+// Packs many images into one texture. padding is the number of edge pixels
+// replicated around each image, which keeps mipmaps from bleeding.
+TextureAtlas *BuildTextureAtlas(char **filenames, int count, int padding);
+// Stacks equal-sized images into layers of a GL_TEXTURE_2D_ARRAY.
+TextureAtlas *BuildTextureArray(char **filenames, int count);
+// Both return NULL if count is 0 or an image can not be used.
+void DisposeTextureAtlas(TextureAtlas *atlas);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,701 @@
+// TextureCompress, block compressed textures (BC1/BC3/BC4) with a CPU encoder.
+// Compressed textures use 4-8 times less VRAM and upload bandwidth than the
+// RGB/RGBA8 textures from LoadTGATexture.
+// The first time a TGA is loaded it is compressed, with a full mip chain from
+// BuildTGAMipChain (gamma correct Kaiser/Lanczos filtered, see LoadTGA.c), and
+// saved as filename.btc next to the TGA. Later runs upload the cached blocks
+// with glCompressedTexImage2D directly. The cache is rebuilt when the size or
+// modification time of the TGA changes.
+// 8 bit (grayscale) images become BC4, 24 bit images BC1 and 32 bit images BC3.
+// BC4 is core in OpenGL 3, BC1/BC3 need GL_EXT_texture_compression_s3tc.
+// Without it we fall back to LoadTGATexture.
+// The encoder fits endpoints along the principal axis of each block, then picks
+// the nearest palette entry per pixel (SSE2 when available). Blocks are split
+// over several threads.
+
+// 261019: First version.
+// 261019: Cache files with any other format than BC1/BC3/BC4 are rebuilt.
+// 261019: Loading no longer computes the PSNR, bench/compressbench reports it.
+
+#if !defined(_WIN32)
+	#define _XOPEN_SOURCE 700 // sysconf
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#if defined(_WIN32)
+	#include <time.h>
+#else
+	#include <sys/time.h>
+	#include <unistd.h>
+	#include <pthread.h>
+#endif
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+#include "TextureCompress.h"
+#include "GL_utilities.h"
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+	#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+	#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RED_RGTC1
+	#define GL_COMPRESSED_RED_RGTC1 0x8DBB
+#endif
+
+#define kMaxCompressThreads 16
+
+static double CompressTime(void)
+{
+#if defined(_WIN32)
+	return (double)clock() / CLOCKS_PER_SEC;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 0.000001;
+#endif
+}
+
+// --- Block encoders ---
+
+static unsigned short To565(float r, float g, float b)
+{
+	int ri, gi, bi;
+
+	ri = (int)(r * 31.0 / 255.0 + 0.5);
+	gi = (int)(g * 63.0 / 255.0 + 0.5);
+	bi = (int)(b * 31.0 / 255.0 + 0.5);
+	ri = ri < 0 ? 0 : (ri > 31 ? 31 : ri);
+	gi = gi < 0 ? 0 : (gi > 63 ? 63 : gi);
+	bi = bi < 0 ? 0 : (bi > 31 ? 31 : bi);
+	return (unsigned short)((ri << 11) | (gi << 5) | bi);
+}
+
+static void From565(unsigned short c, GLubyte *rgba)
+{
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+
+	rgba[0] = (GLubyte)((r << 3) | (r >> 2));
+	rgba[1] = (GLubyte)((g << 2) | (g >> 4));
+	rgba[2] = (GLubyte)((b << 3) | (b >> 2));
+	rgba[3] = 255;
+}
+
+// Finds the index of the nearest of the 4 palette colors for 16 pixels.
+static unsigned int NearestPaletteIndices(const GLubyte *block, GLubyte palette[4][4])
+{
+	unsigned int indices = 0;
+	int i;
+#if defined(__SSE2__)
+	__m128i zero = _mm_setzero_si128();
+	__m128i noAlpha = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+	__m128i pal[4];
+	int p, k;
+
+	for (p = 0; p < 4; p++)
+		pal[p] = _mm_set_epi16(0, palette[p][2], palette[p][1], palette[p][0],
+							0, palette[p][2], palette[p][1], palette[p][0]);
+	for (k = 0; k < 4; k++) // 4 pixels at a time
+	{
+		__m128i px = _mm_loadu_si128((const __m128i *)&block[k * 16]);
+		__m128i lo = _mm_unpacklo_epi8(px, zero);
+		__m128i hi = _mm_unpackhi_epi8(px, zero);
+		__m128i best = _mm_set1_epi32(0x7fffffff), bestIndex = zero;
+		int result[4];
+
+		for (p = 0; p < 4; p++)
+		{
+			__m128i dlo = _mm_and_si128(_mm_sub_epi16(lo, pal[p]), noAlpha);
+			__m128i dhi = _mm_and_si128(_mm_sub_epi16(hi, pal[p]), noAlpha);
+			__m128 slo = _mm_castsi128_ps(_mm_madd_epi16(dlo, dlo));
+			__m128 shi = _mm_castsi128_ps(_mm_madd_epi16(dhi, dhi));
+			__m128i dist = _mm_add_epi32(
+				_mm_castps_si128(_mm_shuffle_ps(slo, shi, _MM_SHUFFLE(2, 0, 2, 0))),
+				_mm_castps_si128(_mm_shuffle_ps(slo, shi, _MM_SHUFFLE(3, 1, 3, 1))));
+			__m128i closer = _mm_cmplt_epi32(dist, best);
+			best = _mm_or_si128(_mm_and_si128(closer, dist), _mm_andnot_si128(closer, best));
+			bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+		}
+		_mm_storeu_si128((__m128i *)result, bestIndex);
+		for (i = 0; i < 4; i++)
+			indices |= (unsigned int)result[i] << (2 * (k * 4 + i));
+	}
+#else
+	int p, d, dr, dg, db, best, bestIndex;
+
+	for (i = 0; i < 16; i++)
+	{
+		best = 0x7fffffff;
+		bestIndex = 0;
+		for (p = 0; p < 4; p++)
+		{
+			dr = block[i*4 + 0] - palette[p][0];
+			dg = block[i*4 + 1] - palette[p][1];
+			db = block[i*4 + 2] - palette[p][2];
+			d = dr*dr + dg*dg + db*db;
+			if (d < best)
+			{
+				best = d;
+				bestIndex = p;
+			}
+		}
+		indices |= (unsigned int)bestIndex << (2 * i);
+	}
+#endif
+	return indices;
+}
+
+// BC1 color block, always in 4 color mode. block is 16 RGBA pixels.
+static void EncodeColorBlock(const GLubyte *block, GLubyte *dest)
+{
+	float mean[3] = {0, 0, 0}, cov[6] = {0, 0, 0, 0, 0, 0};
+	float axis[3], v[3], d, minD, maxD, len;
+	unsigned short c0, c1;
+	unsigned int indices;
+	GLubyte palette[4][4];
+	int i, j, minI = 0, maxI = 0;
+
+	for (i = 0; i < 16; i++)
+		for (j = 0; j < 3; j++)
+			mean[j] += block[i*4 + j] / 16.0f;
+	for (i = 0; i < 16; i++)
+	{
+		for (j = 0; j < 3; j++)
+			v[j] = block[i*4 + j] - mean[j];
+		cov[0] += v[0]*v[0]; cov[1] += v[0]*v[1]; cov[2] += v[0]*v[2];
+		cov[3] += v[1]*v[1]; cov[4] += v[1]*v[2]; cov[5] += v[2]*v[2];
+	}
+	// Principal axis by power iteration
+	axis[0] = axis[1] = axis[2] = 1.0f;
+	for (j = 0; j < 8; j++)
+	{
+		v[0] = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+		v[1] = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+		v[2] = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+		len = (float)sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+		if (len < 0.0001f)
+			break;
+		axis[0] = v[0] / len; axis[1] = v[1] / len; axis[2] = v[2] / len;
+	}
+	// The extreme pixels along the axis are the endpoints
+	minD = maxD = block[0]*axis[0] + block[1]*axis[1] + block[2]*axis[2];
+	for (i = 1; i < 16; i++)
+	{
+		d = block[i*4]*axis[0] + block[i*4 + 1]*axis[1] + block[i*4 + 2]*axis[2];
+		if (d < minD) { minD = d; minI = i; }
+		if (d > maxD) { maxD = d; maxI = i; }
+	}
+	c0 = To565(block[maxI*4], block[maxI*4 + 1], block[maxI*4 + 2]);
+	c1 = To565(block[minI*4], block[minI*4 + 1], block[minI*4 + 2]);
+	if (c0 < c1)
+	{
+		unsigned short tmp = c0; c0 = c1; c1 = tmp;
+	}
+
+	if (c0 == c1)
+		indices = 0;
+	else
+	{
+		From565(c0, palette[0]);
+		From565(c1, palette[1]);
+		for (j = 0; j < 3; j++)
+		{
+			palette[2][j] = (GLubyte)((2*palette[0][j] + palette[1][j]) / 3);
+			palette[3][j] = (GLubyte)((palette[0][j] + 2*palette[1][j]) / 3);
+		}
+		indices = NearestPaletteIndices(block, palette);
+	}
+
+	dest[0] = c0 & 255; dest[1] = c0 >> 8;
+	dest[2] = c1 & 255; dest[3] = c1 >> 8;
+	dest[4] = indices & 255; dest[5] = (indices >> 8) & 255;
+	dest[6] = (indices >> 16) & 255; dest[7] = indices >> 24;
+}
+
+// BC4 block, one channel (component of 16 RGBA pixels), in 8 value mode.
+static void EncodeSingleChannelBlock(const GLubyte *block, int component, GLubyte *dest)
+{
+	int i, t, code, lo = 255, hi = 0;
+	unsigned long long bits = 0;
+
+	for (i = 0; i < 16; i++)
+	{
+		if (block[i*4 + component] < lo) lo = block[i*4 + component];
+		if (block[i*4 + component] > hi) hi = block[i*4 + component];
+	}
+	dest[0] = (GLubyte)hi;
+	dest[1] = (GLubyte)lo;
+	if (hi > lo)
+		for (i = 0; i < 16; i++)
+		{
+			// t = 0 is hi, t = 7 is lo
+			t = ((hi - block[i*4 + component]) * 14 + (hi - lo)) / (2 * (hi - lo));
+			if (t == 0) code = 0;
+			else if (t == 7) code = 1;
+			else code = t + 1;
+			bits |= (unsigned long long)code << (3 * i);
+		}
+	for (i = 0; i < 6; i++)
+		dest[2 + i] = (bits >> (8 * i)) & 255;
+}
+
+// Gets a 4x4 block of RGBA pixels, clamping at the edges
+static void GetBlock(const GLubyte *rgba, int width, int height, int bx, int by, GLubyte *block)
+{
+	int x, y, sx, sy;
+
+	for (y = 0; y < 4; y++)
+	{
+		sy = by*4 + y;
+		if (sy >= height) sy = height - 1;
+		for (x = 0; x < 4; x++)
+		{
+			sx = bx*4 + x;
+			if (sx >= width) sx = width - 1;
+			memcpy(&block[(y*4 + x) * 4], &rgba[(sy*width + sx) * 4], 4);
+		}
+	}
+}
+
+typedef struct
+{
+	CompressedTexture *ct;
+	const GLubyte *rgba;
+	int level, firstRow, lastRow;
+} CompressJob;
+
+static void *CompressRows(void *arg)
+{
+	CompressJob *job = (CompressJob *)arg;
+	CompressedTexture *ct = job->ct;
+	int w = ct->levelWidth[job->level], h = ct->levelHeight[job->level];
+	int bw = (w + 3) / 4, bx, by;
+	GLubyte block[64], *dest;
+
+	for (by = job->firstRow; by < job->lastRow; by++)
+		for (bx = 0; bx < bw; bx++)
+		{
+			GetBlock(job->rgba, w, h, bx, by, block);
+			dest = ct->data + ct->levelOffset[job->level] + (by*bw + bx) * ct->blockBytes;
+			if (ct->format == GL_COMPRESSED_RED_RGTC1)
+				EncodeSingleChannelBlock(block, 0, dest);
+			else if (ct->format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+			{
+				EncodeSingleChannelBlock(block, 3, dest);
+				EncodeColorBlock(block, dest + 8);
+			}
+			else
+				EncodeColorBlock(block, dest);
+		}
+	return NULL;
+}
+
+static int CompressThreadCount(void)
+{
+#if defined(_WIN32)
+	return 1;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1) return 1;
+	if (n > kMaxCompressThreads) return kMaxCompressThreads;
+	return (int)n;
+#endif
+}
+
+static void CompressLevel(CompressedTexture *ct, int level, const GLubyte *rgba)
+{
+	CompressJob jobs[kMaxCompressThreads];
+	int bh = (ct->levelHeight[level] + 3) / 4;
+	int threads = CompressThreadCount(), i;
+#if !defined(_WIN32)
+	pthread_t tid[kMaxCompressThreads];
+#endif
+
+	if (threads > bh)
+		threads = bh;
+	for (i = 0; i < threads; i++)
+	{
+		jobs[i].ct = ct;
+		jobs[i].rgba = rgba;
+		jobs[i].level = level;
+		jobs[i].firstRow = bh * i / threads;
+		jobs[i].lastRow = bh * (i+1) / threads;
+	}
+#if !defined(_WIN32)
+	for (i = 1; i < threads; i++)
+		if (pthread_create(&tid[i], NULL, CompressRows, &jobs[i]) != 0)
+			CompressRows(&jobs[i]), tid[i] = 0;
+	CompressRows(&jobs[0]);
+	for (i = 1; i < threads; i++)
+		if (tid[i] != 0)
+			pthread_join(tid[i], NULL);
+#else
+	for (i = 0; i < threads; i++)
+		CompressRows(&jobs[i]);
+#endif
+}
+
+// Converts an image with rowLength pixels per row to tightly packed RGBA
+static GLubyte *ImageToRGBA(GLubyte *imageData, int bpp, int width, int height, int rowLength)
+{
+	int bytesPerPixel = bpp / 8;
+	GLubyte *rgba = (GLubyte *)malloc(width * height * 4);
+	GLubyte *src, *dest;
+	int x, y;
+
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+		{
+			src = &imageData[(y * rowLength + x) * bytesPerPixel];
+			dest = &rgba[(y * width + x) * 4];
+			dest[0] = src[0];
+			dest[1] = bytesPerPixel >= 3 ? src[1] : 0;
+			dest[2] = bytesPerPixel >= 3 ? src[2] : 0;
+			dest[3] = bytesPerPixel == 4 ? src[3] : 255;
+		}
+	return rgba;
+}
+
+static CompressedTexture *NewCompressedTexture(GLenum format, int width, int height)
+{
+	CompressedTexture *ct;
+	long size = 0;
+	int w = width, h = height, i;
+
+	ct = (CompressedTexture *)calloc(1, sizeof(CompressedTexture));
+	ct->format = format;
+	ct->blockBytes = (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) ? 16 : 8;
+	ct->width = width;
+	ct->height = height;
+	for (i = 0; i < kMaxCompressedLevels; i++)
+	{
+		ct->levelWidth[i] = w;
+		ct->levelHeight[i] = h;
+		ct->levelOffset[i] = size;
+		ct->levelSize[i] = (long)((w + 3) / 4) * ((h + 3) / 4) * ct->blockBytes;
+		size += ct->levelSize[i];
+		ct->levels = i + 1;
+		if (w == 1 && h == 1)
+			break;
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+	ct->data = (GLubyte *)malloc(size);
+	return ct;
+}
+
+CompressedTexture *CompressTextureData(TextureData *texture)
+{
+	CompressedTexture *ct;
+	TGAMipChain chain;
+	GLenum format;
+	GLubyte *rgba;
+	int i;
+
+	if (texture->bpp == 8)
+		format = GL_COMPRESSED_RED_RGTC1;
+	else if (texture->bpp == 24)
+		format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	else
+		format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	ct = NewCompressedTexture(format, texture->width, texture->height);
+
+	// Both chains halve down to 1x1, so the levels match
+	BuildTGAMipChain(texture, &chain);
+	for (i = 0; i < ct->levels && i < chain.levels; i++)
+	{
+		rgba = ImageToRGBA(chain.data[i], texture->bpp, chain.width[i], chain.height[i], i == 0 ? texture->w : chain.width[i]);
+		CompressLevel(ct, i, rgba);
+		free(rgba);
+	}
+	DisposeTGAMipChain(&chain);
+	return ct;
+}
+
+// --- Decoding, for measuring quality ---
+
+static void DecodeSingleChannelBlock(const GLubyte *src, GLubyte *values)
+{
+	int r0 = src[0], r1 = src[1], i, code;
+	unsigned long long bits = 0;
+	int palette[8];
+
+	for (i = 0; i < 6; i++)
+		bits |= (unsigned long long)src[2 + i] << (8 * i);
+	palette[0] = r0;
+	palette[1] = r1;
+	for (i = 2; i < 8; i++)
+		if (r0 > r1)
+			palette[i] = ((8 - i) * r0 + (i - 1) * r1) / 7;
+		else if (i < 6)
+			palette[i] = ((6 - i) * r0 + (i - 1) * r1) / 5;
+		else
+			palette[i] = (i == 6) ? 0 : 255;
+	for (i = 0; i < 16; i++)
+	{
+		code = (bits >> (3 * i)) & 7;
+		values[i] = (GLubyte)palette[code];
+	}
+}
+
+static void DecodeColorBlock(const GLubyte *src, GLubyte *rgba, bool alwaysFourColors)
+{
+	unsigned short c0 = src[0] | (src[1] << 8), c1 = src[2] | (src[3] << 8);
+	unsigned int indices = src[4] | (src[5] << 8) | (src[6] << 16) | ((unsigned int)src[7] << 24);
+	GLubyte palette[4][4];
+	int i, j;
+
+	From565(c0, palette[0]);
+	From565(c1, palette[1]);
+	for (j = 0; j < 3; j++)
+		if (c0 > c1 || alwaysFourColors)
+		{
+			palette[2][j] = (GLubyte)((2*palette[0][j] + palette[1][j]) / 3);
+			palette[3][j] = (GLubyte)((palette[0][j] + 2*palette[1][j]) / 3);
+		}
+		else
+		{
+			palette[2][j] = (GLubyte)((palette[0][j] + palette[1][j]) / 2);
+			palette[3][j] = 0;
+		}
+	palette[2][3] = 255;
+	palette[3][3] = (c0 > c1 || alwaysFourColors) ? 255 : 0;
+	for (i = 0; i < 16; i++)
+		memcpy(&rgba[i*4], palette[(indices >> (2*i)) & 3], 4);
+}
+
+// Decodes one level to RGBA, levelWidth * levelHeight pixels
+void DecompressLevel(CompressedTexture *ct, int level, GLubyte *rgba)
+{
+	int w = ct->levelWidth[level], h = ct->levelHeight[level];
+	int bw = (w + 3) / 4, bh = (h + 3) / 4, bx, by, x, y, i;
+	GLubyte block[64], values[16], *src;
+
+	for (by = 0; by < bh; by++)
+		for (bx = 0; bx < bw; bx++)
+		{
+			src = ct->data + ct->levelOffset[level] + (by*bw + bx) * ct->blockBytes;
+			if (ct->format == GL_COMPRESSED_RED_RGTC1)
+			{
+				DecodeSingleChannelBlock(src, values);
+				for (i = 0; i < 16; i++)
+				{
+					block[i*4] = values[i];
+					block[i*4 + 1] = block[i*4 + 2] = 0;
+					block[i*4 + 3] = 255;
+				}
+			}
+			else if (ct->format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+			{
+				DecodeColorBlock(src + 8, block, true);
+				DecodeSingleChannelBlock(src, values);
+				for (i = 0; i < 16; i++)
+					block[i*4 + 3] = values[i];
+			}
+			else
+				DecodeColorBlock(src, block, false);
+			for (y = 0; y < 4 && by*4 + y < h; y++)
+				for (x = 0; x < 4 && bx*4 + x < w; x++)
+					memcpy(&rgba[((by*4 + y) * w + bx*4 + x) * 4], &block[(y*4 + x) * 4], 4);
+		}
+}
+
+// Peak signal to noise ratio of the top level, over the channels in the original
+double CompressedTexturePSNR(CompressedTexture *ct, TextureData *original)
+{
+	GLubyte *decoded, *rgba;
+	double sum = 0, d, mse;
+	long i, n = (long)ct->width * ct->height;
+	int c, channels = original->bpp == 8 ? 1 : original->bpp / 8;
+
+	decoded = (GLubyte *)malloc(n * 4);
+	DecompressLevel(ct, 0, decoded);
+	rgba = ImageToRGBA(original->imageData, original->bpp, original->width, original->height, original->w);
+	for (i = 0; i < n; i++)
+		for (c = 0; c < channels; c++)
+		{
+			d = (double)decoded[i*4 + c] - rgba[i*4 + c];
+			sum += d * d;
+		}
+	free(decoded);
+	free(rgba);
+	mse = sum / (n * channels);
+	if (mse == 0)
+		return 99.0;
+	return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+void DisposeCompressedTexture(CompressedTexture *ct)
+{
+	if (ct == NULL)
+		return;
+	free(ct->data);
+	free(ct);
+}
+
+// --- Cache files ---
+
+#define kCacheMagic 0x31435442 // "BTC1"
+
+typedef struct
+{
+	unsigned int magic;
+	unsigned int format, width, height, levels;
+	long long sourceSize, sourceTime;
+} CacheHeader;
+
+static bool WriteCache(char *cachename, CompressedTexture *ct, struct stat *st)
+{
+	CacheHeader header;
+	FILE *file;
+	long size = ct->levelOffset[ct->levels-1] + ct->levelSize[ct->levels-1];
+
+	file = fopen(cachename, "wb");
+	if (file == NULL)
+		return false;
+	memset(&header, 0, sizeof(header));
+	header.magic = kCacheMagic;
+	header.format = ct->format;
+	header.width = ct->width;
+	header.height = ct->height;
+	header.levels = ct->levels;
+	header.sourceSize = st->st_size;
+	header.sourceTime = st->st_mtime;
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(ct->data, 1, size, file);
+	fclose(file);
+	return true;
+}
+
+static CompressedTexture *ReadCache(char *cachename, struct stat *st)
+{
+	CacheHeader header;
+	CompressedTexture *ct;
+	FILE *file;
+	long size;
+
+	file = fopen(cachename, "rb");
+	if (file == NULL)
+		return NULL;
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+		header.magic != kCacheMagic ||
+		(header.format != GL_COMPRESSED_RGB_S3TC_DXT1_EXT && header.format != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT &&
+		header.format != GL_COMPRESSED_RED_RGTC1) ||
+		header.sourceSize != st->st_size || header.sourceTime != st->st_mtime ||
+		header.width == 0 || header.height == 0 || header.width > 65535 || header.height > 65535)
+	{
+		fclose(file);
+		return NULL;
+	}
+	ct = NewCompressedTexture(header.format, header.width, header.height);
+	size = ct->levelOffset[ct->levels-1] + ct->levelSize[ct->levels-1];
+	if ((unsigned int)ct->levels != header.levels || fread(ct->data, 1, size, file) != (size_t)size)
+	{
+		DisposeCompressedTexture(ct);
+		ct = NULL;
+	}
+	fclose(file);
+	return ct;
+}
+
+// --- Loading ---
+
+static bool HasS3TC(void)
+{
+	static int checked = -1;
+	GLint i, n = 0;
+
+	if (checked < 0)
+	{
+		checked = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+		for (i = 0; i < n; i++)
+			if (strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), "GL_EXT_texture_compression_s3tc") == 0)
+				checked = 1;
+	}
+	return checked == 1;
+}
+
+bool LoadTGATextureCompressed(char *filename, TextureData *texture)
+{
+	CompressedTexture *ct;
+	TextureData raw;
+	struct stat st;
+	char *cachename;
+	double t0;
+	int i;
+
+	if (stat(filename, &st) != 0)
+	{
+		printf("could not open file %s\n", filename);
+		return false;
+	}
+	cachename = (char *)malloc(strlen(filename) + 5);
+	sprintf(cachename, "%s.btc", filename);
+
+	ct = ReadCache(cachename, &st);
+	if (ct == NULL)
+	{
+		memset(&raw, 0, sizeof(raw));
+		if (!LoadTGATextureData(filename, &raw))
+		{
+			free(cachename);
+			return false;
+		}
+		t0 = CompressTime();
+		ct = CompressTextureData(&raw);
+		t0 = CompressTime() - t0;
+		printf("TextureCompress: %s %dx%d to %s, %d levels, %.1f Mpixel/s\n",
+			filename, ct->width, ct->height,
+			ct->format == GL_COMPRESSED_RED_RGTC1 ? "BC4" : (ct->format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? "BC1" : "BC3"),
+			ct->levels, ct->width * ct->height * 4.0 / 3.0 / t0 / 1000000.0);
+		if (!WriteCache(cachename, ct, &st))
+			printf("TextureCompress: could not write %s\n", cachename);
+		free(raw.imageData);
+	}
+	free(cachename);
+
+	if (ct->format != GL_COMPRESSED_RED_RGTC1 && !HasS3TC())
+	{
+		DisposeCompressedTexture(ct);
+		return LoadTGATexture(filename, texture);
+	}
+
+	texture->imageData = NULL;
+	texture->bpp = ct->format == GL_COMPRESSED_RED_RGTC1 ? 8 : (ct->format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 24 : 32);
+	texture->width = texture->w = ct->width;
+	texture->height = texture->h = ct->height;
+	texture->texWidth = texture->texHeight = 1.0;
+
+	glGenTextures(1, &texture->texID);
+	stateBindTexture(GL_TEXTURE_2D, texture->texID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ct->levels - 1);
+	for (i = 0; i < ct->levels; i++)
+		glCompressedTexImage2D(GL_TEXTURE_2D, i, ct->format, ct->levelWidth[i], ct->levelHeight[i], 0,
+			ct->levelSize[i], ct->data + ct->levelOffset[i]);
+
+	DisposeCompressedTexture(ct);
+	return true;
+}
+
+void LoadTGATextureCompressedSimple(char *filename, GLuint *tex)
+{
+	TextureData texture;
+	memset(&texture, 0, sizeof(texture));
+
+	if (LoadTGATextureCompressed(filename, &texture))
+	{
+		if (texture.imageData != NULL)
+			free(texture.imageData);
+		*tex = texture.texID;
+	}
+	else
+		*tex = 0;
+}
@@ -0,0 +1,40 @@
+#ifndef _TEXTURE_COMPRESS_
+#define _TEXTURE_COMPRESS_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "LoadTGA.h"
+
+#define kMaxCompressedLevels 16
+
+// A block compressed image with all its mip levels
+typedef struct
+{
+	GLenum format;					// GL_COMPRESSED_RGB_S3TC_DXT1_EXT (BC1), ..._DXT5_EXT (BC3) or GL_COMPRESSED_RED_RGTC1 (BC4)
+	int blockBytes;					// 8 for BC1 and BC4, 16 for BC3
+	int width, height, levels;
+	int levelWidth[kMaxCompressedLevels], levelHeight[kMaxCompressedLevels];
+	long levelOffset[kMaxCompressedLevels], levelSize[kMaxCompressedLevels];
+	GLubyte *data;					// All levels after each other
+} CompressedTexture;
+
+// Loads a TGA as a compressed texture. The compressed data is cached in
+// filename.btc and only rebuilt when the TGA changes. Falls back to
+// LoadTGATexture if the GL does not support the format.
+bool LoadTGATextureCompressed(char *filename, TextureData *texture);
+void LoadTGATextureCompressedSimple(char *filename, GLuint *tex);
+
+// CPU side, no GL needed. 8 bit images become BC4, 24 bit BC1 and 32 bit BC3.
+CompressedTexture *CompressTextureData(TextureData *texture);
+void DecompressLevel(CompressedTexture *ct, int level, GLubyte *rgba);
+// Decodes every pixel of the top level, so not for load time
+double CompressedTexturePSNR(CompressedTexture *ct, TextureData *original);
+void DisposeCompressedTexture(CompressedTexture *ct);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,276 @@
+// TextureManager, a process-wide texture cache on top of LoadTGA.
+// Each file is decoded and uploaded once, no matter how many objects use it.
+// Textures are found by canonical path first, then by a hash of the file
+// contents, so copies of the same image under different names are shared too.
+// Textures are reference counted. When the reference count drops to zero
+// the texture stays resident, so it can be reused cheaply, until the VRAM
+// budget is exceeded. Then the least recently used unreferenced textures
+// are deleted.
+
+// 261019: First version.
+
+#if !defined(_WIN32)
+	#define _XOPEN_SOURCE 700 // realpath
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "TextureManager.h"
+#include "GL_utilities.h"
+
+typedef struct TMEntry
+{
+	TextureData tex;
+	unsigned long long hash;	// FNV-1a of the file contents
+	long fileSize;
+	long bytes;					// Estimated VRAM, including mipmaps
+	int refCount;
+	unsigned long lastUse;
+	struct TMEntry *next;
+} TMEntry;
+
+// Maps a canonical path to an entry. Several paths may share an entry.
+typedef struct TMPath
+{
+	char *path;
+	TMEntry *entry;
+	struct TMPath *next;
+} TMPath;
+
+static TMEntry *gEntries = NULL;
+static TMPath *gPaths = NULL;
+static unsigned long gClock = 0;
+static long gBudget = 256*1024*1024;
+static long gResident = 0;
+
+static long gLoads = 0, gPathHits = 0, gHashHits = 0, gEvictions = 0;
+
+static char *CanonicalPath(const char *filename)
+{
+	char *buf = (char *)malloc(4096);
+#if defined(_WIN32)
+	if (_fullpath(buf, filename, 4096) == NULL)
+#else
+	if (realpath(filename, buf) == NULL)
+#endif
+	{
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+static bool HashFile(const char *filename, unsigned long long *hash, long *size)
+{
+	FILE *file;
+	unsigned char buf[16384];
+	size_t n, i;
+	unsigned long long h = 14695981039346656037ULL;
+
+	file = fopen(filename, "rb");
+	if (file == NULL)
+		return false;
+	*size = 0;
+	while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+	{
+		for (i = 0; i < n; i++)
+		{
+			h ^= buf[i];
+			h *= 1099511628211ULL;
+		}
+		*size += n;
+	}
+	fclose(file);
+	*hash = h;
+	return true;
+}
+
+static void AddPath(char *path, TMEntry *e)
+{
+	TMPath *p = (TMPath *)malloc(sizeof(TMPath));
+	p->path = path;
+	p->entry = e;
+	p->next = gPaths;
+	gPaths = p;
+}
+
+static void DeleteEntry(TMEntry *e)
+{
+	TMEntry **ep;
+	TMPath **pp, *p;
+
+	for (pp = &gPaths; *pp != NULL;)
+	{
+		p = *pp;
+		if (p->entry == e)
+		{
+			*pp = p->next;
+			free(p->path);
+			free(p);
+		}
+		else
+			pp = &p->next;
+	}
+	for (ep = &gEntries; *ep != NULL; ep = &(*ep)->next)
+		if (*ep == e)
+		{
+			*ep = e->next;
+			break;
+		}
+
+	glDeleteTextures(1, &e->tex.texID);
+	stateForgetTexture(e->tex.texID);
+	gResident -= e->bytes;
+	free(e);
+}
+
+// Evicts unreferenced textures, oldest first, until we are below the budget.
+static void EnforceBudget(void)
+{
+	TMEntry *e, *oldest;
+
+	while (gResident > gBudget)
+	{
+		oldest = NULL;
+		for (e = gEntries; e != NULL; e = e->next)
+			if (e->refCount == 0 && (oldest == NULL || e->lastUse < oldest->lastUse))
+				oldest = e;
+		if (oldest == NULL)
+			return; // Everything is in use
+		DeleteEntry(oldest);
+		gEvictions++;
+	}
+}
+
+TextureData *TMAcquireTexture(const char *filename)
+{
+	TMPath *p;
+	TMEntry *e;
+	char *path;
+	unsigned long long hash;
+	long size;
+
+	path = CanonicalPath(filename);
+	if (path == NULL)
+	{
+		printf("could not open file %s\n", filename);
+		return NULL;
+	}
+
+	for (p = gPaths; p != NULL; p = p->next)
+		if (strcmp(p->path, path) == 0)
+		{
+			free(path);
+			p->entry->refCount++;
+			p->entry->lastUse = ++gClock;
+			gPathHits++;
+			return &p->entry->tex;
+		}
+
+	if (!HashFile(path, &hash, &size))
+	{
+		printf("could not read file %s\n", filename);
+		free(path);
+		return NULL;
+	}
+	for (e = gEntries; e != NULL; e = e->next)
+		if (e->hash == hash && e->fileSize == size)
+		{
+			AddPath(path, e);
+			e->refCount++;
+			e->lastUse = ++gClock;
+			gHashHits++;
+			return &e->tex;
+		}
+
+	e = (TMEntry *)malloc(sizeof(TMEntry));
+	memset(e, 0, sizeof(TMEntry));
+	if (!LoadTGATexture(path, &e->tex))
+	{
+		free(e);
+		free(path);
+		return NULL;
+	}
+	// Only the texture object is kept
+	free(e->tex.imageData);
+	e->tex.imageData = NULL;
+
+	e->hash = hash;
+	e->fileSize = size;
+	e->bytes = (long)e->tex.w * e->tex.h * (e->tex.bpp/8) * 4 / 3;
+	e->refCount = 1;
+	e->lastUse = ++gClock;
+	e->next = gEntries;
+	gEntries = e;
+	AddPath(path, e);
+	gResident += e->bytes;
+	gLoads++;
+
+	EnforceBudget();
+	return &e->tex;
+}
+
+void TMAcquireTextureSimple(const char *filename, GLuint *tex)
+{
+	TextureData *t = TMAcquireTexture(filename);
+
+	if (t != NULL)
+		*tex = t->texID;
+	else
+		*tex = 0;
+}
+
+void TMReleaseTexture(GLuint tex)
+{
+	TMEntry *e;
+
+	for (e = gEntries; e != NULL; e = e->next)
+		if (e->tex.texID == tex)
+		{
+			if (e->refCount > 0)
+				e->refCount--;
+			return;
+		}
+}
+
+void TMSetBudget(long bytes)
+{
+	gBudget = bytes;
+	EnforceBudget();
+}
+
+// Deletes all textures that nobody references. Returns the number of bytes freed.
+long TMEvictUnused(void)
+{
+	TMEntry *e, *next;
+	long freed = 0;
+
+	for (e = gEntries; e != NULL; e = next)
+	{
+		next = e->next;
+		if (e->refCount == 0)
+		{
+			freed += e->bytes;
+			DeleteEntry(e);
+			gEvictions++;
+		}
+	}
+	return freed;
+}
+
+void TMPrintStats(void)
+{
+	TMEntry *e;
+	int count = 0, unused = 0;
+
+	for (e = gEntries; e != NULL; e = e->next)
+	{
+		count++;
+		if (e->refCount == 0) unused++;
+	}
+	printf("TextureManager: %d textures (%d unused), %ld of %ld bytes, %ld loads, %ld path hits, %ld content hits, %ld evictions\n",
+		count, unused, gResident, gBudget, gLoads, gPathHits, gHashHits, gEvictions);
+}
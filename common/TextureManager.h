@@ -0,0 +1,26 @@
+#ifndef _TEXTURE_MANAGER_
+#define _TEXTURE_MANAGER_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "LoadTGA.h"
+
+// Shared textures. The same file (by canonical path or by content) is only
+// loaded once, and the texture object is reference counted.
+TextureData *TMAcquireTexture(const char *filename);
+void TMAcquireTextureSimple(const char *filename, GLuint *tex);
+void TMReleaseTexture(GLuint tex);
+
+// Unreferenced textures stay resident until the budget is exceeded,
+// then the least recently used are deleted first.
+void TMSetBudget(long bytes);
+long TMEvictUnused(void);
+void TMPrintStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
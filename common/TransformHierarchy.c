@@ -0,0 +1,112 @@
+// TransformHierarchy, parent/child transforms with cached world matrices.
+// Nodes live in flat arrays with parents before children, so the world
+// matrices are updated in one pass in index order, no recursion.
+// Setting a local transform only marks the node dirty. THUpdate starts at
+// the lowest dirty node and recomputes a node when its own local is dirty
+// or its parent's world changed in the same pass, so unchanged subtrees
+// cost one flag test per node and no matrix products.
+
+// 261019: First version.
+// 261019: THSetLocal takes a pointer, so a call does not copy 64 bytes.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "TransformHierarchy.h"
+
+TransformHierarchy *THCreate(int capacity)
+{
+	TransformHierarchy *h;
+
+	if (capacity < 16)
+		capacity = 16;
+	h = (TransformHierarchy *)malloc(sizeof(TransformHierarchy));
+	h->count = 0;
+	h->capacity = capacity;
+	h->parent = (int *)malloc(capacity * sizeof(int));
+	h->local = (mat4 *)malloc(capacity * sizeof(mat4));
+	h->world = (mat4 *)malloc(capacity * sizeof(mat4));
+	h->flags = (unsigned char *)malloc(capacity);
+	h->firstDirty = 0;
+	h->firstChanged = 0;
+	return h;
+}
+
+void THDispose(TransformHierarchy *h)
+{
+	if (h == NULL)
+		return;
+	free(h->parent);
+	free(h->local);
+	free(h->world);
+	free(h->flags);
+	free(h);
+}
+
+int THAddNode(TransformHierarchy *h, int parent, mat4 local)
+{
+	int node = h->count;
+
+	if (parent >= node)
+		return -1;
+	if (node == h->capacity)
+	{
+		h->capacity *= 2;
+		h->parent = (int *)realloc(h->parent, h->capacity * sizeof(int));
+		h->local = (mat4 *)realloc(h->local, h->capacity * sizeof(mat4));
+		h->world = (mat4 *)realloc(h->world, h->capacity * sizeof(mat4));
+		h->flags = (unsigned char *)realloc(h->flags, h->capacity);
+	}
+	h->parent[node] = parent < 0 ? -1 : parent;
+	h->local[node] = local;
+	h->flags[node] = kTHLocalDirty; // firstDirty is at most count already
+	h->count++;
+	return node;
+}
+
+void THSetLocal(TransformHierarchy *h, int node, const mat4 *local)
+{
+	if (memcmp(&h->local[node], local, sizeof(mat4)) == 0)
+		return;
+	h->local[node] = *local;
+	h->flags[node] |= kTHLocalDirty;
+	if (node < h->firstDirty)
+		h->firstDirty = node;
+}
+
+void THSetLocalTRS(TransformHierarchy *h, int node, trs local)
+{
+	mat4 m = TRSToMat4(local);
+
+	THSetLocal(h, node, &m);
+}
+
+int THUpdate(TransformHierarchy *h)
+{
+	int i, p, n = 0;
+	int first = h->firstDirty;
+
+	// Flags from the last update that this pass will not overwrite
+	for (i = h->firstChanged; i < first; i++)
+		h->flags[i] = 0;
+
+	for (i = first; i < h->count; i++)
+	{
+		p = h->parent[i];
+		if ((h->flags[i] & kTHLocalDirty) || (p >= 0 && (h->flags[p] & kTHWorldChanged)))
+		{
+			if (p < 0)
+				h->world[i] = h->local[i];
+			else
+				h->world[i] = Mult(h->world[p], h->local[i]);
+			h->flags[i] = kTHWorldChanged;
+			n++;
+		}
+		else
+			h->flags[i] = 0;
+	}
+
+	h->firstChanged = first;
+	h->firstDirty = h->count;
+	return n;
+}
@@ -0,0 +1,43 @@
+#ifndef _TRANSFORM_HIERARCHY_
+#define _TRANSFORM_HIERARCHY_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "VectorUtils3.h"
+
+// A tree of transforms in flat arrays. A parent always has a lower index
+// than its children, so one pass in index order updates the whole tree.
+typedef struct TransformHierarchy
+{
+	int count, capacity;
+	int *parent;				// -1 for roots
+	mat4 *local;				// Relative to the parent
+	mat4 *world;				// Parent world * local, valid after THUpdate
+	unsigned char *flags;		// kTHLocalDirty, kTHWorldChanged
+	int firstDirty;				// Lowest node with a dirty local, count if none
+	int firstChanged;			// Lowest node changed by the last THUpdate
+} TransformHierarchy;
+
+#define kTHLocalDirty 1
+#define kTHWorldChanged 2
+
+TransformHierarchy *THCreate(int capacity);
+void THDispose(TransformHierarchy *h);
+// parent must be -1 or an existing node. Returns the new node.
+int THAddNode(TransformHierarchy *h, int parent, mat4 local);
+// Only marks the node dirty if the matrix actually differs.
+void THSetLocal(TransformHierarchy *h, int node, const mat4 *local);
+void THSetLocalTRS(TransformHierarchy *h, int node, trs local);
+// Recomputes the world matrices of dirty nodes and their descendants.
+// Returns the number of nodes recomputed.
+int THUpdate(TransformHierarchy *h);
+// True if the world matrix changed in the last THUpdate.
+#define THWorldChanged(h, node) (((h)->flags[node] & kTHWorldChanged) != 0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -65,12 +65,30 @@
 // 160302: Added empty constuctors for vec3 and vec4.
 // 170221: Uses _WIN32 instead of WIN32
 // 170331: Added stdio.h for printMat4 and printVec3
+// 261019: Mult and MultVec4 use SSE or NEON when available, InvertMat4 uses SSE.
+// The layout can be fixed at compile time with VECTORUTILS3_ROW_MAJOR or
+// VECTORUTILS3_COLUMN_MAJOR, which removes the run-time test of "transposed".
+// 261019: lookAt and ortho were row-wise also when transposed.
+// 261019: Batch calls for arrays of vectors: MultVec3Array, NormalizeArray,
+// TransformPointsAndNormals and SkinVec3Array, for vec3 arrays or separate x, y, z.
+// 261019: Added quat and dualquat, with slerp, integration and dual quaternion skinning.
+// 261019: The basic vec3 calls and MultVec3 moved to the header, and are static
+// inline there if VECTORUTILS3_INLINE is defined.
+// 261019: Added the affine mat4x3 and the trs (translation, rotation, scale) types.
+// 261019: Added ExtractFrustumPlanes and batch culling of spheres and boxes.
+// 261019: UploadMat4x3 and UploadNormalMatrix moved to GL_utilities, no GL calls here.
+// 261019: MultMat4x3Vec3 uses SIMD. MultTRS, InvertTRS and MultTRSVec3 removed,
+// convert with TRSToMat4x3 instead.
+// 261019: MultVec4 uses SIMD only for column-wise matrices.
 
 // You may use VectorUtils as you please. A reference to the origin is appreciated
 // but if you grab some snippets from it without reference... no problem.
 
 
+#define VECTORUTILS3_SOURCE
 #include "VectorUtils3.h"
+#include <stdlib.h>
+#include <string.h>
 
 // VS doesn't define NAN properly
 #ifdef _WIN32
@@ -80,7 +98,99 @@
     #endif
 #endif
 
-char transposed = 0;
+// Matrix layout, see VECTORUTILS3_TRANSPOSED in the header. With the layout
+// fixed at compile time, the tests of it are constant and the compiler
+// removes the unused branches. SetTransposed can then not change the
+// layout, only complain.
+#define TRANSPOSED VECTORUTILS3_TRANSPOSED
+#if defined(VECTORUTILS3_COLUMN_MAJOR)
+	char transposed = 1;
+#else
+	char transposed = 0;
+#endif
+
+// Minimal 4-wide float vector layer, so the same code can use SSE, NEON
+// or plain C. Only what the matrix code needs.
+// V4MulAdd is a multiply and an add, never fused, so that the results are
+// bit for bit the same as the scalar code.
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#include <xmmintrin.h>
+	#define VU_SIMD 1
+	#define VU_SSE 1
+	typedef __m128 v4f;
+	#define V4Load(p) _mm_loadu_ps(p)
+	#define V4Store(p, a) _mm_storeu_ps(p, a)
+	#define V4Set(x, y, z, w) _mm_setr_ps(x, y, z, w)
+	#define V4Splat(s) _mm_set1_ps(s)
+	#define V4Add(a, b) _mm_add_ps(a, b)
+	#define V4Sub(a, b) _mm_sub_ps(a, b)
+	#define V4Mul(a, b) _mm_mul_ps(a, b)
+	#define V4MulAdd(acc, a, b) _mm_add_ps(acc, _mm_mul_ps(a, b))
+	#define V4Div(a, b) _mm_div_ps(a, b)
+	#define V4Sqrt(a) _mm_sqrt_ps(a)
+	#define V4LessMask(a, b) _mm_movemask_ps(_mm_cmplt_ps(a, b)) // Bit i set if a[i] < b[i]
+	#define V4Transpose(r0, r1, r2, r3) _MM_TRANSPOSE4_PS(r0, r1, r2, r3)
+	// Four vec3 in a row <-> one register each for x, y and z
+	#define V4Shuffle(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+	static inline void V4LoadXYZ(const GLfloat *p, v4f *x, v4f *y, v4f *z)
+	{
+		v4f a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4), c = _mm_loadu_ps(p + 8);
+		*x = V4Shuffle(a, V4Shuffle(b, c, 2,2,1,1), 0,3,0,2);
+		*y = V4Shuffle(V4Shuffle(a, b, 1,1,0,0), V4Shuffle(b, c, 3,3,2,2), 0,2,0,2);
+		*z = V4Shuffle(V4Shuffle(a, b, 2,2,1,1), V4Shuffle(c, c, 0,0,3,3), 0,2,0,2);
+	}
+	static inline void V4StoreXYZ(GLfloat *p, v4f x, v4f y, v4f z)
+	{
+		v4f lo = _mm_unpacklo_ps(x, y), hi = _mm_unpackhi_ps(x, y);
+		_mm_storeu_ps(p, V4Shuffle(lo, V4Shuffle(z, lo, 0,0,2,2), 0,1,0,2));
+		_mm_storeu_ps(p + 4, V4Shuffle(V4Shuffle(lo, z, 3,3,1,1), hi, 0,2,0,1));
+		_mm_storeu_ps(p + 8, V4Shuffle(V4Shuffle(z, hi, 2,2,2,2), V4Shuffle(hi, z, 3,3,3,3), 0,2,0,2));
+	}
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+	#include <arm_neon.h>
+	#define VU_SIMD 1
+	typedef float32x4_t v4f;
+	#define V4Load(p) vld1q_f32(p)
+	#define V4Store(p, a) vst1q_f32(p, a)
+	static inline v4f V4Set(float x, float y, float z, float w)
+	{
+		float f[4] = {x, y, z, w};
+		return vld1q_f32(f);
+	}
+	#define V4Splat(s) vdupq_n_f32(s)
+	#define V4Add(a, b) vaddq_f32(a, b)
+	#define V4Sub(a, b) vsubq_f32(a, b)
+	#define V4Mul(a, b) vmulq_f32(a, b)
+	#define V4MulAdd(acc, a, b) vaddq_f32(acc, vmulq_f32(a, b))
+	#define V4Div(a, b) vdivq_f32(a, b)
+	#define V4Sqrt(a) vsqrtq_f32(a)
+	static inline int V4LessMask(v4f a, v4f b)
+	{
+		static const uint32_t bits[4] = {1, 2, 4, 8};
+		return (int)vaddvq_u32(vandq_u32(vcltq_f32(a, b), vld1q_u32(bits)));
+	}
+	static inline void V4LoadXYZ(const GLfloat *p, v4f *x, v4f *y, v4f *z)
+	{
+		float32x4x3_t v = vld3q_f32(p);
+		*x = v.val[0]; *y = v.val[1]; *z = v.val[2];
+	}
+	static inline void V4StoreXYZ(GLfloat *p, v4f x, v4f y, v4f z)
+	{
+		float32x4x3_t v;
+		v.val[0] = x; v.val[1] = y; v.val[2] = z;
+		vst3q_f32(p, v);
+	}
+	#define V4Transpose(r0, r1, r2, r3) \
+	{ \
+		float32x4x2_t t01 = vtrnq_f32(r0, r1), t23 = vtrnq_f32(r2, r3); \
+		r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])); \
+		r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])); \
+		r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])); \
+		r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])); \
+	}
+#else
+	#define VU_SIMD 0
+#endif
 
 // Should be obsolete // Will probably be removed
 //	void CopyVector(vec3 *v, vec3 *dest)
@@ -90,17 +200,6 @@ char transposed = 0;
 //		dest->z = v->z;
 //	}
 
-// Obsolete?
-	vec3 SetVector(GLfloat x, GLfloat y, GLfloat z)
-	{
-		vec3 v;
-		
-		v.x = x;
-		v.y = y;
-		v.z = z;
-		return v;
-	}
-
 // Modern C doesn't need this, but Visual STudio insists on old-fashioned C and needs this.
 	mat3 SetMat3(GLfloat p0, GLfloat p1, GLfloat p2, GLfloat p3, GLfloat p4, GLfloat p5, GLfloat p6, GLfloat p7, GLfloat p8)
 	{
@@ -149,72 +248,10 @@ char transposed = 0;
 	// vec4 operations can easily be added but I havn't seen much need for them.
 	// Some are defined as C++ operators though.
 
-	vec3 VectorSub(vec3 a, vec3 b)
-	{
-		vec3 result;
-		
-		result.x = a.x - b.x;
-		result.y = a.y - b.y;
-		result.z = a.z - b.z;
-		return result;
-	}
-	
-	vec3 VectorAdd(vec3 a, vec3 b)
-	{
-		vec3 result;
-		
-		result.x = a.x + b.x;
-		result.y = a.y + b.y;
-		result.z = a.z + b.z;
-		return result;
-	}
-
-	vec3 CrossProduct(vec3 a, vec3 b)
-	{
-		vec3 result;
-
-		result.x = a.y*b.z - a.z*b.y;
-		result.y = a.z*b.x - a.x*b.z;
-		result.z = a.x*b.y - a.y*b.x;
-		
-		return result;
-	}
-
-	GLfloat DotProduct(vec3 a, vec3 b)
-	{
-		return a.x * b.x + a.y * b.y + a.z * b.z;
-	}
-
-	vec3 ScalarMult(vec3 a, GLfloat s)
-	{
-		vec3 result;
-		
-		result.x = a.x * s;
-		result.y = a.y * s;
-		result.z = a.z * s;
-		
-		return result;
-	}
-
-	GLfloat Norm(vec3 a)
-	{
-		GLfloat result;
-
-		result = (GLfloat)sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
-		return result;
-	}
-
-	vec3 Normalize(vec3 a)
-	{
-		GLfloat norm;
-		vec3 result;
-
-		norm = (GLfloat)sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
-		result.x = a.x / norm;
-		result.y = a.y / norm;
-		result.z = a.z / norm;
-		return result;
-	}
+	// SetVector, VectorSub, VectorAdd, CrossProduct, DotProduct, ScalarMult,
+	// Norm, Normalize, MultVec3 and MultMat3Vec3 are in VectorUtils3.h, so
+	// that they can be inlined (VECTORUTILS3_INLINE). They are compiled here
+	// as well, as normal functions.
 
 	vec3 CalcNormalVector(vec3 a, vec3 b, vec3 c)
 	{
@@ -266,7 +303,7 @@ char transposed = 0;
 		mat4 m;
 		m = IdentityMatrix();
 		m.m[5] = (GLfloat)cos(a);
-		if (transposed)
+		if (TRANSPOSED)
 			m.m[9] = (GLfloat)-sin(a);
 		else
 			m.m[9] = (GLfloat)sin(a);
@@ -280,7 +317,7 @@ char transposed = 0;
 		mat4 m;
 		m = IdentityMatrix();
 		m.m[0] = (GLfloat)cos(a);
-		if (transposed)
+		if (TRANSPOSED)
 			m.m[8] = (GLfloat)sin(a); // Was flipped
 		else
 			m.m[8] = (GLfloat)-sin(a);
@@ -294,7 +331,7 @@ char transposed = 0;
 		mat4 m;
 		m = IdentityMatrix();
 		m.m[0] = (GLfloat)cos(a);
-		if (transposed)
+		if (TRANSPOSED)
 			m.m[4] = (GLfloat)-sin(a);
 		else
 			m.m[4] = (GLfloat)sin(a);
@@ -307,7 +344,7 @@ char transposed = 0;
 	{
 		mat4 m;
 		m = IdentityMatrix();
-		if (transposed)
+		if (TRANSPOSED)
 		{
 			m.m[12] = tx;
 			m.m[13] = ty;
@@ -332,24 +369,66 @@ char transposed = 0;
 		return m;
 	}
 
+#if VU_SIMD
+	// Each row of the result is the rows of b weighted by one row of a.
+	// Column-wise matrices are the same thing with a and b swapped.
+	static void MultRows(const GLfloat *a, const GLfloat *b, GLfloat *m)
+	{
+		v4f b0 = V4Load(&b[0]), b1 = V4Load(&b[4]), b2 = V4Load(&b[8]), b3 = V4Load(&b[12]);
+		v4f r;
+		int y;
+
+		for (y = 0; y <= 3; y++)
+		{
+			r = V4Mul(V4Splat(a[y*4+0]), b0);
+			r = V4MulAdd(r, V4Splat(a[y*4+1]), b1);
+			r = V4MulAdd(r, V4Splat(a[y*4+2]), b2);
+			r = V4MulAdd(r, V4Splat(a[y*4+3]), b3);
+			V4Store(&m[y*4], r);
+		}
+	}
+
+	// Column-wise a * b with the four sums in the same order as the scalar
+	// code. Row-wise matrices stay scalar: transposing the products cost
+	// what the SIMD multiply saved.
+	static v4f MultVec4Columns(const GLfloat *a, vec4 b)
+	{
+		v4f c0 = V4Load(&a[0]), c1 = V4Load(&a[4]), c2 = V4Load(&a[8]), c3 = V4Load(&a[12]);
+
+		return V4MulAdd(V4MulAdd(V4MulAdd(V4Mul(c0, V4Splat(b.x)), c1, V4Splat(b.y)),
+				c2, V4Splat(b.z)), c3, V4Splat(b.w));
+	}
+#endif
+
 	mat4 Mult(mat4 a, mat4 b) // m = a * b
 	{
 		mat4 m;
-
+#if VU_SIMD
+		if (TRANSPOSED)
+			MultRows(b.m, a.m, m.m);
+		else
+			MultRows(a.m, b.m, m.m);
+#else
 		int x, y;
-		for (x = 0; x <= 3; x++)
-			for (y = 0; y <= 3; y++)
-				if (transposed)
+		if (TRANSPOSED)
+		{
+			for (x = 0; x <= 3; x++)
+				for (y = 0; y <= 3; y++)
 					m.m[x*4 + y] =	a.m[y+4*0] * b.m[0+4*x] +
 								a.m[y+4*1] * b.m[1+4*x] +
 								a.m[y+4*2] * b.m[2+4*x] +
 								a.m[y+4*3] * b.m[3+4*x];
-				else
+		}
+		else
+		{
+			for (x = 0; x <= 3; x++)
+				for (y = 0; y <= 3; y++)
 					m.m[y*4 + x] =	a.m[y*4+0] * b.m[0*4+x] +
 								a.m[y*4+1] * b.m[1*4+x] +
 								a.m[y*4+2] * b.m[2*4+x] +
 								a.m[y*4+3] * b.m[3*4+x];
-
+		}
+#endif
 		return m;
 	}
 
@@ -361,7 +440,7 @@ char transposed = 0;
 		int x, y;
 		for (x = 0; x <= 2; x++)
 			for (y = 0; y <= 2; y++)
-				if (transposed)
+				if (TRANSPOSED)
 					m.m[x*3 + y] =	a.m[y+3*0] * b.m[0+3*x] +
 								a.m[y+3*1] * b.m[1+3*x] +
 								a.m[y+3*2] * b.m[2+3*x];
@@ -373,55 +452,24 @@ char transposed = 0;
 		return m;
 	}
 
-	// mat4 * vec3
-	// The missing homogenous coordinate is implicitly set to 1.
-	vec3 MultVec3(mat4 a, vec3 b) // result = a * b
-	{
-		vec3 r;
-
-		if (!transposed)
-		{
-			r.x = a.m[0]*b.x + a.m[1]*b.y + a.m[2]*b.z + a.m[3];
-			r.y = a.m[4]*b.x + a.m[5]*b.y + a.m[6]*b.z + a.m[7];
-			r.z = a.m[8]*b.x + a.m[9]*b.y + a.m[10]*b.z + a.m[11];
-		}
-		else
-		{
-			r.x = a.m[0]*b.x + a.m[4]*b.y + a.m[8]*b.z + a.m[12];
-			r.y = a.m[1]*b.x + a.m[5]*b.y + a.m[9]*b.z + a.m[13];
-			r.z = a.m[2]*b.x + a.m[6]*b.y + a.m[10]*b.z + a.m[14];
-		}
-
-		return r;
-	}
-
-	// mat3 * vec3
-	vec3 MultMat3Vec3(mat3 a, vec3 b) // result = a * b
-	{
-		vec3 r;
-		
-		if (!transposed)
-		{
-			r.x = a.m[0]*b.x + a.m[1]*b.y + a.m[2]*b.z;
-			r.y = a.m[3]*b.x + a.m[4]*b.y + a.m[5]*b.z;
-			r.z = a.m[6]*b.x + a.m[7]*b.y + a.m[8]*b.z;
-		}
-		else
-		{
-			r.x = a.m[0]*b.x + a.m[3]*b.y + a.m[6]*b.z;
-			r.y = a.m[1]*b.x + a.m[4]*b.y + a.m[7]*b.z;
-			r.z = a.m[2]*b.x + a.m[5]*b.y + a.m[8]*b.z;
-		}
-		
-		return r;
-	}
-
 	// mat4 * vec4
 	vec4 MultVec4(mat4 a, vec4 b) // result = a * b
 	{
 		vec4 r;
+#if VU_SIMD
+		GLfloat f[4];
 
-		if (!transposed)
+		if (TRANSPOSED)
+		{
+			V4Store(f, MultVec4Columns(a.m, b));
+			r.x = f[0];
+			r.y = f[1];
+			r.z = f[2];
+			r.w = f[3];
+			return r;
+		}
+#endif
+		if (!TRANSPOSED)
 		{
 			r.x = a.m[0]*b.x + a.m[1]*b.y + a.m[2]*b.z + a.m[3]*b.w;
 			r.y = a.m[4]*b.x + a.m[5]*b.y + a.m[6]*b.z + a.m[7]*b.w;
@@ -435,7 +483,6 @@ char transposed = 0;
 			r.z = a.m[2]*b.x + a.m[6]*b.y + a.m[10]*b.z + a.m[14]*b.w;
 			r.w = a.m[3]*b.x + a.m[7]*b.y + a.m[11]*b.z + a.m[15]*b.w;
 		}
-
 		return r;
 	}
 
@@ -457,7 +504,7 @@ char transposed = 0;
 	{
 		vec3 x, y, z;
 
-		if (transposed)
+		if (TRANSPOSED)
 		{
 			x = SetVector(R->m[0], R->m[1], R->m[2]);
 			y = SetVector(R->m[4], R->m[5], R->m[6]);
@@ -587,7 +634,7 @@ mat4 ArbRotate(vec3 axis, GLfloat fi)
 	y = Normalize(CrossProduct(z, x)); // y' = z^ x x'
 	z = CrossProduct(x, y); // z' = x x y
 
-	if (transposed)
+	if (TRANSPOSED)
 	{
 		R.m[0] = x.x; R.m[4] = x.y; R.m[8] = x.z;  R.m[12] = 0.0;
 		R.m[1] = y.x; R.m[5] = y.y; R.m[9] = y.z;  R.m[13] = 0.0;
@@ -622,7 +669,7 @@ mat4 CrossMatrix(vec3 a) // Skapar matris f
 {
 	mat4 m;
 	
-	if (transposed)
+	if (TRANSPOSED)
 	{
 		m.m[0] =    0; m.m[4] =-a.z; m.m[8] = a.y; m.m[12] = 0.0;
 		m.m[1] = a.z; m.m[5] =    0; m.m[9] =-a.x; m.m[13] = 0.0;
@@ -660,7 +707,12 @@ mat4 MatrixAdd(mat4 a, mat4 b)
 
 void SetTransposed(char t)
 {
+#if defined(VECTORUTILS3_COLUMN_MAJOR) || defined(VECTORUTILS3_ROW_MAJOR)
+	if ((t != 0) != TRANSPOSED)
+		printf("SetTransposed: the layout is fixed at compile time, ignored\n");
+#else
 	transposed = t;
+#endif
 }
 
 
@@ -684,6 +736,8 @@ mat4 lookAtv(vec3 p, vec3 l, vec3 v)
                       v.x, v.y, v.z, 0,
                       n.x, n.y, n.z, 0,
                       0,   0,   0,   1);
+	if (TRANSPOSED)
+		rot = Transpose(rot);
 	trans = T(-p.x, -p.y, -p.z);
 	return Mult(rot, trans);
 }
@@ -753,7 +807,7 @@ mat4 frustum(float left, float right, float bottom, float top,
     matrix.m[14] = (-temp * zfar) / temp4; // D = -2fn / f-n
     matrix.m[15] = 0.0;
     
-    if (!transposed)
+    if (!TRANSPOSED)
     	matrix = Transpose(matrix);
     
     return matrix;
@@ -775,6 +829,8 @@ mat4 ortho(GLfloat left, GLfloat right, GLfloat bottom, GLfloat top, GLfloat nea
             0, b, 0, ty,
             0, 0, c, tz,
             0, 0, 0, 1);
+        if (TRANSPOSED)
+            o = Transpose(o);
         return o;
 }
 
@@ -932,6 +988,67 @@ vec4 vec3tovec4(vec3 v)
 // Stol... I mean adapted from glMatrix (WebGL math unit). Almost no
 // changes despite changing language! But I just might replace it with
 // a gaussian elimination some time.
+#if VU_SSE
+// The same cofactors as below, four at a time. Works for either layout
+// since the inverse of the transpose is the transpose of the inverse.
+#define Shuffle(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+
+// The six 2x2 determinants of two rows r0 and r1, as (01, 02, 03, 12) and (13, 23, 13, 23)
+static void Minors2x2(__m128 r0, __m128 r1, __m128 *lo, __m128 *hi)
+{
+	*lo = _mm_sub_ps(_mm_mul_ps(Shuffle(r0, r0, 0,0,0,1), Shuffle(r1, r1, 1,2,3,2)),
+			_mm_mul_ps(Shuffle(r0, r0, 1,2,3,2), Shuffle(r1, r1, 0,0,0,1)));
+	*hi = _mm_sub_ps(_mm_mul_ps(Shuffle(r0, r0, 1,2,1,2), Shuffle(r1, r1, 3,3,3,3)),
+			_mm_mul_ps(Shuffle(r0, r0, 3,3,3,3), Shuffle(r1, r1, 1,2,1,2)));
+}
+
+mat4 InvertMat4(mat4 a)
+{
+	mat4 b;
+	__m128 r0 = _mm_loadu_ps(&a.m[0]), r1 = _mm_loadu_ps(&a.m[4]);
+	__m128 r2 = _mm_loadu_ps(&a.m[8]), r3 = _mm_loadu_ps(&a.m[12]);
+	__m128 m01, m23, n01, n23, c0, c1, c2, c3, t0, t1, t2, t3, q, sign;
+	GLfloat lo[4], hi[4], lo2[4], hi2[4];
+
+	// Same names as the scalar version: (A,B,t,u) (v,w) (x,y,z,C) (D,E)
+	Minors2x2(r0, r1, &m01, &n01);
+	Minors2x2(r2, r3, &m23, &n23);
+	_mm_storeu_ps(lo, m01); _mm_storeu_ps(hi, n01);
+	_mm_storeu_ps(lo2, m23); _mm_storeu_ps(hi2, n23);
+	q = _mm_set1_ps(1/(lo[0]*hi2[1] - lo[1]*hi2[0] + lo[2]*lo2[3] + lo[3]*lo2[2] - hi[0]*lo2[1] + hi[1]*lo2[0]));
+
+	// Columns of a, in the order the cofactors need them
+	t0 = _mm_unpacklo_ps(r1, r0); t1 = _mm_unpackhi_ps(r1, r0);
+	t2 = _mm_unpacklo_ps(r3, r2); t3 = _mm_unpackhi_ps(r3, r2);
+	c0 = _mm_movelh_ps(t0, t2); // f c n k
+	c1 = _mm_movehl_ps(t2, t0); // h d p l
+	c2 = _mm_movelh_ps(t1, t3); // i e r o
+	c3 = _mm_movehl_ps(t3, t1); // j g s m
+
+	// Alternating signs, + - + - on even rows, - + - + on odd rows
+	sign = _mm_setr_ps(0.0f, -0.0f, 0.0f, -0.0f);
+	q = _mm_xor_ps(q, sign);
+	_mm_storeu_ps(&b.m[0], _mm_mul_ps(_mm_add_ps(_mm_sub_ps(
+			_mm_mul_ps(c1, Shuffle(n23, n01, 1,1,1,1)),
+			_mm_mul_ps(c2, Shuffle(n23, n01, 0,0,0,0))),
+			_mm_mul_ps(c3, Shuffle(m23, m01, 3,3,3,3))), q));
+	_mm_storeu_ps(&b.m[8], _mm_mul_ps(_mm_add_ps(_mm_sub_ps(
+			_mm_mul_ps(c0, Shuffle(n23, n01, 0,0,0,0)),
+			_mm_mul_ps(c1, Shuffle(m23, m01, 2,2,2,2))),
+			_mm_mul_ps(c3, Shuffle(m23, m01, 0,0,0,0))), q));
+	q = _mm_xor_ps(q, _mm_set1_ps(-0.0f));
+	_mm_storeu_ps(&b.m[4], _mm_mul_ps(_mm_add_ps(_mm_sub_ps(
+			_mm_mul_ps(c0, Shuffle(n23, n01, 1,1,1,1)),
+			_mm_mul_ps(c2, Shuffle(m23, m01, 2,2,2,2))),
+			_mm_mul_ps(c3, Shuffle(m23, m01, 1,1,1,1))), q));
+	_mm_storeu_ps(&b.m[12], _mm_mul_ps(_mm_add_ps(_mm_sub_ps(
+			_mm_mul_ps(c0, Shuffle(m23, m01, 3,3,3,3)),
+			_mm_mul_ps(c1, Shuffle(m23, m01, 1,1,1,1))),
+			_mm_mul_ps(c2, Shuffle(m23, m01, 0,0,0,0))), q));
+	return b;
+}
+#undef Shuffle
+#else
 mat4 InvertMat4(mat4 a)
 {
    mat4 b;
@@ -971,6 +1088,1102 @@ mat4 InvertMat4(mat4 a)
 	b.m[15]=(k*u-l*B+o*A)*q;
 	return b;
 };
+#endif
+
+
+// Quaternions
+
+// Element (row, col) of a mat4 in the current layout
+#define M4(row, col) (TRANSPOSED ? (col)*4 + (row) : (row)*4 + (col))
+
+quat SetQuat(GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+	quat q;
+
+	q.x = x;
+	q.y = y;
+	q.z = z;
+	q.w = w;
+	return q;
+}
+
+quat IdentityQuat()
+{
+	return SetQuat(0, 0, 0, 1);
+}
+
+quat QuatMult(quat a, quat b)
+{
+	return SetQuat(a.w*b.x + a.x*b.w + a.y*b.z - a.z*b.y,
+				a.w*b.y - a.x*b.z + a.y*b.w + a.z*b.x,
+				a.w*b.z + a.x*b.y - a.y*b.x + a.z*b.w,
+				a.w*b.w - a.x*b.x - a.y*b.y - a.z*b.z);
+}
+
+quat QuatConjugate(quat q)
+{
+	return SetQuat(-q.x, -q.y, -q.z, q.w);
+}
+
+GLfloat QuatDot(quat a, quat b)
+{
+	return a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w;
+}
+
+quat QuatNormalize(quat q)
+{
+	GLfloat norm = (GLfloat)sqrt(QuatDot(q, q));
+
+	return SetQuat(q.x / norm, q.y / norm, q.z / norm, q.w / norm);
+}
+
+quat QuatFromAxisAngle(vec3 axis, GLfloat angle)
+{
+	GLfloat s = (GLfloat)sin(angle * 0.5);
+
+	axis = Normalize(axis);
+	return SetQuat(axis.x * s, axis.y * s, axis.z * s, (GLfloat)cos(angle * 0.5));
+}
+
+void QuatToAxisAngle(quat q, vec3 *axis, GLfloat *angle)
+{
+	GLfloat s = (GLfloat)sqrt(q.x*q.x + q.y*q.y + q.z*q.z);
+
+	*angle = (GLfloat)(2.0 * atan2(s, q.w));
+	if (s > 0.000001)
+		*axis = SetVector(q.x / s, q.y / s, q.z / s);
+	else
+		*axis = SetVector(1, 0, 0); // No rotation, any axis will do
+}
+
+quat QuatNlerp(quat a, quat b, GLfloat t)
+{
+	if (QuatDot(a, b) < 0) // Take the short way
+		t = -t;
+	return QuatNormalize(SetQuat(a.x*(1-fabs(t)) + b.x*t, a.y*(1-fabs(t)) + b.y*t,
+								a.z*(1-fabs(t)) + b.z*t, a.w*(1-fabs(t)) + b.w*t));
+}
+
+quat QuatSlerp(quat a, quat b, GLfloat t)
+{
+	GLfloat d = QuatDot(a, b), theta, sa, sb;
+
+	if (d < 0) // Take the short way
+	{
+		b = SetQuat(-b.x, -b.y, -b.z, -b.w);
+		d = -d;
+	}
+	if (d > 0.9995) // Nearly parallel, sin(theta) would be too small
+		return QuatNlerp(a, b, t);
+	theta = (GLfloat)acos(d);
+	sa = (GLfloat)(sin((1 - t) * theta) / sin(theta));
+	sb = (GLfloat)(sin(t * theta) / sin(theta));
+	return SetQuat(a.x*sa + b.x*sb, a.y*sa + b.y*sb, a.z*sa + b.z*sb, a.w*sa + b.w*sb);
+}
+
+// Rotation by |omega| * dt around omega, applied after q.
+// Exact for constant omega, unlike R := R + CrossMatrix(omega*dt) * R.
+quat QuatIntegrate(quat q, vec3 omega, GLfloat dt)
+{
+	GLfloat speed = Norm(omega);
+
+	if (speed * dt < 0.0000001)
+		return q;
+	return QuatNormalize(QuatMult(QuatFromAxisAngle(omega, speed * dt), q));
+}
+
+vec3 QuatRotateVec3(quat q, vec3 v)
+{
+	vec3 u = SetVector(q.x, q.y, q.z), t;
+
+	// v + 2w(u x v) + 2u x (u x v)
+	t = ScalarMult(CrossProduct(u, v), 2);
+	return VectorAdd(VectorAdd(v, ScalarMult(t, q.w)), CrossProduct(u, t));
+}
+
+mat4 QuatToMat4(quat q)
+{
+	mat4 m = IdentityMatrix();
+
+	m.m[M4(0,0)] = 1 - 2*(q.y*q.y + q.z*q.z);
+	m.m[M4(0,1)] = 2*(q.x*q.y - q.w*q.z);
+	m.m[M4(0,2)] = 2*(q.x*q.z + q.w*q.y);
+	m.m[M4(1,0)] = 2*(q.x*q.y + q.w*q.z);
+	m.m[M4(1,1)] = 1 - 2*(q.x*q.x + q.z*q.z);
+	m.m[M4(1,2)] = 2*(q.y*q.z - q.w*q.x);
+	m.m[M4(2,0)] = 2*(q.x*q.z - q.w*q.y);
+	m.m[M4(2,1)] = 2*(q.y*q.z + q.w*q.x);
+	m.m[M4(2,2)] = 1 - 2*(q.x*q.x + q.y*q.y);
+	return m;
+}
+
+// Uses the largest of w, x, y, z to avoid dividing by something small.
+quat Mat4ToQuat(mat4 m)
+{
+	GLfloat m00 = m.m[M4(0,0)], m11 = m.m[M4(1,1)], m22 = m.m[M4(2,2)];
+	GLfloat trace = m00 + m11 + m22, s;
+
+	if (trace > 0)
+	{
+		s = (GLfloat)sqrt(trace + 1) * 2; // 4w
+		return SetQuat((m.m[M4(2,1)] - m.m[M4(1,2)]) / s, (m.m[M4(0,2)] - m.m[M4(2,0)]) / s,
+					(m.m[M4(1,0)] - m.m[M4(0,1)]) / s, s / 4);
+	}
+	if (m00 > m11 && m00 > m22)
+	{
+		s = (GLfloat)sqrt(1 + m00 - m11 - m22) * 2; // 4x
+		return SetQuat(s / 4, (m.m[M4(0,1)] + m.m[M4(1,0)]) / s,
+					(m.m[M4(0,2)] + m.m[M4(2,0)]) / s, (m.m[M4(2,1)] - m.m[M4(1,2)]) / s);
+	}
+	if (m11 > m22)
+	{
+		s = (GLfloat)sqrt(1 + m11 - m00 - m22) * 2; // 4y
+		return SetQuat((m.m[M4(0,1)] + m.m[M4(1,0)]) / s, s / 4,
+					(m.m[M4(1,2)] + m.m[M4(2,1)]) / s, (m.m[M4(0,2)] - m.m[M4(2,0)]) / s);
+	}
+	s = (GLfloat)sqrt(1 + m22 - m00 - m11) * 2; // 4z
+	return SetQuat((m.m[M4(0,2)] + m.m[M4(2,0)]) / s, (m.m[M4(1,2)] + m.m[M4(2,1)]) / s,
+				s / 4, (m.m[M4(1,0)] - m.m[M4(0,1)]) / s);
+}
+
+
+// Dual quaternions
+
+dualquat DualQuatFromQuatTranslation(quat r, vec3 t)
+{
+	dualquat dq;
+
+	dq.real = r;
+	dq.dual = QuatMult(SetQuat(t.x * 0.5f, t.y * 0.5f, t.z * 0.5f, 0), r);
+	return dq;
+}
+
+dualquat DualQuatFromMat4(mat4 m)
+{
+	return DualQuatFromQuatTranslation(Mat4ToQuat(m),
+				SetVector(m.m[M4(0,3)], m.m[M4(1,3)], m.m[M4(2,3)]));
+}
+
+dualquat DualQuatMult(dualquat a, dualquat b)
+{
+	dualquat dq;
+	quat d1 = QuatMult(a.real, b.dual), d2 = QuatMult(a.dual, b.real);
+
+	dq.real = QuatMult(a.real, b.real);
+	dq.dual = SetQuat(d1.x + d2.x, d1.y + d2.y, d1.z + d2.z, d1.w + d2.w);
+	return dq;
+}
+
+// Unit real part, and a dual part orthogonal to it
+dualquat DualQuatNormalize(dualquat dq)
+{
+	GLfloat norm = (GLfloat)sqrt(QuatDot(dq.real, dq.real)), d;
+	quat r = dq.real, e = dq.dual;
+
+	r = SetQuat(r.x / norm, r.y / norm, r.z / norm, r.w / norm);
+	e = SetQuat(e.x / norm, e.y / norm, e.z / norm, e.w / norm);
+	d = QuatDot(r, e);
+	dq.real = r;
+	dq.dual = SetQuat(e.x - r.x*d, e.y - r.y*d, e.z - r.z*d, e.w - r.w*d);
+	return dq;
+}
+
+vec3 DualQuatTranslation(dualquat dq)
+{
+	quat t = QuatMult(dq.dual, QuatConjugate(dq.real));
+
+	return SetVector(2 * t.x, 2 * t.y, 2 * t.z);
+}
+
+vec3 DualQuatTransformPoint(dualquat dq, vec3 p)
+{
+	return VectorAdd(QuatRotateVec3(dq.real, p), DualQuatTranslation(dq));
+}
+
+mat4 DualQuatToMat4(dualquat dq)
+{
+	mat4 m = QuatToMat4(dq.real);
+	vec3 t = DualQuatTranslation(dq);
+
+	m.m[M4(0,3)] = t.x;
+	m.m[M4(1,3)] = t.y;
+	m.m[M4(2,3)] = t.z;
+	return m;
+}
+
+
+// Affine 3x4 transforms. The bottom row is always (0 0 0 1) and is not
+// stored, so composing is 36 multiplications instead of 64, and the
+// inverse only needs the 3x3 part.
+
+mat4x3 IdentityMat4x3()
+{
+	mat4x3 a = {{1,0,0,0, 0,1,0,0, 0,0,1,0}};
+
+	return a;
+}
+
+mat4x3 Mat4ToMat4x3(mat4 m)
+{
+	mat4x3 a;
+	int i, j;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 4; j++)
+			a.m[i*4 + j] = m.m[M4(i, j)];
+	return a;
+}
+
+mat4 Mat4x3ToMat4(mat4x3 a)
+{
+	mat4 m = IdentityMatrix();
+	int i, j;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 4; j++)
+			m.m[M4(i, j)] = a.m[i*4 + j];
+	return m;
+}
+
+mat4x3 MultMat4x3(mat4x3 a, mat4x3 b)
+{
+	mat4x3 m;
+	int y;
+#if VU_SIMD
+	v4f b0 = V4Load(&b.m[0]), b1 = V4Load(&b.m[4]), b2 = V4Load(&b.m[8]), b3 = V4Set(0, 0, 0, 1), r;
+
+	for (y = 0; y < 3; y++)
+	{
+		r = V4Mul(V4Splat(a.m[y*4+0]), b0);
+		r = V4MulAdd(r, V4Splat(a.m[y*4+1]), b1);
+		r = V4MulAdd(r, V4Splat(a.m[y*4+2]), b2);
+		V4Store(&m.m[y*4], V4MulAdd(r, V4Splat(a.m[y*4+3]), b3));
+	}
+#else
+	int x;
+
+	for (y = 0; y < 3; y++)
+	{
+		for (x = 0; x < 4; x++)
+			m.m[y*4 + x] = a.m[y*4+0] * b.m[x] + a.m[y*4+1] * b.m[4+x] + a.m[y*4+2] * b.m[8+x];
+		m.m[y*4 + 3] += a.m[y*4+3];
+	}
+#endif
+	return m;
+}
+
+vec3 MultMat4x3Vec3(mat4x3 a, vec3 p)
+{
+#if VU_SIMD
+	// The three rows and (0 0 0 1) as columns, then the same sums as below
+	v4f c0 = V4Load(&a.m[0]), c1 = V4Load(&a.m[4]), c2 = V4Load(&a.m[8]), c3 = V4Set(0, 0, 0, 1), r;
+	GLfloat out[4];
+
+	V4Transpose(c0, c1, c2, c3);
+	r = V4Mul(c0, V4Splat(p.x));
+	r = V4MulAdd(r, c1, V4Splat(p.y));
+	r = V4MulAdd(r, c2, V4Splat(p.z));
+	V4Store(out, V4Add(r, c3));
+	return SetVector(out[0], out[1], out[2]);
+#else
+	return SetVector(a.m[0]*p.x + a.m[1]*p.y + a.m[2]*p.z + a.m[3],
+				a.m[4]*p.x + a.m[5]*p.y + a.m[6]*p.z + a.m[7],
+				a.m[8]*p.x + a.m[9]*p.y + a.m[10]*p.z + a.m[11]);
+#endif
+}
+
+vec3 MultMat4x3Dir(mat4x3 a, vec3 v)
+{
+	return SetVector(a.m[0]*v.x + a.m[1]*v.y + a.m[2]*v.z,
+				a.m[4]*v.x + a.m[5]*v.y + a.m[6]*v.z,
+				a.m[8]*v.x + a.m[9]*v.y + a.m[10]*v.z);
+}
+
+#if !VU_SSE
+// Cofactors of the 3x3 part, c[i*3+j] for element (i, j). Returns the determinant.
+static GLfloat Cofactors3x4(const GLfloat *m, GLfloat *c)
+{
+	c[0] = m[5]*m[10] - m[6]*m[9];
+	c[1] = m[6]*m[8] - m[4]*m[10];
+	c[2] = m[4]*m[9] - m[5]*m[8];
+	c[3] = m[2]*m[9] - m[1]*m[10];
+	c[4] = m[0]*m[10] - m[2]*m[8];
+	c[5] = m[1]*m[8] - m[0]*m[9];
+	c[6] = m[1]*m[6] - m[2]*m[5];
+	c[7] = m[2]*m[4] - m[0]*m[6];
+	c[8] = m[0]*m[5] - m[1]*m[4];
+	return m[0]*c[0] + m[1]*c[1] + m[2]*c[2];
+}
+#else
+// a x b in the first three lanes
+static inline __m128 Cross4(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(V4Shuffle(a, a, 1,2,0,3), V4Shuffle(b, b, 2,0,1,3)),
+			_mm_mul_ps(V4Shuffle(a, a, 2,0,1,3), V4Shuffle(b, b, 1,2,0,3)));
+}
+
+// Rows c0..c2 and t become the columns of the result, only its first 3 rows are stored
+static inline mat4x3 StoreTransposed3x4(__m128 c0, __m128 c1, __m128 c2, __m128 t)
+{
+	mat4x3 b;
+
+	_MM_TRANSPOSE4_PS(c0, c1, c2, t);
+	_mm_storeu_ps(&b.m[0], c0);
+	_mm_storeu_ps(&b.m[4], c1);
+	_mm_storeu_ps(&b.m[8], c2);
+	return b;
+}
+#endif
+
+// Inverse of the 3x3 part is the transposed cofactors / det,
+// the translation is -inverse * t.
+mat4x3 InvertMat4x3(mat4x3 a)
+{
+#if VU_SSE
+	// The rows of the cofactor matrix are cross products of the rows
+	__m128 r0 = _mm_loadu_ps(&a.m[0]), r1 = _mm_loadu_ps(&a.m[4]), r2 = _mm_loadu_ps(&a.m[8]);
+	__m128 c0 = Cross4(r1, r2), c1 = Cross4(r2, r0), c2 = Cross4(r0, r1), q, t;
+	GLfloat d[4];
+
+	_mm_storeu_ps(d, _mm_mul_ps(r0, c0));
+	q = _mm_set1_ps(-1 / (d[0] + d[1] + d[2]));
+	t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(a.m[3])),
+			_mm_mul_ps(c1, _mm_set1_ps(a.m[7]))), _mm_mul_ps(c2, _mm_set1_ps(a.m[11]))), q);
+	q = _mm_xor_ps(q, _mm_set1_ps(-0.0f));
+	return StoreTransposed3x4(_mm_mul_ps(c0, q), _mm_mul_ps(c1, q), _mm_mul_ps(c2, q), t);
+#else
+	mat4x3 b;
+	GLfloat c[9], q;
+	int i, j;
+
+	q = 1 / Cofactors3x4(a.m, c);
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			b.m[i*4 + j] = c[j*3 + i] * q;
+	for (i = 0; i < 3; i++)
+		b.m[i*4 + 3] = -(b.m[i*4+0]*a.m[3] + b.m[i*4+1]*a.m[7] + b.m[i*4+2]*a.m[11]);
+	return b;
+#endif
+}
+
+mat4x3 InvertMat4x3Rigid(mat4x3 a)
+{
+#if VU_SSE
+	__m128 r0 = _mm_loadu_ps(&a.m[0]), r1 = _mm_loadu_ps(&a.m[4]), r2 = _mm_loadu_ps(&a.m[8]);
+	__m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, _mm_set1_ps(-a.m[3])),
+			_mm_mul_ps(r1, _mm_set1_ps(-a.m[7]))), _mm_mul_ps(r2, _mm_set1_ps(-a.m[11])));
+
+	return StoreTransposed3x4(r0, r1, r2, t);
+#else
+	mat4x3 b;
+	int i, j;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			b.m[i*4 + j] = a.m[j*4 + i];
+	for (i = 0; i < 3; i++)
+		b.m[i*4 + 3] = -(b.m[i*4+0]*a.m[3] + b.m[i*4+1]*a.m[7] + b.m[i*4+2]*a.m[11]);
+	return b;
+#endif
+}
+
+// The cofactor matrix / det is the inverse transpose
+mat3 NormalMatrixMat4x3(mat4x3 a)
+{
+#if VU_SSE
+	__m128 r0 = _mm_loadu_ps(&a.m[0]), r1 = _mm_loadu_ps(&a.m[4]), r2 = _mm_loadu_ps(&a.m[8]);
+	__m128 c0 = Cross4(r1, r2), c1 = Cross4(r2, r0), c2 = Cross4(r0, r1), q;
+	GLfloat c[12];
+
+	_mm_storeu_ps(c, _mm_mul_ps(r0, c0));
+	q = _mm_set1_ps(1 / (c[0] + c[1] + c[2]));
+	_mm_storeu_ps(&c[0], _mm_mul_ps(c0, q));
+	_mm_storeu_ps(&c[4], _mm_mul_ps(c1, q));
+	_mm_storeu_ps(&c[8], _mm_mul_ps(c2, q));
+	if (TRANSPOSED)
+		return SetMat3(c[0], c[4], c[8], c[1], c[5], c[9], c[2], c[6], c[10]);
+	return SetMat3(c[0], c[1], c[2], c[4], c[5], c[6], c[8], c[9], c[10]);
+#else
+	GLfloat c[9], q;
+
+	// Written out. As a loop, GCC mixed vector and scalar stores to c and the
+	// result, which made this twice as slow as InverseTranspose.
+	q = 1 / Cofactors3x4(a.m, c);
+	if (TRANSPOSED)
+		return SetMat3(c[0]*q, c[3]*q, c[6]*q, c[1]*q, c[4]*q, c[7]*q, c[2]*q, c[5]*q, c[8]*q);
+	return SetMat3(c[0]*q, c[1]*q, c[2]*q, c[3]*q, c[4]*q, c[5]*q, c[6]*q, c[7]*q, c[8]*q);
+#endif
+}
+
+
+// Translation, rotation, scale
+
+trs SetTRS(vec3 t, quat r, vec3 s)
+{
+	trs x;
+
+	x.t = t;
+	x.r = r;
+	x.s = s;
+	return x;
+}
+
+trs IdentityTRS()
+{
+	return SetTRS(SetVector(0, 0, 0), IdentityQuat(), SetVector(1, 1, 1));
+}
+
+mat4x3 TRSToMat4x3(trs x)
+{
+	mat4x3 a;
+	quat q = x.r;
+
+	a.m[0] = (1 - 2*(q.y*q.y + q.z*q.z)) * x.s.x;
+	a.m[1] = 2*(q.x*q.y - q.w*q.z) * x.s.y;
+	a.m[2] = 2*(q.x*q.z + q.w*q.y) * x.s.z;
+	a.m[3] = x.t.x;
+	a.m[4] = 2*(q.x*q.y + q.w*q.z) * x.s.x;
+	a.m[5] = (1 - 2*(q.x*q.x + q.z*q.z)) * x.s.y;
+	a.m[6] = 2*(q.y*q.z - q.w*q.x) * x.s.z;
+	a.m[7] = x.t.y;
+	a.m[8] = 2*(q.x*q.z - q.w*q.y) * x.s.x;
+	a.m[9] = 2*(q.y*q.z + q.w*q.x) * x.s.y;
+	a.m[10] = (1 - 2*(q.x*q.x + q.y*q.y)) * x.s.z;
+	a.m[11] = x.t.z;
+	return a;
+}
+
+mat4 TRSToMat4(trs x)
+{
+	return Mat4x3ToMat4(TRSToMat4x3(x));
+}
+
+
+// Batch operations on arrays of vectors.
+// Each call takes vec3 arrays, the SoA variants separate x, y and z arrays.
+// Four vectors at a time with SIMD, in the same order of operations as the
+// single vector calls, so the results are the same. With -fopenmp, long
+// arrays are also split over threads. Output may be the same array as input.
+
+#define kBatchChunk 4096 // Vectors per thread work unit, a multiple of 4
+
+typedef struct
+{
+	GLfloat *x, *y, *z;
+	int stride; // 3 for vec3 arrays, 1 for separate arrays
+} Vec3Stream;
+
+static Vec3Stream AoSStream(const vec3 *v)
+{
+	Vec3Stream s;
+	s.x = (GLfloat *)&v->x;
+	s.y = (GLfloat *)&v->y;
+	s.z = (GLfloat *)&v->z;
+	s.stride = 3;
+	return s;
+}
+
+static Vec3Stream SoAStream(const GLfloat *x, const GLfloat *y, const GLfloat *z)
+{
+	Vec3Stream s;
+	s.x = (GLfloat *)x;
+	s.y = (GLfloat *)y;
+	s.z = (GLfloat *)z;
+	s.stride = 1;
+	return s;
+}
+
+#if VU_SIMD
+static inline void StreamLoad(const Vec3Stream *s, int i, v4f *x, v4f *y, v4f *z)
+{
+	if (s->stride == 3)
+		V4LoadXYZ(&s->x[i*3], x, y, z);
+	else
+	{
+		*x = V4Load(&s->x[i]);
+		*y = V4Load(&s->y[i]);
+		*z = V4Load(&s->z[i]);
+	}
+}
+
+static inline void StreamStore(const Vec3Stream *s, int i, v4f x, v4f y, v4f z)
+{
+	if (s->stride == 3)
+		V4StoreXYZ(&s->x[i*3], x, y, z);
+	else
+	{
+		V4Store(&s->x[i], x);
+		V4Store(&s->y[i], y);
+		V4Store(&s->z[i], z);
+	}
+}
+#endif
+
+// Calls kernel on pieces of [0, n), in parallel if OpenMP is on
+typedef void (*BatchKernel)(const void *arg, int from, int to);
+
+static void RunBatch(BatchKernel kernel, const void *arg, int n)
+{
+	int c, chunks = (n + kBatchChunk - 1) / kBatchChunk;
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static) if (chunks > 1)
+#endif
+	for (c = 0; c < chunks; c++)
+		kernel(arg, c * kBatchChunk, (c + 1) * kBatchChunk < n ? (c + 1) * kBatchChunk : n);
+}
+
+// The upper 3x4 part of a mat4 as rows, whatever the layout
+static void MatrixRows3x4(const GLfloat *m, GLfloat *r)
+{
+	int i, j;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 4; j++)
+			r[i*4 + j] = TRANSPOSED ? m[j*4 + i] : m[i*4 + j];
+}
+
+typedef struct
+{
+	GLfloat r[12]; // 3x4 rows
+	Vec3Stream in, out;
+	int normalize;
+} TransformBatch;
+
+static void TransformRange(const void *arg, int from, int to)
+{
+	const TransformBatch *t = (const TransformBatch *)arg;
+	const GLfloat *r = t->r;
+	GLfloat x, y, z, rx, ry, rz, norm;
+	int i = from;
+#if VU_SIMD
+	v4f vx, vy, vz, ox, oy, oz, n;
+
+	for (; i + 4 <= to; i += 4)
+	{
+		StreamLoad(&t->in, i, &vx, &vy, &vz);
+		ox = V4Add(V4MulAdd(V4MulAdd(V4Mul(V4Splat(r[0]), vx), V4Splat(r[1]), vy), V4Splat(r[2]), vz), V4Splat(r[3]));
+		oy = V4Add(V4MulAdd(V4MulAdd(V4Mul(V4Splat(r[4]), vx), V4Splat(r[5]), vy), V4Splat(r[6]), vz), V4Splat(r[7]));
+		oz = V4Add(V4MulAdd(V4MulAdd(V4Mul(V4Splat(r[8]), vx), V4Splat(r[9]), vy), V4Splat(r[10]), vz), V4Splat(r[11]));
+		if (t->normalize)
+		{
+			n = V4Sqrt(V4MulAdd(V4MulAdd(V4Mul(ox, ox), oy, oy), oz, oz));
+			ox = V4Div(ox, n);
+			oy = V4Div(oy, n);
+			oz = V4Div(oz, n);
+		}
+		StreamStore(&t->out, i, ox, oy, oz);
+	}
+#endif
+	for (; i < to; i++)
+	{
+		x = t->in.x[i * t->in.stride];
+		y = t->in.y[i * t->in.stride];
+		z = t->in.z[i * t->in.stride];
+		rx = r[0]*x + r[1]*y + r[2]*z + r[3];
+		ry = r[4]*x + r[5]*y + r[6]*z + r[7];
+		rz = r[8]*x + r[9]*y + r[10]*z + r[11];
+		if (t->normalize)
+		{
+			norm = (GLfloat)sqrt(rx * rx + ry * ry + rz * rz);
+			rx = rx / norm;
+			ry = ry / norm;
+			rz = rz / norm;
+		}
+		t->out.x[i * t->out.stride] = rx;
+		t->out.y[i * t->out.stride] = ry;
+		t->out.z[i * t->out.stride] = rz;
+	}
+}
+
+static void TransformStream(const GLfloat *rows, Vec3Stream in, Vec3Stream out, int normalize, int n)
+{
+	TransformBatch t;
+
+	memcpy(t.r, rows, sizeof(t.r));
+	t.in = in;
+	t.out = out;
+	t.normalize = normalize;
+	RunBatch(TransformRange, &t, n);
+}
+
+// Identity, for normalizing only
+static const GLfloat kIdentityRows[12] = {1,0,0,0, 0,1,0,0, 0,0,1,0};
+
+// out[i] = MultVec3(a, in[i])
+void MultVec3Array(mat4 a, const vec3 *in, vec3 *out, int n)
+{
+	GLfloat r[12];
+
+	MatrixRows3x4(a.m, r);
+	TransformStream(r, AoSStream(in), AoSStream(out), 0, n);
+}
+
+void MultVec3ArraySoA(mat4 a, const GLfloat *x, const GLfloat *y, const GLfloat *z,
+				GLfloat *outX, GLfloat *outY, GLfloat *outZ, int n)
+{
+	GLfloat r[12];
+
+	MatrixRows3x4(a.m, r);
+	TransformStream(r, SoAStream(x, y, z), SoAStream(outX, outY, outZ), 0, n);
+}
+
+// out[i] = Normalize(in[i])
+void NormalizeArray(const vec3 *in, vec3 *out, int n)
+{
+	TransformStream(kIdentityRows, AoSStream(in), AoSStream(out), 1, n);
+}
+
+void NormalizeArraySoA(GLfloat *x, GLfloat *y, GLfloat *z, int n)
+{
+	TransformStream(kIdentityRows, SoAStream(x, y, z), SoAStream(x, y, z), 1, n);
+}
+
+// Points by a, normals by the inverse transpose of a, normalized
+void TransformPointsAndNormals(mat4 a, const vec3 *points, const vec3 *normals,
+				vec3 *outPoints, vec3 *outNormals, int n)
+{
+	GLfloat r[12];
+	mat3 it;
+	int i, j;
+
+	MatrixRows3x4(a.m, r);
+	TransformStream(r, AoSStream(points), AoSStream(outPoints), 0, n);
+
+	it = InverseTranspose(a);
+	for (i = 0; i < 3; i++)
+	{
+		for (j = 0; j < 3; j++)
+			r[i*4 + j] = TRANSPOSED ? it.m[j*3 + i] : it.m[i*3 + j];
+		r[i*4 + 3] = 0;
+	}
+	TransformStream(r, AoSStream(normals), AoSStream(outNormals), 1, n);
+}
+
+// Linear blend skinning
+#define kMaxStackBones 32
+
+typedef struct
+{
+	const GLfloat *rows; // 3x4 rows for each bone
+	const GLfloat *weights; // boneCount per vector
+	int boneCount;
+	Vec3Stream in, out;
+} SkinBatch;
+
+static void SkinRange(const void *arg, int from, int to)
+{
+	const SkinBatch *s = (const SkinBatch *)arg;
+	const GLfloat *r;
+	GLfloat x, y, z, rx, ry, rz, wb;
+	int i = from, b, bc = s->boneCount;
+#if VU_SIMD
+	const GLfloat *w;
+	v4f vx, vy, vz, ox, oy, oz, tx, ty, tz, vw;
+
+	for (; i + 4 <= to; i += 4)
+	{
+		StreamLoad(&s->in, i, &vx, &vy, &vz);
+		ox = oy = oz = V4Splat(0.0f);
+		for (b = 0; b < bc; b++)
+		{
+			r = &s->rows[b * 12];
+			w = &s->weights[i * bc + b];
+			vw = V4Set(w[0], w[bc], w[2*bc], w[3*bc]);
+			tx = V4Add(V4MulAdd(V4MulAdd(V4Mul(V4Splat(r[0]), vx), V4Splat(r[1]), vy), V4Splat(r[2]), vz), V4Splat(r[3]));
+			ty = V4Add(V4MulAdd(V4MulAdd(V4Mul(V4Splat(r[4]), vx), V4Splat(r[5]), vy), V4Splat(r[6]), vz), V4Splat(r[7]));
+			tz = V4Add(V4MulAdd(V4MulAdd(V4Mul(V4Splat(r[8]), vx), V4Splat(r[9]), vy), V4Splat(r[10]), vz), V4Splat(r[11]));
+			ox = V4MulAdd(ox, tx, vw);
+			oy = V4MulAdd(oy, ty, vw);
+			oz = V4MulAdd(oz, tz, vw);
+		}
+		StreamStore(&s->out, i, ox, oy, oz);
+	}
+#endif
+	for (; i < to; i++)
+	{
+		x = s->in.x[i * s->in.stride];
+		y = s->in.y[i * s->in.stride];
+		z = s->in.z[i * s->in.stride];
+		rx = ry = rz = 0;
+		for (b = 0; b < bc; b++)
+		{
+			r = &s->rows[b * 12];
+			wb = s->weights[i * bc + b];
+			rx = rx + (r[0]*x + r[1]*y + r[2]*z + r[3]) * wb;
+			ry = ry + (r[4]*x + r[5]*y + r[6]*z + r[7]) * wb;
+			rz = rz + (r[8]*x + r[9]*y + r[10]*z + r[11]) * wb;
+		}
+		s->out.x[i * s->out.stride] = rx;
+		s->out.y[i * s->out.stride] = ry;
+		s->out.z[i * s->out.stride] = rz;
+	}
+}
+
+static void SkinStream(const mat4 *bones, int boneCount, const GLfloat *weights, Vec3Stream in, Vec3Stream out, int n)
+{
+	GLfloat stackRows[kMaxStackBones * 12], *rows = stackRows;
+	SkinBatch s;
+	int b;
+
+	if (boneCount > kMaxStackBones)
+		rows = (GLfloat *)malloc(boneCount * 12 * sizeof(GLfloat));
+	for (b = 0; b < boneCount; b++)
+		MatrixRows3x4(bones[b].m, &rows[b * 12]);
+	s.rows = rows;
+	s.weights = weights;
+	s.boneCount = boneCount;
+	s.in = in;
+	s.out = out;
+	RunBatch(SkinRange, &s, n);
+	if (rows != stackRows)
+		free(rows);
+}
+
+// out[i] = sum over b of weights[i*boneCount + b] * MultVec3(bones[b], in[i])
+void SkinVec3Array(const mat4 *bones, int boneCount, const GLfloat *weights,
+				const vec3 *in, vec3 *out, int n)
+{
+	SkinStream(bones, boneCount, weights, AoSStream(in), AoSStream(out), n);
+}
+
+void SkinVec3ArraySoA(const mat4 *bones, int boneCount, const GLfloat *weights,
+				const GLfloat *x, const GLfloat *y, const GLfloat *z,
+				GLfloat *outX, GLfloat *outY, GLfloat *outZ, int n)
+{
+	SkinStream(bones, boneCount, weights, SoAStream(x, y, z), SoAStream(outX, outY, outZ), n);
+}
+
+void QuatRotateVec3Array(quat q, const vec3 *in, vec3 *out, int n)
+{
+	MultVec3Array(QuatToMat4(q), in, out, n);
+}
+
+// Dual quaternion skinning: blend the bones (8 floats each), normalize by
+// the real part and transform. Bones are flipped to the same hemisphere as
+// the first one so that the blend takes the short way.
+typedef struct
+{
+	const GLfloat *bones; // 8 per bone: real xyzw, dual xyzw
+	const GLfloat *weights;
+	int boneCount;
+	Vec3Stream in, out;
+} DualQuatSkinBatch;
+
+static void SkinDualQuatRange(const void *arg, int from, int to)
+{
+	const DualQuatSkinBatch *s = (const DualQuatSkinBatch *)arg;
+	const GLfloat *q;
+	GLfloat b[8], p[3], c[3], e[3], t[3], wb, norm;
+	int i = from, k, j, bc = s->boneCount;
+#if VU_SIMD
+	const GLfloat *w;
+	v4f vb[8], vx, vy, vz, vw, vn, cx, cy, cz, tx, ty, tz;
+
+	for (; i + 4 <= to; i += 4)
+	{
+		StreamLoad(&s->in, i, &vx, &vy, &vz);
+		for (j = 0; j < 8; j++)
+			vb[j] = V4Splat(0.0f);
+		for (k = 0; k < bc; k++)
+		{
+			q = &s->bones[k * 8];
+			w = &s->weights[i * bc + k];
+			vw = V4Set(w[0], w[bc], w[2*bc], w[3*bc]);
+			for (j = 0; j < 8; j++)
+				vb[j] = V4MulAdd(vb[j], vw, V4Splat(q[j]));
+		}
+		vn = V4Sqrt(V4MulAdd(V4MulAdd(V4MulAdd(V4Mul(vb[0], vb[0]), vb[1], vb[1]), vb[2], vb[2]), vb[3], vb[3]));
+		for (j = 0; j < 8; j++)
+			vb[j] = V4Div(vb[j], vn);
+		// p + 2 r x (r x p + w p) + 2 (w e - we r + r x e)
+		cx = V4MulAdd(V4Sub(V4Mul(vb[1], vz), V4Mul(vb[2], vy)), vb[3], vx);
+		cy = V4MulAdd(V4Sub(V4Mul(vb[2], vx), V4Mul(vb[0], vz)), vb[3], vy);
+		cz = V4MulAdd(V4Sub(V4Mul(vb[0], vy), V4Mul(vb[1], vx)), vb[3], vz);
+		tx = V4Add(V4Sub(V4Mul(vb[1], cz), V4Mul(vb[2], cy)),
+			V4Add(V4Sub(V4Mul(vb[3], vb[4]), V4Mul(vb[7], vb[0])), V4Sub(V4Mul(vb[1], vb[6]), V4Mul(vb[2], vb[5]))));
+		ty = V4Add(V4Sub(V4Mul(vb[2], cx), V4Mul(vb[0], cz)),
+			V4Add(V4Sub(V4Mul(vb[3], vb[5]), V4Mul(vb[7], vb[1])), V4Sub(V4Mul(vb[2], vb[4]), V4Mul(vb[0], vb[6]))));
+		tz = V4Add(V4Sub(V4Mul(vb[0], cy), V4Mul(vb[1], cx)),
+			V4Add(V4Sub(V4Mul(vb[3], vb[6]), V4Mul(vb[7], vb[2])), V4Sub(V4Mul(vb[0], vb[5]), V4Mul(vb[1], vb[4]))));
+		StreamStore(&s->out, i, V4Add(vx, V4Add(tx, tx)), V4Add(vy, V4Add(ty, ty)), V4Add(vz, V4Add(tz, tz)));
+	}
+#endif
+	for (; i < to; i++)
+	{
+		p[0] = s->in.x[i * s->in.stride];
+		p[1] = s->in.y[i * s->in.stride];
+		p[2] = s->in.z[i * s->in.stride];
+		for (j = 0; j < 8; j++)
+			b[j] = 0;
+		for (k = 0; k < bc; k++)
+		{
+			q = &s->bones[k * 8];
+			wb = s->weights[i * bc + k];
+			for (j = 0; j < 8; j++)
+				b[j] = b[j] + wb * q[j];
+		}
+		norm = (GLfloat)sqrt(b[0]*b[0] + b[1]*b[1] + b[2]*b[2] + b[3]*b[3]);
+		for (j = 0; j < 8; j++)
+			b[j] = b[j] / norm;
+		c[0] = b[1]*p[2] - b[2]*p[1] + b[3]*p[0];
+		c[1] = b[2]*p[0] - b[0]*p[2] + b[3]*p[1];
+		c[2] = b[0]*p[1] - b[1]*p[0] + b[3]*p[2];
+		e[0] = b[3]*b[4] - b[7]*b[0] + (b[1]*b[6] - b[2]*b[5]);
+		e[1] = b[3]*b[5] - b[7]*b[1] + (b[2]*b[4] - b[0]*b[6]);
+		e[2] = b[3]*b[6] - b[7]*b[2] + (b[0]*b[5] - b[1]*b[4]);
+		t[0] = b[1]*c[2] - b[2]*c[1] + e[0];
+		t[1] = b[2]*c[0] - b[0]*c[2] + e[1];
+		t[2] = b[0]*c[1] - b[1]*c[0] + e[2];
+		s->out.x[i * s->out.stride] = p[0] + (t[0] + t[0]);
+		s->out.y[i * s->out.stride] = p[1] + (t[1] + t[1]);
+		s->out.z[i * s->out.stride] = p[2] + (t[2] + t[2]);
+	}
+}
+
+void SkinDualQuatVec3Array(const dualquat *bones, int boneCount, const GLfloat *weights,
+				const vec3 *in, vec3 *out, int n)
+{
+	GLfloat stackBones[kMaxStackBones * 8], *b = stackBones, sign;
+	DualQuatSkinBatch s;
+	int k;
+
+	if (boneCount > kMaxStackBones)
+		b = (GLfloat *)malloc(boneCount * 8 * sizeof(GLfloat));
+	for (k = 0; k < boneCount; k++)
+	{
+		sign = QuatDot(bones[k].real, bones[0].real) < 0 ? -1.0f : 1.0f;
+		b[k*8 + 0] = bones[k].real.x * sign;
+		b[k*8 + 1] = bones[k].real.y * sign;
+		b[k*8 + 2] = bones[k].real.z * sign;
+		b[k*8 + 3] = bones[k].real.w * sign;
+		b[k*8 + 4] = bones[k].dual.x * sign;
+		b[k*8 + 5] = bones[k].dual.y * sign;
+		b[k*8 + 6] = bones[k].dual.z * sign;
+		b[k*8 + 7] = bones[k].dual.w * sign;
+	}
+	s.bones = b;
+	s.weights = weights;
+	s.boneCount = boneCount;
+	s.in = AoSStream(in);
+	s.out = AoSStream(out);
+	RunBatch(SkinDualQuatRange, &s, n);
+	if (b != stackBones)
+		free(b);
+}
+
+
+// View frustum culling
+
+// Gribb & Hartmann: the planes are sums and differences of the rows of
+// the matrix, since -w <= x, y, z <= w inside in clip space.
+frustumPlanes ExtractFrustumPlanes(mat4 viewProj)
+{
+	frustumPlanes f;
+	GLfloat row[4][4], len;
+	int i, j, axis, sign;
+
+	for (i = 0; i < 4; i++)
+		for (j = 0; j < 4; j++)
+			row[i][j] = viewProj.m[M4(i, j)];
+	for (i = 0; i < 6; i++)
+	{
+		axis = i / 2;
+		sign = (i & 1) ? -1 : 1;
+		f.planes[i].x = row[3][0] + sign * row[axis][0];
+		f.planes[i].y = row[3][1] + sign * row[axis][1];
+		f.planes[i].z = row[3][2] + sign * row[axis][2];
+		f.planes[i].w = row[3][3] + sign * row[axis][3];
+		len = (GLfloat)sqrt(f.planes[i].x * f.planes[i].x + f.planes[i].y * f.planes[i].y + f.planes[i].z * f.planes[i].z);
+		f.planes[i].x /= len;
+		f.planes[i].y /= len;
+		f.planes[i].z /= len;
+		f.planes[i].w /= len;
+	}
+	return f;
+}
+
+// The plane (0-5) that has the whole sphere/box outside, starting at first. -1 if none.
+// For a box, radius is the extent along the plane normal.
+static int CullPlane(const frustumPlanes *f, GLfloat x, GLfloat y, GLfloat z,
+				GLfloat ex, GLfloat ey, GLfloat ez, GLfloat radius, int first)
+{
+	const vec4 *p;
+	int k, i = first;
+
+	for (k = 0; k < 6; k++, i = i == 5 ? 0 : i + 1)
+	{
+		p = &f->planes[i];
+		if (p->x*x + p->y*y + p->z*z + p->w < -(radius + (GLfloat)fabs(p->x)*ex + (GLfloat)fabs(p->y)*ey + (GLfloat)fabs(p->z)*ez))
+			return i;
+	}
+	return -1;
+}
+
+char SphereInFrustum(const frustumPlanes *f, vec3 center, GLfloat radius)
+{
+	return CullPlane(f, center.x, center.y, center.z, 0, 0, 0, radius, 0) < 0;
+}
+
+char AABBInFrustum(const frustumPlanes *f, vec3 min, vec3 max)
+{
+	return CullPlane(f, (min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f,
+				(max.x - min.x) * 0.5f, (max.y - min.y) * 0.5f, (max.z - min.z) * 0.5f, 0, 0) < 0;
+}
+
+typedef struct
+{
+	const frustumPlanes *f;
+	Vec3Stream a, b; // Centers or mins, unused or maxs
+	const GLfloat *radii; // NULL for boxes
+	unsigned char *cache;
+	unsigned int *mask;
+	GLfloat planes[6][8]; // a, b, c, d, |a|, |b|, |c|
+} CullBatch;
+
+// Four objects at a time, stopping as soon as one plane has all four outside.
+// Chunks start at multiples of 32, so each thread has its own mask words.
+static void CullRange(const void *arg, int from, int to)
+{
+	const CullBatch *c = (const CullBatch *)arg;
+	GLfloat x, y, z, ex = 0, ey = 0, ez = 0, r = 0;
+	int i, pl, first;
+
+	for (i = from / 32; i < (to + 31) / 32; i++)
+		c->mask[i] = 0;
+	i = from;
+#if VU_SIMD
+	{
+		const GLfloat *p;
+		v4f vx, vy, vz, vex, vey, vez, vr, mx, my, mz, limit;
+		int k, outside;
+
+		for (; i + 4 <= to; i += 4)
+		{
+			StreamLoad(&c->a, i, &vx, &vy, &vz);
+			if (c->radii != NULL)
+			{
+				vr = V4Load(&c->radii[i]);
+				vex = vey = vez = V4Splat(0.0f);
+			}
+			else // Center and half size from min and max
+			{
+				StreamLoad(&c->b, i, &mx, &my, &mz);
+				vex = V4Mul(V4Sub(mx, vx), V4Splat(0.5f));
+				vey = V4Mul(V4Sub(my, vy), V4Splat(0.5f));
+				vez = V4Mul(V4Sub(mz, vz), V4Splat(0.5f));
+				vx = V4Add(vx, vex);
+				vy = V4Add(vy, vey);
+				vz = V4Add(vz, vez);
+				vr = V4Splat(0.0f);
+			}
+			pl = c->cache ? c->cache[i / 4] : 0;
+			outside = 0;
+			for (k = 0; k < 6 && outside != 15; k++, pl = pl == 5 ? 0 : pl + 1)
+			{
+				p = c->planes[pl];
+				limit = V4Sub(V4Splat(0.0f), V4MulAdd(V4MulAdd(V4MulAdd(vr,
+					V4Splat(p[4]), vex), V4Splat(p[5]), vey), V4Splat(p[6]), vez));
+				outside |= V4LessMask(V4Add(V4MulAdd(V4MulAdd(V4Mul(V4Splat(p[0]), vx), V4Splat(p[1]), vy), V4Splat(p[2]), vz),
+					V4Splat(p[3])), limit);
+			}
+			if (outside == 15 && c->cache)
+				c->cache[i / 4] = pl == 0 ? 5 : pl - 1; // The loop stepped past it
+			c->mask[i / 32] |= (unsigned int)(~outside & 15) << (i % 32);
+		}
+	}
+#endif
+	for (; i < to; i++)
+	{
+		x = c->a.x[i * c->a.stride];
+		y = c->a.y[i * c->a.stride];
+		z = c->a.z[i * c->a.stride];
+		if (c->radii != NULL)
+			r = c->radii[i];
+		else
+		{
+			ex = (c->b.x[i * c->b.stride] - x) * 0.5f;
+			ey = (c->b.y[i * c->b.stride] - y) * 0.5f;
+			ez = (c->b.z[i * c->b.stride] - z) * 0.5f;
+			x += ex;
+			y += ey;
+			z += ez;
+		}
+		first = c->cache ? c->cache[i / 4] : 0;
+		pl = CullPlane(c->f, x, y, z, ex, ey, ez, r, first);
+		if (pl < 0)
+			c->mask[i / 32] |= 1u << (i % 32);
+		else if (c->cache && i % 4 == 0)
+			c->cache[i / 4] = pl;
+	}
+}
+
+static int CullObjects(CullBatch *c, int n, unsigned int *visibleMask, int *visibleIndices)
+{
+	unsigned int *mask = visibleMask, bits;
+	int i, count = 0;
+
+	for (i = 0; i < 6; i++)
+	{
+		c->planes[i][0] = c->f->planes[i].x;
+		c->planes[i][1] = c->f->planes[i].y;
+		c->planes[i][2] = c->f->planes[i].z;
+		c->planes[i][3] = c->f->planes[i].w;
+		c->planes[i][4] = (GLfloat)fabs(c->f->planes[i].x);
+		c->planes[i][5] = (GLfloat)fabs(c->f->planes[i].y);
+		c->planes[i][6] = (GLfloat)fabs(c->f->planes[i].z);
+	}
+	if (mask == NULL)
+		mask = (unsigned int *)malloc(CullMaskWords(n) * sizeof(unsigned int));
+	c->mask = mask;
+	RunBatch(CullRange, c, n);
+
+	// Count and compact, 32 at a time
+	for (i = 0; i < CullMaskWords(n); i++)
+		for (bits = mask[i]; bits != 0; bits &= bits - 1)
+		{
+			if (visibleIndices != NULL)
+			{
+#if defined(__GNUC__)
+				visibleIndices[count] = i * 32 + __builtin_ctz(bits);
+#else
+				int b = 0;
+				while (!(bits & (1u << b))) b++;
+				visibleIndices[count] = i * 32 + b;
+#endif
+			}
+			count++;
+		}
+	if (mask != visibleMask)
+		free(mask);
+	return count;
+}
+
+int CullSpheres(const frustumPlanes *f, const vec3 *centers, const GLfloat *radii, int n,
+				unsigned char *planeCache, unsigned int *visibleMask, int *visibleIndices)
+{
+	CullBatch c;
+
+	c.f = f;
+	c.a = AoSStream(centers);
+	c.b = c.a;
+	c.radii = radii;
+	c.cache = planeCache;
+	return CullObjects(&c, n, visibleMask, visibleIndices);
+}
+
+int CullAABBs(const frustumPlanes *f, const vec3 *mins, const vec3 *maxs, int n,
+				unsigned char *planeCache, unsigned int *visibleMask, int *visibleIndices)
+{
+	CullBatch c;
+
+	c.f = f;
+	c.a = AoSStream(mins);
+	c.b = AoSStream(maxs);
+	c.radii = NULL;
+	c.cache = planeCache;
+	return CullObjects(&c, n, visibleMask, visibleIndices);
+}
 
 
 // Two convenient printing functions suggested by Christian Luckey 2015.
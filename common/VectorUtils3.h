@@ -63,20 +63,75 @@
 		GLfloat m[9];
 	} mat3;
 
+	// Unit quaternion for rotations, w + xi + yj + zk
+	typedef struct quat
+	{
+		GLfloat x, y, z, w;
+	} quat;
+	// Dual quaternion for rotation + translation (rigid transforms)
+	typedef struct dualquat
+	{
+		quat real, dual;
+	} dualquat;
+	// Affine transform: the upper 3 rows of a mat4, always row-wise.
+	// (4 columns and 3 rows, so GLSL calls it mat4x3.)
+	typedef struct mat4x3
+	{
+		GLfloat m[12];
+	} mat4x3;
+	// View frustum as 6 planes (left, right, bottom, top, near, far) with
+	// x*a + y*b + z*c + w >= 0 inside. Normalized, so w is a distance.
+	typedef struct frustumPlanes
+	{
+		vec4 planes[6];
+	} frustumPlanes;
+	// Translation, rotation and scale, applied as T * R * S
+	typedef struct trs
+	{
+		vec3 t;
+		quat r;
+		vec3 s;
+	} trs;
+
+// Matrix layout. Row-wise unless SetTransposed says otherwise, or fixed
+// at compile time by VECTORUTILS3_ROW_MAJOR or VECTORUTILS3_COLUMN_MAJOR.
+#if defined(VECTORUTILS3_COLUMN_MAJOR)
+	#define VECTORUTILS3_TRANSPOSED 1
+#elif defined(VECTORUTILS3_ROW_MAJOR)
+	#define VECTORUTILS3_TRANSPOSED 0
+#else
+	#define VECTORUTILS3_TRANSPOSED transposed
+#endif
+
+// With VECTORUTILS3_INLINE, the basic vec3 calls and MultVec3 are static
+// inline, so they can be inlined into loops in other files. The source
+// file still compiles them as normal functions, so mixing is fine.
+#if defined(VECTORUTILS3_INLINE) && !defined(VECTORUTILS3_SOURCE)
+	#if defined(_MSC_VER) && !defined(__cplusplus)
+		#define VU_CORE static __inline
+	#else
+		#define VU_CORE static inline
+	#endif
+#else
+	#define VU_CORE
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+	extern char transposed;
+
 //	void CopyVector(vec3 *v, vec3 *dest); // Will probably be removed
-	vec3 SetVector(GLfloat x, GLfloat y, GLfloat z);
+	VU_CORE vec3 SetVector(GLfloat x, GLfloat y, GLfloat z);
 // Basic vector operations on vec3's. (vec4 not included since I never need them.)
-	vec3 VectorSub(vec3 a, vec3 b);
-	vec3 VectorAdd(vec3 a, vec3 b);
-	vec3 CrossProduct(vec3 a, vec3 b);
-	GLfloat DotProduct(vec3 a, vec3 b);
-	vec3 ScalarMult(vec3 a, GLfloat s);
-	GLfloat Norm(vec3 a);
-	vec3 Normalize(vec3 a);
+	VU_CORE vec3 VectorSub(vec3 a, vec3 b);
+	VU_CORE vec3 VectorAdd(vec3 a, vec3 b);
+	VU_CORE vec3 CrossProduct(vec3 a, vec3 b);
+	VU_CORE GLfloat DotProduct(vec3 a, vec3 b);
+	VU_CORE vec3 ScalarMult(vec3 a, GLfloat s);
+	VU_CORE GLfloat Norm(vec3 a);
+	VU_CORE vec3 Normalize(vec3 a);
 	vec3 CalcNormalVector(vec3 a, vec3 b, vec3 c);
 	void SplitVector(vec3 v, vec3 n, vec3 *vn, vec3 *vp);
 
@@ -94,13 +149,13 @@ extern "C" {
 	#define MultMat4 Mult
 
 	// Was MatrixMultPoint3D
-	vec3 MultVec3(mat4 a, vec3 b); // result = a * b
+	VU_CORE vec3 MultVec3(mat4 a, vec3 b); // result = a * b
 	vec4 MultVec4(mat4 a, vec4 b);
 //	void CopyMatrix(GLfloat *src, GLfloat *dest); // Will probably be removed
 
 // Mat3 operations (new)
 	mat3 MultMat3(mat3 a, mat3 b); // m = a * b
-	vec3 MultMat3Vec3(mat3 a, vec3 b); // result = a * b
+	VU_CORE vec3 MultMat3Vec3(mat3 a, vec3 b); // result = a * b
 
 	void OrthoNormalizeMatrix(mat4 *R);
 	mat4 Transpose(mat4 m);
@@ -111,6 +166,8 @@ extern "C" {
 	mat4 MatrixAdd(mat4 a, mat4 b);
 
 // Configure, i.e. if you want matrices to be column-wise
+// Compiling VectorUtils3.c with -DVECTORUTILS3_ROW_MAJOR or -DVECTORUTILS3_COLUMN_MAJOR
+// fixes the layout instead, which is faster. SetTransposed then only warns.
 	void SetTransposed(char t);
 
 // GLU replacement functions
@@ -140,6 +197,219 @@ extern "C" {
 	void printMat4(mat4 m);
 	void printVec3(vec3 in);
 
+// Batch operations on arrays, SIMD and multithreaded with -fopenmp.
+// Same results as calling the single vector versions in a loop. out may be in.
+// The SoA variants take separate x, y and z arrays.
+	void MultVec3Array(mat4 a, const vec3 *in, vec3 *out, int n);
+	void MultVec3ArraySoA(mat4 a, const GLfloat *x, const GLfloat *y, const GLfloat *z,
+				GLfloat *outX, GLfloat *outY, GLfloat *outZ, int n);
+	void NormalizeArray(const vec3 *in, vec3 *out, int n);
+	void NormalizeArraySoA(GLfloat *x, GLfloat *y, GLfloat *z, int n);
+	void TransformPointsAndNormals(mat4 a, const vec3 *points, const vec3 *normals,
+				vec3 *outPoints, vec3 *outNormals, int n);
+	// Linear blend skinning. weights has boneCount weights per vector.
+	void SkinVec3Array(const mat4 *bones, int boneCount, const GLfloat *weights,
+				const vec3 *in, vec3 *out, int n);
+	void SkinVec3ArraySoA(const mat4 *bones, int boneCount, const GLfloat *weights,
+				const GLfloat *x, const GLfloat *y, const GLfloat *z,
+				GLfloat *outX, GLfloat *outY, GLfloat *outZ, int n);
+
+// Quaternions. QuatMult(a, b) rotates by b first, then a, like Mult.
+	quat SetQuat(GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+	quat IdentityQuat();
+	quat QuatMult(quat a, quat b);
+	quat QuatConjugate(quat q); // The inverse of a unit quaternion
+	quat QuatNormalize(quat q);
+	GLfloat QuatDot(quat a, quat b);
+	quat QuatFromAxisAngle(vec3 axis, GLfloat angle);
+	void QuatToAxisAngle(quat q, vec3 *axis, GLfloat *angle);
+	quat QuatSlerp(quat a, quat b, GLfloat t);
+	quat QuatNlerp(quat a, quat b, GLfloat t); // Cheaper, not constant speed
+	// One time step with angular velocity omega (world space, radians/s)
+	quat QuatIntegrate(quat q, vec3 omega, GLfloat dt);
+	vec3 QuatRotateVec3(quat q, vec3 v);
+	mat4 QuatToMat4(quat q);
+	quat Mat4ToQuat(mat4 m); // Rotation part only, must be orthonormal
+
+// Dual quaternions, rotation r followed by translation t
+	dualquat DualQuatFromQuatTranslation(quat r, vec3 t);
+	dualquat DualQuatFromMat4(mat4 m);
+	dualquat DualQuatMult(dualquat a, dualquat b);
+	dualquat DualQuatNormalize(dualquat dq);
+	vec3 DualQuatTranslation(dualquat dq);
+	vec3 DualQuatTransformPoint(dualquat dq, vec3 p);
+	mat4 DualQuatToMat4(dualquat dq);
+
+// Affine transforms, cheaper than mat4 for everything but projections
+	mat4x3 IdentityMat4x3();
+	mat4x3 Mat4ToMat4x3(mat4 m); // Drops the bottom row
+	mat4 Mat4x3ToMat4(mat4x3 a);
+	mat4x3 MultMat4x3(mat4x3 a, mat4x3 b); // a * b
+	vec3 MultMat4x3Vec3(mat4x3 a, vec3 p); // Point, with translation
+	vec3 MultMat4x3Dir(mat4x3 a, vec3 v); // Direction, without translation
+	mat4x3 InvertMat4x3(mat4x3 a);
+	mat4x3 InvertMat4x3Rigid(mat4x3 a); // Rotation and translation only, just a transpose
+	mat3 NormalMatrixMat4x3(mat4x3 a); // Inverse transpose of the rotation/scale part
+	// Uploads are UploadMat4x3 and UploadNormalMatrix in GL_utilities
+
+// Translation, rotation, scale. For storing and interpolating transforms,
+// convert to mat4x3 to compose, invert or transform points.
+	trs SetTRS(vec3 t, quat r, vec3 s);
+	trs IdentityTRS();
+	mat4x3 TRSToMat4x3(trs x);
+	mat4 TRSToMat4(trs x);
+
+// View frustum culling. Pass projection * view to get world space planes,
+// or projection * view * model for model space.
+	frustumPlanes ExtractFrustumPlanes(mat4 viewProj);
+	char SphereInFrustum(const frustumPlanes *f, vec3 center, GLfloat radius);
+	char AABBInFrustum(const frustumPlanes *f, vec3 min, vec3 max);
+	// Batch culling of n objects. Returns the number of visible objects and
+	// optionally writes a bit mask (bit i%32 of word i/32, see CullMaskWords)
+	// and the indices of the visible objects. planeCache is optional
+	// (CullCacheSize bytes, zeroed before the first frame), it remembers
+	// which plane rejected each group of objects so it is tested first
+	// next frame.
+	#define CullMaskWords(n) (((n) + 31) / 32)
+	#define CullCacheSize(n) (((n) + 3) / 4)
+	int CullSpheres(const frustumPlanes *f, const vec3 *centers, const GLfloat *radii, int n,
+				unsigned char *planeCache, unsigned int *visibleMask, int *visibleIndices);
+	int CullAABBs(const frustumPlanes *f, const vec3 *mins, const vec3 *maxs, int n,
+				unsigned char *planeCache, unsigned int *visibleMask, int *visibleIndices);
+
+// Batch versions
+	void QuatRotateVec3Array(quat q, const vec3 *in, vec3 *out, int n);
+	// Dual quaternion skinning, like SkinVec3Array but without the volume loss
+	void SkinDualQuatVec3Array(const dualquat *bones, int boneCount, const GLfloat *weights,
+				const vec3 *in, vec3 *out, int n);
+
+// The VU_CORE calls. Inline in every file with VECTORUTILS3_INLINE,
+// otherwise compiled once, in VectorUtils3.c.
+#if defined(VECTORUTILS3_INLINE) || defined(VECTORUTILS3_SOURCE)
+
+	VU_CORE vec3 SetVector(GLfloat x, GLfloat y, GLfloat z)
+	{
+		vec3 v;
+		
+		v.x = x;
+		v.y = y;
+		v.z = z;
+		return v;
+	}
+
+	VU_CORE vec3 VectorSub(vec3 a, vec3 b)
+	{
+		vec3 result;
+		
+		result.x = a.x - b.x;
+		result.y = a.y - b.y;
+		result.z = a.z - b.z;
+		return result;
+	}
+	
+	VU_CORE vec3 VectorAdd(vec3 a, vec3 b)
+	{
+		vec3 result;
+		
+		result.x = a.x + b.x;
+		result.y = a.y + b.y;
+		result.z = a.z + b.z;
+		return result;
+	}
+
+	VU_CORE vec3 CrossProduct(vec3 a, vec3 b)
+	{
+		vec3 result;
+
+		result.x = a.y*b.z - a.z*b.y;
+		result.y = a.z*b.x - a.x*b.z;
+		result.z = a.x*b.y - a.y*b.x;
+		
+		return result;
+	}
+
+	VU_CORE GLfloat DotProduct(vec3 a, vec3 b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	VU_CORE vec3 ScalarMult(vec3 a, GLfloat s)
+	{
+		vec3 result;
+		
+		result.x = a.x * s;
+		result.y = a.y * s;
+		result.z = a.z * s;
+		
+		return result;
+	}
+
+	VU_CORE GLfloat Norm(vec3 a)
+	{
+		GLfloat result;
+
+		result = (GLfloat)sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+		return result;
+	}
+
+	VU_CORE vec3 Normalize(vec3 a)
+	{
+		GLfloat norm;
+		vec3 result;
+
+		norm = (GLfloat)sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+		result.x = a.x / norm;
+		result.y = a.y / norm;
+		result.z = a.z / norm;
+		return result;
+	}
+
+	// mat4 * vec3
+	// The missing homogenous coordinate is implicitly set to 1.
+	// Stays scalar, packing a vec3 into a SIMD register costs as much as it saves.
+	VU_CORE vec3 MultVec3(mat4 a, vec3 b) // result = a * b
+	{
+		vec3 r;
+
+		if (!VECTORUTILS3_TRANSPOSED)
+		{
+			r.x = a.m[0]*b.x + a.m[1]*b.y + a.m[2]*b.z + a.m[3];
+			r.y = a.m[4]*b.x + a.m[5]*b.y + a.m[6]*b.z + a.m[7];
+			r.z = a.m[8]*b.x + a.m[9]*b.y + a.m[10]*b.z + a.m[11];
+		}
+		else
+		{
+			r.x = a.m[0]*b.x + a.m[4]*b.y + a.m[8]*b.z + a.m[12];
+			r.y = a.m[1]*b.x + a.m[5]*b.y + a.m[9]*b.z + a.m[13];
+			r.z = a.m[2]*b.x + a.m[6]*b.y + a.m[10]*b.z + a.m[14];
+		}
+
+		return r;
+	}
+
+	// mat3 * vec3
+	VU_CORE vec3 MultMat3Vec3(mat3 a, vec3 b) // result = a * b
+	{
+		vec3 r;
+		
+		if (!VECTORUTILS3_TRANSPOSED)
+		{
+			r.x = a.m[0]*b.x + a.m[1]*b.y + a.m[2]*b.z;
+			r.y = a.m[3]*b.x + a.m[4]*b.y + a.m[5]*b.z;
+			r.z = a.m[6]*b.x + a.m[7]*b.y + a.m[8]*b.z;
+		}
+		else
+		{
+			r.x = a.m[0]*b.x + a.m[3]*b.y + a.m[6]*b.z;
+			r.y = a.m[1]*b.x + a.m[4]*b.y + a.m[7]*b.z;
+			r.z = a.m[2]*b.x + a.m[5]*b.y + a.m[8]*b.z;
+		}
+		
+		return r;
+	}
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -311,6 +581,19 @@ vec3 operator*(const mat3 &a, const vec3 &b)
 	return MultMat3Vec3(a, b); // result = a * b
 }
 
+// --- Quaternions ---
+inline
+quat operator*(const quat &a, const quat &b)
+{
+	return QuatMult(a, b);
+}
+
+inline
+dualquat operator*(const dualquat &a, const dualquat &b)
+{
+	return DualQuatMult(a, b);
+}
+
 #endif
 
 
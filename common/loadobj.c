@@ -14,6 +14,7 @@
 // 170406: Added "const" to string arguments to make C++ happier.
 
 #include "loadobj.h"
+#include "GL_utilities.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -1165,7 +1166,7 @@ void DrawModel(Model *m, GLuint program, const char* vertexVariableName, const c
 	{
 		GLint loc;
 		
-		glBindVertexArray(m->vao);	// Select VAO
+		stateBindVertexArray(m->vao);	// Select VAO
 
 		glBindBuffer(GL_ARRAY_BUFFER, m->vb);
 		loc = glGetAttribLocation(program, vertexVariableName);
@@ -1214,7 +1215,7 @@ void DrawWireframeModel(Model *m, GLuint program, const char* vertexVariableName
 	{
 		GLint loc;
 		
-		glBindVertexArray(m->vao);	// Select VAO
+		stateBindVertexArray(m->vao);	// Select VAO
 
 		glBindBuffer(GL_ARRAY_BUFFER, m->vb);
 		loc = glGetAttribLocation(program, vertexVariableName);
@@ -1263,7 +1264,7 @@ void DrawWireframeModel(Model *m, GLuint program, const char* vertexVariableName
 // Useful by its own when the model changes on CPU
 void ReloadModelData(Model *m)
 {
-	glBindVertexArray(m->vao);
+	stateBindVertexArray(m->vao);
 	
 	// VBO for vertex data
 	glBindBuffer(GL_ARRAY_BUFFER, m->vb);
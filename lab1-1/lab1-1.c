@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef __APPLE__
 // Mac
@@ -35,6 +36,8 @@
 #include "GL_utilities.h"
 #include "loadobj.h"
 #include "zpr.h"
+#include "RenderGraph.h"
+#include "Profiler.h"
 
 // initial width and heights
 #define W 512
@@ -43,32 +46,18 @@
 #define NUM_LIGHTS 4
 
 void OnTimer(int value);
+void drawScene(void *data);
 
 mat4 projectionMatrix;
 mat4 viewMatrix;
 
 
-GLfloat square[] = {
-    -1,-1,0,
-    -1,1, 0,
-    1,1, 0,
-    1,-1, 0
-};
-GLfloat squareTexCoord[] = {
-    0, 0,
-    0, 1,
-    1, 1,
-    1, 0
-};
-GLuint squareIndices[] = {0, 1, 2, 0, 2, 3};
-
-Model* squareModel;
-
 //----------------------Globals-------------------------------------------------
 Point3D cam, point;
 Model *model1;
-FBOstruct *fbo1, *fbo2, *original_fbo;
-GLuint phongshader = 0, plaintextureshader = 0, lpshader = 0, blendshader = 0, stepshader = 0;
+GLuint phongshader = 0;
+RenderGraph *bloom;
+FrameConstants frame; // Camera, shared by all programs
 
 //-------------------------------------------------------------------------------------
 
@@ -79,31 +68,33 @@ void init(void)
     // GL inits
     glClearColor(0.1, 0.1, 0.3, 0);
     glClearDepth(1.0);
-    glEnable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
+    stateEnable(GL_DEPTH_TEST);
+    stateDisable(GL_CULL_FACE);
     printError("GL inits");
 
     // Load and compile shaders
-    plaintextureshader = loadShaders("plaintextureshader.vert", "plaintextureshader.frag");  // puts texture on teapot
     phongshader = loadShaders("phong.vert", "phong.frag");  // renders with light (used for initial renderin of teapot)
-    lpshader = loadShaders("plaintextureshader.vert", "lowpass.frag");
-    blendshader = loadShaders("plaintextureshader.vert", "blend.frag");
-    stepshader = loadShaders("plaintextureshader.vert", "step.frag");
 
     printError("init shader");
 
-    original_fbo = initFBO(W, H, 0);
-    fbo1 = initFBO(W, H, 0);
-    fbo2 = initFBO(W, H, 0);
-
     // load the model
     // model1 = LoadModelPlus("teapot.obj");
     model1 = LoadModelPlus("stanford-bunny.obj");
 
-    squareModel = LoadDataToModel(
-	square, NULL, squareTexCoord, NULL,
-	squareIndices, 4, 6
-    );
+    // Bloom: the scene, the parts brighter than 1, blurred 100 times, added
+    // to the scene. All targets are window sized half float. The step pass
+    // is fused into the first blur, and the blur ping-pongs by itself.
+    int scene, blurred, i;
+    bloom = RGCreate();
+    scene = RGDrawPass(bloom, "scene", GL_RGBA16F, 1, drawScene, NULL);
+    blurred = RGShaderPass(bloom, "step", GL_RGBA16F, "a - vec4(1.0)", scene, -1);
+    for (i = 0; i < 100; i++)
+    {
+        blurred = RGShaderPass(bloom, "blur x", GL_RGBA16F, "(a * 2.0 + A(-1.0, 0.0) + A(1.0, 0.0)) * 0.25", blurred, -1);
+        blurred = RGShaderPass(bloom, "blur y", GL_RGBA16F, "(a * 2.0 + A(0.0, -1.0) + A(0.0, 1.0)) * 0.25", blurred, -1);
+    }
+    RGShaderPass(bloom, "blend", 0, "a * 0.3 + b", blurred, scene);
+    RGEnableTiming(bloom, 1);
 
     cam = SetVector(0, 5, 15);
     point = SetVector(0, 1, 0);
@@ -113,23 +104,6 @@ void init(void)
     zprInit(&viewMatrix, cam, point);
 }
 
-void runfilter(GLuint shader, FBOstruct *out, FBOstruct *in1, FBOstruct *in2)
-{
-    glUseProgram(shader);
-
-    // Many of these things would be more efficiently done once and for all
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
-    glUniform1i(glGetUniformLocation(shader, "texUnit"), 0);
-    glUniform1i(glGetUniformLocation(shader, "texUnit2"), 1);
-
-    useFBO(out, in1, in2);
-
-    DrawModel(squareModel, shader, "in_Position", NULL, "in_TexCoord");
-
-    glFlush();
-}
-
 void OnTimer(int value)
 {
     glutPostRedisplay();
@@ -137,77 +111,80 @@ void OnTimer(int value)
 }
 
 //-------------------------------callback functions------------------------------------------
-void display(void)
+void drawScene(void *data)
 {
-    mat4 vm2;
-	
-    // This function is called whenever it is time to render
-    //  a new frame; due to the idle()-function below, this
-    //  function will get called several times per second
-
-    useFBO(original_fbo, 0L, 0L);
+    mat4 vm2, viewProj;
 
     // Clear framebuffer & zbuffer
     glClearColor(0.1, 0.1, 0.3, 0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // Activate shader program
-    glUseProgram(phongshader);
+    stateUseProgram(phongshader);
 
     vm2 = viewMatrix;
     // Scale and place bunny since it is too small
     vm2 = Mult(vm2, T(0, -8.5, 0));
     vm2 = Mult(vm2, S(80,80,80));
 
-    glUniformMatrix4fv(glGetUniformLocation(phongshader, "projectionMatrix"), 1, GL_TRUE, projectionMatrix.m);
-    glUniformMatrix4fv(glGetUniformLocation(phongshader, "modelviewMatrix"), 1, GL_TRUE, vm2.m);
-    glUniform3fv(glGetUniformLocation(phongshader, "camPos"), 1, &cam.x);
-    glUniform1i(glGetUniformLocation(phongshader, "texUnit"), 0);
+    viewProj = Mult(projectionMatrix, viewMatrix);
+    memcpy(frame.view, viewMatrix.m, sizeof(frame.view));
+    memcpy(frame.proj, projectionMatrix.m, sizeof(frame.proj));
+    memcpy(frame.viewProj, viewProj.m, sizeof(frame.viewProj));
+    frame.camPos[0] = cam.x;
+    frame.camPos[1] = cam.y;
+    frame.camPos[2] = cam.z;
+    uploadFrameConstants(&frame);
+    setUniformMatrix4fv(phongshader, "modelviewMatrix", GL_TRUE, vm2.m);
+    setUniform1i(phongshader, "texUnit", 0);
 
     // Enable Z-buffering
-    glEnable(GL_DEPTH_TEST);
+    stateEnable(GL_DEPTH_TEST);
     // Enable backface culling
-    glEnable(GL_CULL_FACE);
+    stateEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
 
     DrawModel(model1, phongshader, "in_Position", "in_Normal", NULL);
+}
 
-    // Done rendering the FBO! Set up for rendering on screen, using the result as texture!
-
-    glFlush(); // Can cause flickering on some systems. Can also be necessary to make drawing complete.
-
-    runfilter(stepshader, fbo2, original_fbo, 0L);
+void display(void)
+{
+    // This function is called whenever it is time to render
+    //  a new frame; due to the idle()-function below, this
+    //  function will get called several times per second
 
-    glUseProgram(lpshader);
-    float offset = 1.0f / 512.0f;
-    /* glUniform2f(glGetUniformLocation(lpshader, "offset"), offset, 0); */
-    /* runfilter(lpshader, fbo1, fbo2, 0L); */
+    pollShaderReload();
+    ProfBegin("bloom");
+    RGExecute(bloom);
+    ProfEnd();
 
-    for (int i = 0; i < 100; i++) {
-    	glUniform2f(glGetUniformLocation(lpshader, "offset"), offset, 0);
-    	runfilter(lpshader, fbo1, fbo2, 0L);
-    	glUniform2f(glGetUniformLocation(lpshader, "offset"), 0, offset);
-    	runfilter(lpshader, fbo2, fbo1, 0L);
+    glutSwapBuffers();
+    ProfFrame();
+
+    // All programs are built by now, the graph's on the first frame
+    static char reported = 0;
+    if (!reported)
+    {
+        printProgramCacheStats();
+        reported = 1;
     }
+}
 
-    useFBO(0L, fbo2, original_fbo);
-    glClearColor(0.0, 0.0, 0.0, 0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Activate second shader program
-    glUseProgram(blendshader);
-    glUniform1i(glGetUniformLocation(blendshader, "texUnit2"), 1);
-
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_DEPTH_TEST);
-    DrawModel(squareModel, plaintextureshader, "in_Position", NULL, "in_TexCoord");
-
-    glutSwapBuffers();
+void keyboard(unsigned char key, int x, int y)
+{
+    if (key == 't')
+    {
+        ProfPrint();
+        printStateStats();
+        printProgramCacheStats();
+    }
+    else
+        zprKey(key, x, y);
 }
 
 void reshape(GLsizei w, GLsizei h)
 {
-    glViewport(0, 0, w, h);
+    stateViewport(0, 0, w, h);
     GLfloat ratio = (GLfloat) w / (GLfloat) h;
     projectionMatrix = perspective(90, ratio, 1.0, 1000);
 }
@@ -236,6 +213,7 @@ int main(int argc, char *argv[])
     glutIdleFunc(idle);
 
     init();
+    glutKeyboardFunc(keyboard); // After zprInit, which sets zprKey
     glutMainLoop();
     exit(0);
 }
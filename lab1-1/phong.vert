@@ -6,7 +6,15 @@ out vec3 exNormal; // Phong
 out vec3 exSurface; // Phong (specular)
 
 uniform mat4 modelviewMatrix;
-uniform mat4 projectionMatrix;
+layout(std140, row_major) uniform FrameConstants
+{
+	mat4 frameView, frameProj, frameViewProj;
+	vec4 frameCamPos;
+	float frameTime;
+	int frameLightCount;
+	vec4 frameLightColor[8];
+	vec4 frameLightPos[8];
+};
 
 void main(void)
 {
@@ -14,5 +22,5 @@ void main(void)
 
 	exSurface = vec3(modelviewMatrix * vec4(in_Position, 1.0)); // Don't include projection here - we only want to go to view coordinates
 
-	gl_Position = projectionMatrix * modelviewMatrix * vec4(in_Position, 1.0); // This should include projection
+	gl_Position = frameProj * modelviewMatrix * vec4(in_Position, 1.0); // This should include projection
 }
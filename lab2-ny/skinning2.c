@@ -33,6 +33,7 @@
 #include "GL_utilities.h"
 #include "VectorUtils3.h"
 #include "loadobj.h"
+#include "TransformHierarchy.h"
 #include <string.h>
 
 // Ref till shader
@@ -82,6 +83,7 @@ float g_boneWeights[kMaxRow][kMaxCorners][kMaxBones];
 vec2 g_boneWeightVis[kMaxRow][kMaxCorners]; // Copy data to here to visualize your weights
 
 mat4 boneRestMatrices[kMaxBones];
+TransformHierarchy *g_skeleton; // Bone b is node b, child of bone b-1
 
 Model *cylinderModel; // Collects all the above for drawing with glDrawElements
 
@@ -249,6 +251,10 @@ void setupBones(void)
 		
 		boneRestMatrices[bone] = T(-bone * BONE_LENGTH, 0.0f, 0.0f);
 	}
+
+	g_skeleton = THCreate(kMaxBones);
+	for (bone = 0; bone < kMaxBones; bone++)
+		THAddNode(g_skeleton, bone - 1, Mult(boneTranslation(bone), g_bones[bone].rot));
 }
 
 ///////////////////////////////////////////////////////
@@ -257,49 +263,23 @@ void setupBones(void)
 // Desc:	deformera cylinder-meshen enligt skelettet
 void DeformCylinder()
 {
-	int row, corner;
+	static mat4 completeMatrix[kMaxBones];
 
-	mat4 boneLocalAnimMatrices[kMaxBones];
+	// Only bones that moved, and the ones after them, are recomputed
 	for (int b = 0; b < kMaxBones; ++b) {
-		mat4 translation = boneTranslation(b);
-		boneLocalAnimMatrices[b] = Mult(translation, g_bonesRes[b].rot);
+		mat4 local = Mult(boneTranslation(b), g_bonesRes[b].rot);
+		THSetLocal(g_skeleton, b, &local);
 	}
+	THUpdate(g_skeleton);
 
-	mat4 boneAnimMatrices[kMaxBones];
-	boneAnimMatrices[0] = boneLocalAnimMatrices[0];
-	for(int b = 1; b < kMaxBones; ++b){
-		boneAnimMatrices[b] = Mult(
-			boneAnimMatrices[b-1],
-			boneLocalAnimMatrices[b]
-		);
-	}
-
-	mat4 completeMatrix[kMaxBones];
 	for (int b = 0; b < kMaxBones; ++b) {
-		completeMatrix[b] = Mult(boneAnimMatrices[b], boneRestMatrices[b]);
+		if (THWorldChanged(g_skeleton, b))
+			completeMatrix[b] = Mult(g_skeleton->world[b], boneRestMatrices[b]);
 	}
 
-	// för samtliga vertexar
-	for (row = 0; row < kMaxRow; row++) {
-		for (corner = 0; corner < kMaxCorners; corner++) {
-			g_vertsRes[row][corner] = (vec3){0, 0, 0};
-			for(int b = 0; b < kMaxBones; b++) {
-				vec3 transformedVert = MultVec3(completeMatrix[b], g_vertsOrg[row][corner]);
-				vec3 weightedVert = ScalarMult(transformedVert, g_boneWeights[row][corner][b]);
-				g_vertsRes[row][corner] = VectorAdd(g_vertsRes[row][corner], weightedVert);
-			}
-			// ---------=========  UPG 4 ===========---------
-			// TODO: skinna meshen mot alla benen.
-			//
-			// data som du kan använda:
-			// g_bonesRes[].rot
-			// g_bones[].pos
-			// g_boneWeights
-			// g_vertsOrg
-			// g_vertsRes
-
-		}
-	}
+	// för samtliga vertexar, viktat över alla ben
+	SkinVec3Array(completeMatrix, kMaxBones, &g_boneWeights[0][0][0],
+		&g_vertsOrg[0][0], &g_vertsRes[0][0], kMaxRow * kMaxCorners);
 }
 
 
@@ -362,7 +342,7 @@ void DrawCylinder()
 	// setBoneRotation();
 
 	// update cylinder vertices:
-	glBindVertexArray(cylinderModel->vao);
+	stateBindVertexArray(cylinderModel->vao);
 	glBindBuffer(GL_ARRAY_BUFFER, cylinderModel->vb);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*kMaxRow*kMaxCorners, g_vertsRes, GL_DYNAMIC_DRAW);
 
@@ -374,11 +354,12 @@ void DisplayWindow()
 {
 	mat4 m;
 
+	pollShaderReload();
 	glClearColor(0.4, 0.4, 0.2, 1);
 	glClear(GL_COLOR_BUFFER_BIT+GL_DEPTH_BUFFER_BIT);
 
 	m = Mult(projectionMatrix, modelViewMatrix);
-	glUniformMatrix4fv(glGetUniformLocation(g_shader, "matrix"), 1, GL_TRUE, m.m);
+	setUniformMatrix4fv(g_shader, "matrix", GL_TRUE, m.m);
 
 	DrawCylinder();
 
@@ -402,7 +383,7 @@ void reshape(GLsizei w, GLsizei h)
 	vec3 cam = {0,0,40};
 	vec3 look = {10,0,0};
 
-	glViewport(0, 0, w, h);
+	stateViewport(0, 0, w, h);
 	GLfloat ratio = (GLfloat) w / (GLfloat) h;
 	projectionMatrix = perspective(90, ratio, 0.1, 1000);
 	modelViewMatrix = lookAt(cam.x, cam.y, cam.z,
@@ -430,7 +411,7 @@ int main(int argc, char **argv)
 	g_shader = loadShaders("shader.vert" , "shader.frag");
 
 	// Set up depth buffer
-	glEnable(GL_DEPTH_TEST);
+	stateEnable(GL_DEPTH_TEST);
 
 	// initiering
 #ifdef WIN32
@@ -154,7 +154,7 @@ void BuildCylinder()
 		kMaxRow*kMaxCorners,
 		kMaxg_poly * 3);
 
-		glBindVertexArray(cylinderModel->vao);
+		stateBindVertexArray(cylinderModel->vao);
 		GLuint boneWeightBuffer;
 		glGenBuffers(1, &boneWeightBuffer);
 		glBindBuffer(GL_ARRAY_BUFFER, boneWeightBuffer);
@@ -226,8 +226,8 @@ void BuildCylinder()
 		mat4 bone0_mat = Mult(Mult(TByVec(g_bones[0].pos), g_bones[0].rot), bone0_rest);
 		mat4 bone1_mat = Mult(Mult(TByVec(g_bones[1].pos), g_bones[1].rot), bone1_rest);
 
-		GLuint bone0_location = glGetUniformLocation(g_shader, "bone0");
-		GLuint bone1_location = glGetUniformLocation(g_shader, "bone1");
+		GLuint bone0_location = getUniformLocation(g_shader, "bone0");
+		GLuint bone1_location = getUniformLocation(g_shader, "bone1");
 
 		glUniformMatrix4fv(bone0_location, 1, GL_TRUE, bone0_mat.m);
 		glUniformMatrix4fv(bone1_location, 1, GL_TRUE, bone1_mat.m);
@@ -283,7 +283,7 @@ void BuildCylinder()
 		// Begynnelsen till shaderkoden ligger i filen "shader.vert" ...
 
 		// update cylinder vertices:
-		glBindVertexArray(cylinderModel->vao);
+		stateBindVertexArray(cylinderModel->vao);
 		/* glBindBuffer(GL_ARRAY_BUFFER, cylinderModel->vb); */
 		/* glBufferData(GL_ARRAY_BUFFER, sizeof(Point3D)*kMaxRow*kMaxCorners, g_vertsRes, GL_DYNAMIC_DRAW); */
 
@@ -301,11 +301,12 @@ void BuildCylinder()
 	{
 		mat4 m;
 
+		pollShaderReload();
 		glClearColor(0.4, 0.4, 0.2, 1);
 		glClear(GL_COLOR_BUFFER_BIT+GL_DEPTH_BUFFER_BIT);
 
 		m = Mult(projectionMatrix, modelViewMatrix);
-		glUniformMatrix4fv(glGetUniformLocation(g_shader, "matrix"), 1, GL_TRUE, m.m);
+		setUniformMatrix4fv(g_shader, "matrix", GL_TRUE, m.m);
 
 		DrawCylinder();
 
@@ -331,7 +332,7 @@ void BuildCylinder()
 		Point3D cam = {5,0,8};
 		Point3D look = {5,0,0};
 
-		glViewport(0, 0, w, h);
+		stateViewport(0, 0, w, h);
 		GLfloat ratio = (GLfloat) w / (GLfloat) h;
 		projectionMatrix = perspective(90, ratio, 0.1, 1000);
 		//   glUniformMatrix4fv(glGetUniformLocation(shader, "projMatrix"), 1, GL_TRUE, projectionMatrix);
@@ -360,7 +361,7 @@ void BuildCylinder()
 			g_shader = loadShaders("shader.vert" , "shader.frag");
 
 			// Set up depth buffer
-			glEnable(GL_DEPTH_TEST);
+			stateEnable(GL_DEPTH_TEST);
 
 			// initiering
 			#ifdef WIN32
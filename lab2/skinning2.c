@@ -331,7 +331,7 @@ void DrawCylinder()
     // setBoneRotation();
 
 // update cylinder vertices:
-    glBindVertexArray(cylinderModel->vao);
+    stateBindVertexArray(cylinderModel->vao);
     glBindBuffer(GL_ARRAY_BUFFER, cylinderModel->vb);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vec3)*kMaxRow*kMaxCorners, g_vertsRes, GL_DYNAMIC_DRAW);
         
@@ -347,7 +347,7 @@ void DisplayWindow()
     glClear(GL_COLOR_BUFFER_BIT+GL_DEPTH_BUFFER_BIT);
 
     m = Mult(projectionMatrix, modelViewMatrix);
-    glUniformMatrix4fv(glGetUniformLocation(g_shader, "matrix"), 1, GL_TRUE, m.m);
+    setUniformMatrix4fv(g_shader, "matrix", GL_TRUE, m.m);
 
     DrawCylinder();
 
@@ -371,7 +371,7 @@ void reshape(GLsizei w, GLsizei h)
     vec3 cam = {10,0,20};
     vec3 look = {10,0,0};
 
-    glViewport(0, 0, w, h);
+    stateViewport(0, 0, w, h);
     GLfloat ratio = (GLfloat) w / (GLfloat) h;
     projectionMatrix = perspective(90, ratio, 0.1, 1000);
     modelViewMatrix = lookAt(cam.x, cam.y, cam.z,
@@ -399,7 +399,7 @@ int main(int argc, char **argv)
     g_shader = loadShaders("skinning2.vert", "shader.frag");
 
     // Set up depth buffer
-    glEnable(GL_DEPTH_TEST);
+    stateEnable(GL_DEPTH_TEST);
 
     // initiering
 #ifdef WIN32
@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #ifdef __APPLE__
 #include <OpenGL/gl3.h>
 #include "MicroGlut.h"
@@ -25,6 +26,10 @@
 #include "VectorUtils3.h"
 #include "loadobj.h"
 #include "LoadTGA.h"
+#include "TextureManager.h"
+#include "TextureAtlas.h"
+#include "FrameCapture.h"
+#include "Profiler.h"
 #include "zpr.h"
 
 // initial width and heights
@@ -71,11 +76,11 @@ typedef struct
 
 typedef struct
 {
-    GLuint tex;
+    GLint layer; // in ballTextures
     GLfloat mass;
 
     vec3 position, linearMomentum, angularMomentum;
-    mat4 rotation;
+    quat rotation; // 4 floats instead of a mat4, never needs orthonormalization
 
     vec3 F, T; // accumulated force and torque
 
@@ -110,6 +115,7 @@ enum {kNumBalls = 4}; // Change as desired, max 16
 //------------------------------Globals---------------------------------
 ModelTexturePair tableAndLegs, tableSurf;
 Model *sphere;
+TextureAtlas *ballTextures; // All ball textures in one array texture, on texture unit 1
 Ball ball[16]; // We only use kNumBalls but textures for all 16 are always loaded so they must exist. So don't change here, change above.
 
 GLfloat deltaT, currentTime;
@@ -128,6 +134,37 @@ GLfloat specularExponent[] = {50.0};
 GLint directional[] = {0};
 vec3 lightSourcesDirectionsPositions[] = { {0.0, 10.0, 0.0} };
 
+// Camera and lights, shared by all programs through one uniform buffer
+FrameConstants frame;
+
+void updateFrameConstants(void)
+{
+    mat4 viewProj = Mult(projectionMatrix, viewMatrix);
+    vec3 camPos = MultVec3(InvertMat4(viewMatrix), SetVector(0, 0, 0));
+    int i;
+
+    memcpy(frame.view, viewMatrix.m, sizeof(frame.view));
+    memcpy(frame.proj, projectionMatrix.m, sizeof(frame.proj));
+    memcpy(frame.viewProj, viewProj.m, sizeof(frame.viewProj));
+    frame.camPos[0] = camPos.x;
+    frame.camPos[1] = camPos.y;
+    frame.camPos[2] = camPos.z;
+    frame.time = currentTime;
+    frame.lightCount = sizeof(lightSourcesColorArr) / sizeof(vec3);
+    for (i = 0; i < frame.lightCount; i++)
+    {
+        frame.lightColor[i][0] = lightSourcesColorArr[i].x;
+        frame.lightColor[i][1] = lightSourcesColorArr[i].y;
+        frame.lightColor[i][2] = lightSourcesColorArr[i].z;
+        frame.lightColor[i][3] = specularExponent[i];
+        frame.lightPos[i][0] = lightSourcesDirectionsPositions[i].x;
+        frame.lightPos[i][1] = lightSourcesDirectionsPositions[i].y;
+        frame.lightPos[i][2] = lightSourcesDirectionsPositions[i].z;
+        frame.lightPos[i][3] = directional[i] ? 0.0 : 1.0;
+    }
+    uploadFrameConstants(&frame);
+}
+
 
 //----------------------------------Utility functions-----------------------------------
 
@@ -136,7 +173,7 @@ void loadModelTexturePair(ModelTexturePair* modelTexturePair,
 {
     modelTexturePair->model = LoadModelPlus(model); // , shader, "in_Position", "in_Normal", "in_TexCoord");
     if (texture)
-        LoadTGATextureSimple(texture, &modelTexturePair->textureId);
+        TMAcquireTextureSimple(texture, &modelTexturePair->textureId);
     else
         modelTexturePair->textureId = 0;
 }
@@ -144,20 +181,20 @@ void loadModelTexturePair(ModelTexturePair* modelTexturePair,
 void renderModelTexturePair(ModelTexturePair* modelTexturePair)
 {
     if(modelTexturePair->textureId)
-        glUniform1i(glGetUniformLocation(shader, "objID"), 0);  // use texture
+        setUniform1i(shader, "objID", 0);  // use texture
     else
-        glUniform1i(glGetUniformLocation(shader, "objID"), 1); // use material color only
+        setUniform1i(shader, "objID", 1); // use material color only
 
-    glBindTexture(GL_TEXTURE_2D, modelTexturePair->textureId);
-    glUniform1i(glGetUniformLocation(shader, "texUnit"), 0);
+    stateBindTexture(GL_TEXTURE_2D, modelTexturePair->textureId);
+    setUniform1i(shader, "texUnit", 0);
 
     DrawModel(modelTexturePair->model, shader, "in_Position", "in_Normal", NULL);
 }
 
 void loadMaterial(Material mt)
 {
-    glUniform4fv(glGetUniformLocation(shader, "diffColor"), 1, &mt.diffColor[0]);
-    glUniform1fv(glGetUniformLocation(shader, "shininess"), 1, &mt.shininess);
+    setUniform4fv(shader, "diffColor", &mt.diffColor[0]);
+    setUniform1f(shader, "shininess", mt.shininess);
 }
 
 //---------------------------------- physics update and billiard table rendering ----------------------------------
@@ -240,8 +277,7 @@ void updateWorld()
     // Update state, follows the book closely
     for (i = 0; i < kNumBalls; i++)
     {
-        vec3 deltaPosition, dP, dL, dO;
-        mat4 Rd;
+        vec3 deltaPosition, dP, dL;
 
         // Note: angularVelocity is not set. How do you calculate it?
         // YOUR CODE HERE
@@ -253,42 +289,40 @@ void updateWorld()
 //		X := X + v*dT
         deltaPosition = ScalarMult(ball[i].v, deltaT); // deltaPosition := v*dT
         ball[i].position = VectorAdd(ball[i].position, deltaPosition); // position := position + deltaPosition
-//		R := R + Rd*dT
-        dO = ScalarMult(ball[i].angularVelocity, deltaT); // dO := angularVelocity*dT
-        Rd = CrossMatrix(dO); // Calc dO, add to R
-        Rd = Mult(Rd, ball[i].rotation); // Rotate the diff (NOTE: This was missing in early versions.)
-        ball[i].rotation = MatrixAdd(ball[i].rotation, Rd);
+//		R := R + Rd*dT, done as a rotation by angularVelocity*dT
+        ball[i].rotation = QuatIntegrate(ball[i].rotation, ball[i].angularVelocity, deltaT);
 //		P := P + F * dT
         dP = ScalarMult(ball[i].F, deltaT); // dP := F*dT
         ball[i].linearMomentum = VectorAdd(ball[i].linearMomentum, dP); // P := P + dP
 //		L := L + t * dT
         dL = ScalarMult(ball[i].T, deltaT); // dL := T*dT
         ball[i].angularMomentum = VectorAdd(ball[i].angularMomentum, dL); // L := L + dL
-
-        OrthoNormalizeMatrix(&ball[i].rotation);
     }
 }
 
 void renderBall(int ballNr)
 {
-    glBindTexture(GL_TEXTURE_2D, ball[ballNr].tex);
+    mat4 rotationMatrix = QuatToMat4(ball[ballNr].rotation);
+
+    setUniform1i(shader, "objID", 2); // use ball texture
+    setUniform1i(shader, "ballLayer", ball[ballNr].layer);
 
     // Ball with rotation
     transMatrix = T(ball[ballNr].position.x, kBallSize, ball[ballNr].position.z); // position
-    tmpMatrix = Mult(transMatrix, ball[ballNr].rotation); // ball rotation
+    tmpMatrix = Mult(transMatrix, rotationMatrix); // ball rotation
     tmpMatrix = Mult(viewMatrix, tmpMatrix);
-    glUniformMatrix4fv(glGetUniformLocation(shader, "viewMatrix"), 1, GL_TRUE, tmpMatrix.m);
+    setUniformMatrix4fv(shader, "viewMatrix", GL_TRUE, tmpMatrix.m);
     loadMaterial(ballMt);
     DrawModel(sphere, shader, "in_Position", "in_Normal", NULL);
 
     // Simple shadow
-    glBindTexture(GL_TEXTURE_2D, 0);
+    setUniform1i(shader, "objID", 1); // use material color only
 
     tmpMatrix = S(1.0, 0.0, 1.0);
     tmpMatrix = Mult(tmpMatrix, transMatrix);
-    tmpMatrix = Mult(tmpMatrix, ball[ballNr].rotation);
+    tmpMatrix = Mult(tmpMatrix, rotationMatrix);
     tmpMatrix = Mult(viewMatrix, tmpMatrix);
-    glUniformMatrix4fv(glGetUniformLocation(shader, "viewMatrix"), 1, GL_TRUE, tmpMatrix.m);
+    setUniformMatrix4fv(shader, "viewMatrix", GL_TRUE, tmpMatrix.m);
     loadMaterial(shadowMt);
     DrawModel(sphere, shader, "in_Position", "in_Normal", NULL);
 }
@@ -314,11 +348,11 @@ void init()
     glClearColor(0.1, 0.1, 0.3, 0);
     glClearDepth(1.0);
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    stateEnable(GL_DEPTH_TEST);
+    stateEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
 
-    glEnable(GL_BLEND);
+    stateEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     printError("GL inits");
@@ -331,17 +365,28 @@ void init()
     loadModelTexturePair(&tableSurf, "tablesurf.obj", "surface.tga");
     sphere = LoadModelPlus("sphere.obj");
 
-    projectionMatrix = perspective(90, 1.0, 0.1, 1000); // It would be silly to upload an uninitialized matrix
-    glUniformMatrix4fv(glGetUniformLocation(shader, "projMatrix"), 1, GL_TRUE, projectionMatrix.m);
+    projectionMatrix = perspective(90, 1.0, 0.1, 1000);
 
-    char *textureStr = malloc(128);
+    char *textureStr[kNumBalls];
     int i;
     for(i = 0; i < kNumBalls; i++)
     {
-        sprintf(textureStr, "balls/%d.tga", i);
-        LoadTGATextureSimple(textureStr, &ball[i].tex);
+        textureStr[i] = malloc(128);
+        sprintf(textureStr[i], "balls/%d.tga", i);
+        ball[i].layer = i;
+    }
+    ballTextures = BuildTextureArray(textureStr, kNumBalls);
+    for(i = 0; i < kNumBalls; i++)
+        free(textureStr[i]);
+    if (ballTextures != NULL)
+    {
+        stateActiveTexture(GL_TEXTURE1);
+        stateBindTexture(GL_TEXTURE_2D_ARRAY, ballTextures->texID);
+        stateActiveTexture(GL_TEXTURE0);
+        setUniform1i(shader, "ballTexUnit", 1);
     }
-    free(textureStr);
+    else
+        printf("Could not load the ball textures\n");
 
     // Initialize ball data, positions etc
     for (i = 0; i < kNumBalls; i++)
@@ -349,7 +394,7 @@ void init()
         ball[i].mass = 1.0;
         ball[i].position = SetVector((i % 4) * kBallSize, 0.0, (i / 4) * kBallSize);
         ball[i].linearMomentum = SetVector(((float)(i % 13))/ 50.0, 0.0, ((float)(i % 15))/50.0);
-        ball[i].rotation = IdentityMatrix();
+        ball[i].rotation = IdentityQuat();
     }
     ball[0].position = SetVector(0, 0, 0);
     ball[1].position = SetVector(0, 0, 0.5);
@@ -371,11 +416,15 @@ void init()
 //-------------------------------callback functions------------------------------------------
 void display(void)
 {
-    int i;
+    int i, numVisible, visible[kNumBalls];
+    vec3 centers[kNumBalls];
+    GLfloat radii[kNumBalls];
+    frustumPlanes planes;
     // This function is called whenever it is time to render
     //  a new frame; due to the idle()-function below, this
     //  function will get called several times per second
     updateWorld();
+    pollShaderReload();
 
     // Clear framebuffer & zbuffer
     glClearColor(0.1, 0.1, 0.3, 0);
@@ -383,22 +432,56 @@ void display(void)
 
 //    int time = glutGet(GLUT_ELAPSED_TIME);
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+    stateEnable(GL_DEPTH_TEST);
+    stateEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
 
-    glUniformMatrix4fv(glGetUniformLocation(shader, "viewMatrix"), 1, GL_TRUE, viewMatrix.m);
+    setUniformMatrix4fv(shader, "viewMatrix", GL_TRUE, viewMatrix.m);
+    updateFrameConstants();
 
     printError("uploading to shader");
 
+    ProfBegin("table");
     renderTable();
+    ProfEnd();
 
+    // Only the balls in view, with room for the shadow
+    planes = ExtractFrustumPlanes(Mult(projectionMatrix, viewMatrix));
     for (i = 0; i < kNumBalls; i++)
-        renderBall(i);
+    {
+        centers[i] = SetVector(ball[i].position.x, kBallSize, ball[i].position.z);
+        radii[i] = 2 * kBallSize;
+    }
+    numVisible = CullSpheres(&planes, centers, radii, kNumBalls, NULL, NULL, visible);
+    ProfBegin("balls");
+    for (i = 0; i < numVisible; i++)
+        renderBall(visible[i]);
+    ProfEnd();
 
     printError("rendering");
 
+    FrameRecordFrame(); // Only if recording
+    FrameCapturePoll();
     glutSwapBuffers();
+    ProfFrame();
+}
+
+void keyboard(unsigned char key, int x, int y)
+{
+    if (key == 't')
+    {
+        ProfPrint();
+        printStateStats();
+        TMPrintStats();
+        LoadTGAPrintMemoryStats();
+    }
+    else if (key == 0x1b)
+    {
+        FrameCaptureShutdown(); // Ends the recording while the context exists
+        exit(0);
+    }
+    else
+        zprKey(key, x, y);
 }
 
 void onTimer(int value)
@@ -414,10 +497,9 @@ void reshape(GLsizei w, GLsizei h)
     lastw = w;
     lasth = h;
 
-    glViewport(0, 0, w, h);
+    stateViewport(0, 0, w, h);
     GLfloat ratio = (GLfloat) w / (GLfloat) h;
     projectionMatrix = perspective(90, ratio, 0.1, 1000);
-    glUniformMatrix4fv(glGetUniformLocation(shader, "projMatrix"), 1, GL_TRUE, projectionMatrix.m);
 }
 
 //-----------------------------main-----------------------------------------------
@@ -433,6 +515,11 @@ int main(int argc, char **argv)
     glutTimerFunc(20, &onTimer, 0);
 
     init();
+    glutKeyboardFunc(keyboard); // After zprInit, which sets zprKey
+
+    // "lab3 -record billiards.y4m" records the whole run, every frame, until Esc
+    if (argc > 2 && strcmp(argv[1], "-record") == 0)
+        FrameRecordStart(argv[2], W, H, 50, kRecordBlock);
 
     glutMainLoop();
     exit(0);
@@ -11,6 +11,18 @@ uniform vec4 diffColor;
 uniform float shininess;
 
 uniform sampler2D texUnit;
+uniform sampler2DArray ballTexUnit;
+uniform int ballLayer;
+
+layout(std140, row_major) uniform FrameConstants
+{
+	mat4 frameView, frameProj, frameViewProj;
+	vec4 frameCamPos;
+	float frameTime;
+	int frameLightCount;
+	vec4 frameLightColor[8];
+	vec4 frameLightPos[8];
+};
 
 out vec4 out_Color;
 
@@ -34,7 +46,7 @@ vec4 calculateLighting()
 
     specular = pow( max(dot(refl, camDir), 0.0), 100);
 
-    color = vec3(ambient + 0.6*diffuse + 1.0*specular);
+    color = vec3(ambient + 0.6*diffuse + 1.0*specular) * frameLightColor[0].rgb;
 
     return vec4(color, 1.0);
 }
@@ -45,5 +57,6 @@ void main(void)
     {
         case 0: out_Color = calculateLighting() * diffColor * texture(texUnit, outTexCoord); break;
         case 1: out_Color = calculateLighting() * diffColor; break;
+        case 2: out_Color = calculateLighting() * diffColor * texture(ballTexUnit, vec3(outTexCoord, ballLayer)); break;
     }
 }
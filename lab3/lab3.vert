@@ -4,7 +4,15 @@ in vec3 in_Position;
 in vec3 in_Normal;
 
 uniform mat4 viewMatrix, mdlMatrix;
-uniform mat4 projMatrix;
+layout(std140, row_major) uniform FrameConstants
+{
+	mat4 frameView, frameProj, frameViewProj;
+	vec4 frameCamPos;
+	float frameTime;
+	int frameLightCount;
+	vec4 frameLightColor[8];
+	vec4 frameLightPos[8];
+};
 
 out vec2 outTexCoord;
 out vec3 pixPos;
@@ -17,5 +25,5 @@ void main(void)
     pixPos = vec3(viewMatrix /* * mdlMatrix*/ * vec4(in_Position, 1.0));
     out_Normal = mat3(viewMatrix) * in_Normal;
 
-    gl_Position = projMatrix * viewMatrix * vec4(in_Position, 1.0);
+    gl_Position = frameProj * viewMatrix * vec4(in_Position, 1.0);
 }
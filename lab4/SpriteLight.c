@@ -7,6 +7,7 @@
 
 #include "SpriteLight.h"
 #include "LoadTGA.h"
+#include "TextureManager.h"
 #include <math.h>
 #include "VectorUtils3.h"
 #include "GL_utilities.h"
@@ -22,6 +23,10 @@ unsigned int vertexArrayObjID;
 // Reference to shader program
 GLuint program;
 
+// Faces loaded with LoadSpriteAtlas all live in one texture
+TextureAtlas *gSpriteAtlas = NULL;
+TextureData *gAtlasFaces = NULL;
+
 // Uncomment if you are on a system without fabs
 //GLfloat fabs(GLfloat in)
 //{
@@ -33,15 +38,45 @@ TextureData *GetFace(char *fileName)
 {
 	TextureData *fp;
 
-	fp = (TextureData *)malloc(sizeof(TextureData));
-
-	if (!LoadTGATexture(fileName, fp)) return NULL;
+	// Shared, so several faces from the same file only load once
+	fp = TMAcquireTexture(fileName);
+	if (fp == NULL) return NULL;
+	stateBindTexture(GL_TEXTURE_2D, fp->texID);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	printf("Loaded %s\n", fileName);
 	return fp;
 }
 
+// Loads all faces into one texture atlas, so sprites can be drawn
+// without changing texture in between. faces[i] is the face for fileNames[i].
+void LoadSpriteAtlas(char **fileNames, int count, TextureData **faces)
+{
+	int i;
+
+	gSpriteAtlas = BuildTextureAtlas(fileNames, count, 4);
+	if (gSpriteAtlas == NULL)
+	{
+		// Fall back to separate textures
+		for (i = 0; i < count; i++)
+			faces[i] = GetFace(fileNames[i]);
+		return;
+	}
+	gAtlasFaces = (TextureData *)calloc(count, sizeof(TextureData));
+	for (i = 0; i < count; i++)
+	{
+		gAtlasFaces[i].texID = gSpriteAtlas->texID;
+		gAtlasFaces[i].width = gSpriteAtlas->rects[i].width;
+		gAtlasFaces[i].height = gSpriteAtlas->rects[i].height;
+		gAtlasFaces[i].bpp = 32;
+		gAtlasFaces[i].w = gSpriteAtlas->width;
+		gAtlasFaces[i].h = gSpriteAtlas->height;
+		gAtlasFaces[i].texWidth = gSpriteAtlas->rects[i].u1 - gSpriteAtlas->rects[i].u0;
+		gAtlasFaces[i].texHeight = gSpriteAtlas->rects[i].v1 - gSpriteAtlas->rects[i].v0;
+		faces[i] = &gAtlasFaces[i];
+	}
+}
+
 struct SpriteRec *NewSprite(TextureData *f, GLfloat h, GLfloat v, GLfloat hs, GLfloat vs)
 {
 	SpritePtr sp;
@@ -93,8 +128,11 @@ void HandleSprite(SpritePtr sp)
 void DrawSprite(SpritePtr sp)
 {
 	mat4 trans, rot, scale, m;
+	AtlasRect *r = NULL;
 
-	glUseProgram(program);
+	stateUseProgram(program);
+	if (gSpriteAtlas != NULL && sp->face >= gAtlasFaces && sp->face < gAtlasFaces + gSpriteAtlas->count)
+		r = &gSpriteAtlas->rects[sp->face - gAtlasFaces];
 	// Update matrices
 	scale = S((float)sp->face->width/gWidth * 1.0f, (float)sp->face->height/gHeight * 1.0f, 1);
 //	trans = T(sp->position.h/gWidth, sp->position.v/gHeight, 0);
@@ -102,11 +140,17 @@ void DrawSprite(SpritePtr sp)
 	rot = Rz(sp->rotation * 3.14 / 180);
 	m = Mult(trans, Mult(scale, rot));
 
-	glUniformMatrix4fv(glGetUniformLocation(program, "m"), 1, GL_TRUE, m.m);
-	glBindTexture(GL_TEXTURE_2D, sp->face->texID);
+	setUniformMatrix4fv(program, "m", GL_TRUE, m.m);
+	if (r != NULL)
+		setUniform4f(program, "texRect", r->u0, r->v0, r->u1 - r->u0, r->v1 - r->v0);
+	else
+		setUniform4f(program, "texRect", 0, 0, 1, 1);
+	// With an atlas, all sprites use the same texture, and the state
+	// tracker skips the rebinds
+	stateBindTexture(GL_TEXTURE_2D, sp->face->texID);
 
 	// Draw
-	glBindVertexArray(vertexArrayObjID);	// Select VAO
+	stateBindVertexArray(vertexArrayObjID);	// Select VAO
 	glDrawArrays(GL_TRIANGLES, 0, 6);	// draw object
 }
 
@@ -114,14 +158,15 @@ void DrawBackground()
 {
 	mat4 scale;
 
-	glUseProgram(program);
-	glBindTexture(GL_TEXTURE_2D, backgroundTexID);
+	stateUseProgram(program);
+	stateBindTexture(GL_TEXTURE_2D, backgroundTexID);
 	// Update matrices
 	scale = S(2, 2, 1);
-	glUniformMatrix4fv(glGetUniformLocation(program, "m"), 1, GL_TRUE, scale.m);
+	setUniformMatrix4fv(program, "m", GL_TRUE, scale.m);
+	setUniform4f(program, "texRect", 0, 0, 1, 1);
 
 	// Draw
-	glBindVertexArray(vertexArrayObjID);	// Select VAO
+	stateBindVertexArray(vertexArrayObjID);	// Select VAO
 	glDrawArrays(GL_TRIANGLES, 0, 6);	// draw object
 }
 
@@ -159,14 +204,14 @@ void InitSpriteLight()
 
 	// Load and compile shader
 	program = loadShaders("SpriteLight.vert", "SpriteLight.frag");
-	glUseProgram(program);
+	stateUseProgram(program);
 	printError("init shader");
 
 	// Upload geometry to the GPU:
 
 	// Allocate and activate Vertex Array Object
 	glGenVertexArrays(1, &vertexArrayObjID);
-	glBindVertexArray(vertexArrayObjID);
+	stateBindVertexArray(vertexArrayObjID);
 	// Allocate Vertex Buffer Objects
 	glGenBuffers(1, &vertexBufferObjID);
 	glGenBuffers(1, &texCoordBufferObjID);
@@ -183,7 +228,7 @@ void InitSpriteLight()
 	glVertexAttribPointer(glGetAttribLocation(program, "inTexCoord"), 2, GL_FLOAT, GL_FALSE, 0, 0);
 	glEnableVertexAttribArray(glGetAttribLocation(program, "inTexCoord"));
 
-	glUniform1i(glGetUniformLocation(program, "tex"), 0); // Texture unit 0
+	setUniform1i(program, "tex", 0); // Texture unit 0
 //	LoadTGATextureSimple("maskros512.tga", &tex); // 5c
 
 	// End of upload of geometry
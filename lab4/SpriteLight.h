@@ -13,6 +13,7 @@
 #endif
 
 #include "LoadTGA.h"
+#include "TextureAtlas.h"
 
 typedef struct FPoint
 {
@@ -38,6 +39,7 @@ extern long gWidth, gHeight;
 
 // Functions
 TextureData *GetFace(char *fileName);
+void LoadSpriteAtlas(char **fileNames, int count, TextureData **faces);
 struct SpriteRec *NewSprite(TextureData *f, GLfloat h, GLfloat v, GLfloat hs, GLfloat vs);
 void HandleSprite(SpritePtr sp);
 void DrawSprite(SpritePtr sp);
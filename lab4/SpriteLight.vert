@@ -5,10 +5,11 @@ in vec2 inTexCoord;
 
 out vec2 texCoord;
 uniform mat4 m;
+uniform vec4 texRect; // Offset and size of the image in a texture atlas
 
 void main(void)
 {
-	texCoord = inTexCoord;
+	texCoord = texRect.xy + inTexCoord * texRect.zw;
 	
 	gl_Position = m * vec4(inPosition, 1.0);
 }
@@ -15,6 +15,9 @@
 #include <stdlib.h>
 #include "LoadTGA.h"
 #include "SpriteLight.h"
+#include "TextureCompress.h"
+#include "FrameCapture.h"
+#include "Profiler.h"
 #include "GL_utilities.h"
 #include "math.h"
 
@@ -140,17 +143,21 @@ void Display()
 {
 	SpritePtr sp;
 
+	pollShaderReload();
 	glClearColor(0, 0, 0.2, 1);
 	glClear(GL_COLOR_BUFFER_BIT+GL_DEPTH_BUFFER_BIT);
-	glEnable(GL_TEXTURE_2D);
-	glEnable(GL_BLEND);
+	stateEnable(GL_TEXTURE_2D);
+	stateEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+	ProfBegin("background");
 	DrawBackground();
+	ProfEnd();
 
 	SpriteBehavior(); // Din kod!
 
 	// Loop though all sprites. (Several loops in real engine.)
+	ProfBegin("sprites");
 	sp = gSpriteRoot;
 	do
 	{
@@ -158,13 +165,17 @@ void Display()
 		DrawSprite(sp);
 		sp = sp->next;
 	} while (sp != NULL);
+	ProfEnd();
 
+	FrameRecordFrame(); // Only if recording
+	FrameCapturePoll(); // Writes screenshots from earlier frames
 	glutSwapBuffers();
+	ProfFrame();
 }
 
 void Reshape(int h, int v)
 {
-	glViewport(0, 0, h, v);
+	stateViewport(0, 0, h, v);
 	gWidth = h;
 	gHeight = v;
 }
@@ -207,7 +218,28 @@ void Key(unsigned char key,
 		cohesionFactor *= 1.001;
 		printf("alignmentFactor now: %f\n", alignmentFactor);
 		break;
+	case 'p':
+		{
+			// Screenshot, read back and saved without stalling
+			static int shotCount = 0;
+			char name[32];
+			sprintf(name, "lab4-%03d.tga", shotCount++);
+			FrameCaptureRequest(name, 0, 0, gWidth, gHeight);
+			printf("Saving %s\n", name);
+		}
+		break;
+	case 't': // GPU time per scope, texture memory
+		ProfPrint();
+		LoadTGAPrintMemoryStats();
+		break;
+	case 'r': // Start/stop recording a video
+		if (FrameRecordActive())
+			FrameRecordStop();
+		else
+			FrameRecordStart("lab4.y4m", gWidth, gHeight, 50, kRecordDrop);
+		break;
     case 0x1b:
+      FrameCaptureShutdown(); // Writes the frames still in flight
       exit(0);
   }
 }
@@ -215,12 +247,21 @@ void Key(unsigned char key,
 void Init()
 {
 
-	LoadTGATextureSimple("bilder/leaves.tga", &backgroundTexID); // Bakgrund
-
-	sheepFace = GetFace("bilder/sheep.tga"); // Ett f�r
-	metalFace = GetFace("bilder/blackie.tga"); // Ett svart f�r
-	dogFace = GetFace("bilder/dog.tga"); // En hund
-	foodFace = GetFace("bilder/mat.tga"); // Mat
+	LoadTGATextureCompressedSimple("bilder/leaves.tga", &backgroundTexID); // Bakgrund
+
+	// All faces in one texture atlas, so sprites never change texture
+	char *faceFiles[] = {
+		"bilder/sheep.tga", // Ett f�r
+		"bilder/blackie.tga", // Ett svart f�r
+		"bilder/dog.tga", // En hund
+		"bilder/mat.tga" // Mat
+	};
+	TextureData *faces[4];
+	LoadSpriteAtlas(faceFiles, 4, faces);
+	sheepFace = faces[0];
+	metalFace = faces[1];
+	dogFace = faces[2];
+	foodFace = faces[3];
 
 	NewSprite(sheepFace, 100, 200, 1, 1);
 	NewSprite(sheepFace, 200, 100, 1.5, -1);
@@ -257,6 +298,7 @@ int main(int argc, char **argv)
 
 	InitSpriteLight();
 	Init();
+	FrameCaptureInit(3, false, true);
 
 	glutMainLoop();
 	return 0;